@@ -0,0 +1,144 @@
+// Update cost of a million bodies, BodyStore against per-object updates.
+// The object version mirrors what Planet::update used to do: every body is
+// its own heap object with its mesh embedded next to its orbit, and a moon
+// reads its parent's position through a pointer. Both run the same motion,
+// so their positions are compared after the last frame; the objects step
+// their angles while the store evaluates them at the time, so the difference
+// includes the objects' rounding drift.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <Sphere/Sphere.h>
+#include <Timer/Timer.h>
+#include <planet/BodyStore.h>
+
+struct ObjectBody
+{
+    char mesh[sizeof(Sphere)]; // a Planet carried its Sphere in front of its state
+    const ObjectBody *parent;
+    float x, y, z;
+    float spin, angle, scale;
+    float orbitRadius, orbitSpeed, orbitAngle;
+    float centerX, centerZ;
+
+    void update(float deltaTime)
+    {
+        angle += spin * deltaTime;
+        orbitAngle += orbitSpeed * deltaTime;
+        float cx = parent ? parent->x : centerX, cz = parent ? parent->z : centerZ;
+        x = cx + orbitRadius * std::cos(orbitAngle);
+        z = cz + orbitRadius * std::sin(orbitAngle);
+    }
+};
+
+int main(int argc, char **argv)
+{
+    const unsigned int count = argc > 1 ? (unsigned int)std::atoi(argv[1]) : 1000000;
+    const unsigned int systems = 1000; // every thousandth body is a star, the rest orbit one
+    const int frames = 20;
+    const float deltaTime = 1.0f / 60.0f;
+
+    BodyStore store;
+    store.reserve(count);
+    std::vector<ObjectBody *> objects(count);
+    std::srand(1);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        unsigned int body = store.add(0.01f);
+        ObjectBody *object = new ObjectBody();
+        objects[i] = object;
+
+        float radius = (float)(std::rand() % 1000) * 0.01f;
+        float speed = 0.1f + (float)(std::rand() % 100) * 0.01f;
+        store.orbitRadius[body] = object->orbitRadius = radius;
+        store.orbitSpeed[body] = object->orbitSpeed = speed;
+        object->spin = 1.0f;
+        object->scale = 1.0f;
+        if (i % (count / systems) != 0)
+        {
+            unsigned int star = i - i % (count / systems);
+            store.setParent(body, (int)star);
+            object->parent = objects[star];
+        }
+    }
+
+    Timer timer;
+    timer.start();
+    for (int f = 0; f < frames; ++f)
+        store.update(deltaTime);
+    timer.stop();
+    double storeMs = timer.getElapsedTimeInMilliSec() / frames;
+
+    timer.start();
+    for (int f = 0; f < frames; ++f)
+        for (unsigned int i = 0; i < count; ++i)
+            objects[i]->update(deltaTime);
+    timer.stop();
+    double objectMs = timer.getElapsedTimeInMilliSec() / frames;
+
+    float maxError = 0.0f;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        maxError = std::fmax(maxError, std::fabs(store.x[i] - objects[i]->x));
+        maxError = std::fmax(maxError, std::fabs(store.z[i] - objects[i]->z));
+    }
+
+    std::cout << count << " bodies, " << frames << " frames" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  objects   " << std::setw(8) << objectMs << " ms/frame  (" << sizeof(ObjectBody) << " bytes per body)" << std::endl;
+    std::cout << "  BodyStore " << std::setw(8) << storeMs << " ms/frame  (" << objectMs / storeMs << "x)" << std::endl;
+    std::cout << "  max position difference " << std::scientific << maxError << std::endl;
+
+    for (unsigned int i = 0; i < count; ++i)
+        delete objects[i];
+
+    // four levels, star -> planet -> moon -> sub-satellite, numbered so that every parent
+    // comes after its children; then again with all but a tenth of the systems at rest
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        BodyStore tree;
+        tree.reserve(count);
+        for (unsigned int i = 0; i < count; ++i)
+            tree.add(0.01f);
+        for (unsigned int n = 0; n < count; ++n)
+        {
+            unsigned int body = count - 1 - n;
+            bool moving = pass == 0 || (n / (count / systems)) % 10 == 0;
+            tree.orbitRadius[body] = 0.1f + (float)(std::rand() % 100) * 0.01f;
+            tree.orbitSpeed[body] = moving ? 0.1f + (float)(std::rand() % 100) * 0.01f : 0.0f;
+            // within a system of 1000: every 100th a planet, every 10th a moon of it, the rest sub-satellites
+            unsigned int local = n % (count / systems);
+            unsigned int step = local % 100 == 0 ? (count / systems) : local % 10 == 0 ? 100 : 10;
+            if (local != 0)
+                tree.setParent(body, (int)(count - 1 - (n - local % step)));
+        }
+
+        tree.update(deltaTime); // places everything once
+        timer.start();
+        for (int f = 0; f < frames; ++f)
+            tree.update(deltaTime);
+        timer.stop();
+        double treeMs = timer.getElapsedTimeInMilliSec() / frames;
+
+        // positions from the definition, walking up the parents of each body
+        float treeError = 0.0f;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            float wx = 0.0f, wz = 0.0f;
+            for (int b = (int)i; b != BodyStore::NO_PARENT; b = tree.parent[b])
+            {
+                double mean = tree.meanAnomaly[b] + tree.orbitSpeed[b] * tree.getTime();
+                wx += tree.centerX[b] + tree.orbitRadius[b] * (float)std::cos(mean);
+                wz += tree.centerZ[b] + tree.orbitRadius[b] * (float)std::sin(mean);
+            }
+            treeError = std::fmax(treeError, std::fmax(std::fabs(tree.x[i] - wx), std::fabs(tree.z[i] - wz)));
+        }
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "  4-level hierarchy, parents last, " << (pass == 0 ? "all moving " : "90% at rest")
+                  << std::setw(8) << treeMs << " ms/frame, max difference " << std::scientific << treeError << std::endl;
+    }
+    return 0;
+}
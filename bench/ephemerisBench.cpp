@@ -0,0 +1,243 @@
+// Startup and per-frame cost of Ephemeris, and its accuracy. No JPL kernel
+// ships with the project, so this writes a DE-like one first: the planetary
+// barycenters and the Sun around the solar system barycenter, Earth and Moon
+// around their barycenter, each on a slightly inclined circle, fitted with
+// Chebyshev polynomials over a century at DE-like record lengths. Positions
+// are checked against those circles, with the AVX Clenshaw against the scalar
+// one; then opening the kernel and a frame of every body relative to the Sun
+// are timed. Exits with 1 when a position is off by more than the tolerances.
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <Timer/Timer.h>
+#include <planet/Ephemeris.h>
+
+static const double POSITION_TOLERANCE = 1e-3; // km, against the circles
+static const double CLENSHAW_TOLERANCE = 1e-6; // km, AVX against scalar
+
+static const double PI = 3.14159265358979323846;
+static const double DAY = 86400.0;
+static const double AU = 149597870.7; // km
+
+struct TestOrbit
+{
+    int target, center;
+    double radius;      // km
+    double period;      // days
+    double inclination; // radians
+    double phase;
+    int intervalDays;
+    int coefficients;
+};
+
+static const TestOrbit ORBITS[] = {
+    {EPHEMERIS_MERCURY_BARYCENTER, 0, 0.387 * AU, 88.0, 0.12, 0.3, 8, 14},
+    {EPHEMERIS_VENUS_BARYCENTER, 0, 0.723 * AU, 224.7, 0.06, 1.1, 16, 10},
+    {EPHEMERIS_EARTH_MOON_BARYCENTER, 0, AU, 365.25, 0.0, 2.0, 16, 13},
+    {EPHEMERIS_MARS_BARYCENTER, 0, 1.524 * AU, 687.0, 0.03, 2.9, 32, 11},
+    {EPHEMERIS_JUPITER_BARYCENTER, 0, 5.2 * AU, 4332.6, 0.02, 4.0, 32, 8},
+    {EPHEMERIS_SATURN_BARYCENTER, 0, 9.54 * AU, 10759.2, 0.04, 5.1, 32, 7},
+    {EPHEMERIS_URANUS_BARYCENTER, 0, 19.2 * AU, 30688.5, 0.01, 0.7, 32, 6},
+    {EPHEMERIS_NEPTUNE_BARYCENTER, 0, 30.1 * AU, 60182.0, 0.03, 1.6, 32, 6},
+    {EPHEMERIS_PLUTO_BARYCENTER, 0, 39.5 * AU, 90560.0, 0.3, 3.3, 32, 6},
+    {EPHEMERIS_SUN, 0, 7.4e5, 4332.6, 0.02, 0.9, 16, 11},
+    {EPHEMERIS_MOON, EPHEMERIS_EARTH_MOON_BARYCENTER, 379700.0, 27.32, 0.09, 0.4, 4, 13},
+    {EPHEMERIS_EARTH, EPHEMERIS_EARTH_MOON_BARYCENTER, 4670.0, 27.32, 0.09, 0.4 + PI, 4, 13}};
+static const int ORBIT_COUNT = sizeof(ORBITS) / sizeof(ORBITS[0]);
+
+// the test motion, relative to the orbit's center
+static void circle(const TestOrbit &orbit, double time, double *position)
+{
+    double angle = orbit.phase + 2.0 * PI * time / (orbit.period * DAY);
+    position[0] = orbit.radius * std::cos(angle);
+    position[1] = orbit.radius * std::sin(angle) * std::cos(orbit.inclination);
+    position[2] = orbit.radius * std::sin(angle) * std::sin(orbit.inclination);
+}
+static void circleFrom(int target, int center, double time, double *position)
+{
+    // through the solar system barycenter, as every chain in the kernel ends there
+    double sum[2][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+    int ends[2] = {target, center};
+    for (int e = 0; e < 2; ++e)
+        for (int body = ends[e]; body != 0;)
+            for (int i = 0; i < ORBIT_COUNT; ++i)
+                if (ORBITS[i].target == body)
+                {
+                    double p[3];
+                    circle(ORBITS[i], time, p);
+                    for (int a = 0; a < 3; ++a)
+                        sum[e][a] += p[a];
+                    body = ORBITS[i].center;
+                    break;
+                }
+    for (int a = 0; a < 3; ++a)
+        position[a] = sum[0][a] - sum[1][a];
+}
+
+static void putInt(std::vector<unsigned char> &record, std::size_t offset, int value)
+{
+    std::memcpy(&record[offset], &value, sizeof(value));
+}
+
+// a DAF/SPK with one type 2 segment per orbit over [start, end]
+static std::size_t writeKernel(const std::string &path, double start, double end)
+{
+    std::vector<std::vector<double> > data(ORBIT_COUNT);
+    for (int o = 0; o < ORBIT_COUNT; ++o)
+    {
+        const TestOrbit &orbit = ORBITS[o];
+        int n = orbit.coefficients;
+        double interval = orbit.intervalDays * DAY;
+        int records = (int)std::ceil((end - start) / interval);
+        std::vector<double> &segment = data[o];
+        for (int r = 0; r < records; ++r)
+        {
+            // coefficients from the values at the Chebyshev nodes of the interval
+            double mid = start + (r + 0.5) * interval, half = 0.5 * interval;
+            segment.push_back(mid);
+            segment.push_back(half);
+            std::vector<double> values(3 * n);
+            for (int j = 0; j < n; ++j)
+                circle(orbit, mid + half * std::cos(PI * (j + 0.5) / n), &values[3 * j]);
+            for (int axis = 0; axis < 3; ++axis)
+                for (int k = 0; k < n; ++k)
+                {
+                    double c = 0.0;
+                    for (int j = 0; j < n; ++j)
+                        c += values[3 * j + axis] * std::cos(PI * k * (j + 0.5) / n);
+                    segment.push_back(c * (k == 0 ? 1.0 : 2.0) / n);
+                }
+        }
+        segment.push_back(start);
+        segment.push_back(interval);
+        segment.push_back(2 + 3 * n);
+        segment.push_back(records);
+    }
+
+    // file record, one summary record, its name record, then the segments
+    const int recordDoubles = 128;
+    std::vector<unsigned char> fileRecord(1024, 0), summaryRecord(1024, 0), nameRecord(1024, ' ');
+    std::memcpy(&fileRecord[0], "DAF/SPK ", 8);
+    putInt(fileRecord, 8, 2);
+    putInt(fileRecord, 12, 6);
+    std::memcpy(&fileRecord[16], "ephemerisBench test kernel", 26);
+    putInt(fileRecord, 76, 2);
+    putInt(fileRecord, 80, 2);
+    std::memcpy(&fileRecord[88], "LTL-IEEE", 8);
+
+    double header[3] = {0.0, 0.0, (double)ORBIT_COUNT};
+    std::memcpy(&summaryRecord[0], header, sizeof(header));
+    int address = 3 * recordDoubles + 1;
+    for (int o = 0; o < ORBIT_COUNT; ++o)
+    {
+        std::size_t offset = (3 + 5 * o) * sizeof(double);
+        double times[2] = {start, end};
+        std::memcpy(&summaryRecord[offset], times, sizeof(times));
+        int ints[6] = {ORBITS[o].target, ORBITS[o].center, 1, 2, address, address + (int)data[o].size() - 1};
+        std::memcpy(&summaryRecord[offset + sizeof(times)], ints, sizeof(ints));
+        address += (int)data[o].size();
+    }
+    putInt(fileRecord, 84, address);
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out.write((const char *)&fileRecord[0], 1024);
+    out.write((const char *)&summaryRecord[0], 1024);
+    out.write((const char *)&nameRecord[0], 1024);
+    std::size_t size = 3 * 1024;
+    for (int o = 0; o < ORBIT_COUNT; ++o)
+    {
+        out.write((const char *)&data[o][0], data[o].size() * sizeof(double));
+        size += data[o].size() * sizeof(double);
+    }
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    const std::string path = argc > 1 ? argv[1] : "ephemerisBench.bsp";
+    const double start = -50.0 * 365.25 * DAY, end = 50.0 * 365.25 * DAY; // 1950 to 2050
+    bool passed = true;
+
+    std::size_t size = writeKernel(path, start, end);
+    Timer timer;
+    Ephemeris ephemeris;
+    timer.start();
+    bool opened = ephemeris.open(path);
+    timer.stop();
+    if (!opened)
+        return 1;
+    std::cout << std::fixed << std::setprecision(1) << "kernel of " << size / (1024.0 * 1024.0) << " MB, " << ephemeris.getSegmentCount()
+              << " segments, opened in " << timer.getElapsedTimeInMicroSec() << " us" << std::endl;
+
+    // every body relative to the Sun, as the scene wants them
+    int targets[ORBIT_COUNT], centers[ORBIT_COUNT];
+    for (int o = 0; o < ORBIT_COUNT; ++o)
+    {
+        targets[o] = ORBITS[o].target;
+        centers[o] = EPHEMERIS_SUN;
+    }
+    targets[9] = EPHEMERIS_SOLAR_SYSTEM_BARYCENTER;
+    centers[10] = EPHEMERIS_EARTH; // and the Moon from Earth, across their barycenter
+
+    std::srand(1);
+    double positionError = 0.0, clenshawError = 0.0;
+    std::vector<double> scalar(3 * ORBIT_COUNT), vectorized(3 * ORBIT_COUNT), expected(3);
+    for (int i = 0; i < 20000; ++i)
+    {
+        double time = start + (end - start) * ((double)std::rand() / RAND_MAX);
+        ephemeris.setVectorized(false);
+        passed = ephemeris.getPositions(targets, centers, ORBIT_COUNT, time, &scalar[0]) && passed;
+        ephemeris.setVectorized(true);
+        passed = ephemeris.getPositions(targets, centers, ORBIT_COUNT, time, &vectorized[0]) && passed;
+        for (int o = 0; o < ORBIT_COUNT; ++o)
+        {
+            circleFrom(targets[o], centers[o], time, &expected[0]);
+            for (int a = 0; a < 3; ++a)
+            {
+                positionError = std::fmax(positionError, std::fabs(scalar[3 * o + a] - expected[a]));
+                clenshawError = std::fmax(clenshawError, std::fabs(vectorized[3 * o + a] - scalar[3 * o + a]));
+            }
+        }
+    }
+    double outside[3];
+    if (ephemeris.getPosition(EPHEMERIS_MARS_BARYCENTER, EPHEMERIS_SUN, end + DAY, outside))
+        passed = false;
+    passed = passed && positionError <= POSITION_TOLERANCE && clenshawError <= CLENSHAW_TOLERANCE;
+    std::cout << std::scientific << std::setprecision(1) << "max position error " << positionError << " km, AVX against scalar "
+              << clenshawError << " km" << std::endl;
+
+    // per frame: 60 Hz at a day per second, then jumps to random times that miss the cached records
+    const int frames = 10000;
+    std::vector<double> positions(3 * ORBIT_COUNT);
+    std::vector<double> jumps(frames);
+    for (int f = 0; f < frames; ++f)
+        jumps[f] = start + (end - start) * ((double)std::rand() / RAND_MAX);
+    std::cout << std::fixed << std::setprecision(2);
+    for (int v = 0; v < 2; ++v)
+    {
+        ephemeris.setVectorized(v == 1);
+        if (v == 1 && !ephemeris.isVectorized())
+            break;
+        timer.start();
+        for (int f = 0; f < frames; ++f)
+            ephemeris.getPositions(targets, centers, ORBIT_COUNT, f * DAY / 60.0, &positions[0]);
+        timer.stop();
+        double playMicro = timer.getElapsedTimeInMicroSec() / frames;
+        timer.start();
+        for (int f = 0; f < frames; ++f)
+            ephemeris.getPositions(targets, centers, ORBIT_COUNT, jumps[f], &positions[0]);
+        timer.stop();
+        double jumpMicro = timer.getElapsedTimeInMicroSec() / frames;
+        std::cout << std::setw(7) << (v == 1 ? "AVX" : "scalar") << ": " << ORBIT_COUNT << " bodies per frame " << std::setw(6) << playMicro
+                  << " us playing, " << std::setw(6) << jumpMicro << " us jumping" << std::endl;
+    }
+
+    std::remove(path.c_str());
+    std::cout << (passed ? "ephemeris within tolerance" : "EPHEMERIS CHECK FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// Cost of Frustum::cull over a million bounding spheres, scalar against AVX,
+// and whether both keep exactly the same spheres. Besides random spheres the
+// set has spheres that touch a plane, their radius the scalar signed distance,
+// where any difference in rounding between the paths would show. Exits with 1
+// when the visible lists differ.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <Timer/Timer.h>
+#include <renderer/Frustum.h>
+
+static float random(float low, float high)
+{
+    return low + (high - low) * ((float)std::rand() / RAND_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned int count = argc > 1 ? (unsigned int)std::atoi(argv[1]) : 1000000;
+    const int views = 16;
+    const int repeats = 10;
+
+    std::srand(1);
+    Timer timer;
+    double scalarMs = 0.0, vectorizedMs = 0.0;
+    std::size_t visibleTotal = 0, mismatches = 0;
+    bool vectorizedRan = false;
+    for (int v = 0; v < views; ++v)
+    {
+        glm::vec3 eye(random(-50.0f, 50.0f), random(-10.0f, 10.0f), random(-50.0f, 50.0f));
+        glm::vec3 target(random(-20.0f, 20.0f), 0.0f, random(-20.0f, 20.0f));
+        glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f) *
+                                   glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+        Frustum frustum;
+        frustum.extract(viewProjection);
+
+        // every fourth sphere touches one of the planes, as the scalar test computes the distance
+        BoundingSpheres spheres;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            glm::vec3 center(random(-100.0f, 100.0f), random(-30.0f, 30.0f), random(-100.0f, 100.0f));
+            float radius = random(0.001f, 2.0f);
+            if (i % 4 == 0)
+            {
+                const glm::vec4 &plane = frustum.getPlanes()[i / 4 % 6];
+                radius = -(plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w);
+                if (radius < 0.0f)
+                    radius = -radius;
+            }
+            spheres.add(center, radius);
+        }
+
+        std::vector<unsigned int> scalar, vectorized;
+        frustum.setVectorized(false);
+        timer.start();
+        for (int r = 0; r < repeats; ++r)
+            frustum.cull(spheres, scalar);
+        timer.stop();
+        scalarMs += timer.getElapsedTimeInMilliSec() / repeats;
+
+        frustum.setVectorized(true);
+        vectorizedRan = frustum.isVectorized();
+        timer.start();
+        for (int r = 0; r < repeats; ++r)
+            frustum.cull(spheres, vectorized);
+        timer.stop();
+        vectorizedMs += timer.getElapsedTimeInMilliSec() / repeats;
+
+        visibleTotal += scalar.size();
+        if (vectorized != scalar)
+            ++mismatches;
+    }
+
+    std::cout << count << " spheres, " << views << " views, " << visibleTotal / views << " visible on average" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  scalar " << std::setw(8) << scalarMs / views << " ms/cull" << std::endl;
+    if (vectorizedRan)
+        std::cout << "  AVX    " << std::setw(8) << vectorizedMs / views << " ms/cull  (" << scalarMs / vectorizedMs << "x)" << std::endl;
+    else
+        std::cout << "  AVX    not supported, ran as scalar" << std::endl;
+    std::cout << (mismatches == 0 ? "visible sets identical" : "VISIBLE SETS DIFFER") << " in " << views - mismatches << " of " << views << " views" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
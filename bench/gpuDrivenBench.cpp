@@ -0,0 +1,192 @@
+// GpuDrivenRenderer against InstancedRenderer, and what its frame costs.
+// A hidden GL 4.3 window draws the same 201-body scene through both: a sun
+// and 200 moons in a grid receding from the camera, so that the finest and
+// the coarsest mesh and points are all used. The images and the instances per
+// level must be identical. Then bodies below the camera, all of them culled, are
+// added up to a million, and the GPU-driven frame is timed: the CPU side is
+// one dispatch and two draws at any count. Exits with 1 when the renderers
+// disagree; without a GL 4.3 context there is nothing to compare.
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <Timer/Timer.h>
+#include <camera/camera.h>
+#include <shadersPrograms/shader.h>
+#include <renderer/FrameUniforms.h>
+#include <renderer/MeshArena.h>
+#include <renderer/TextureArray.h>
+#include <renderer/InstancedRenderer.h>
+#include <renderer/GpuDrivenRenderer.h>
+
+static const int WIDTH = 800;
+static const int HEIGHT = 600;
+
+static glm::mat4 sceneModel(int body)
+{
+    if (body == 0)
+        return glm::scale(glm::mat4(1.0f), glm::vec3(0.6f));
+    int moon = body - 1;
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(-1.5f + (moon % 10) * 0.33f, -1.0f + (moon / 10) * 0.1f, -moon * 0.4f));
+    return glm::scale(model, glm::vec3(0.05f));
+}
+
+static void readPixels(std::vector<unsigned char> &pixels)
+{
+    pixels.resize((std::size_t)WIDTH * HEIGHT * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
+
+// everything with GL objects, released before the context goes
+static bool compareAndTime(unsigned int extraBodies)
+{
+    const int sceneBodies = 201;
+    const int frames = 20;
+
+    // a hidden window's own framebuffer may have no pixels to read back
+    unsigned int framebuffer, colorBuffer, depthBuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &colorBuffer);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, WIDTH, HEIGHT);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glViewport(0, 0, WIDTH, HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+
+    Shader instancedShader("dependencies/include/shadersPrograms/instancedVertexShader.glsl", "dependencies/include/shadersPrograms/instancedFragmentShader.glsl");
+    Shader pointShader("dependencies/include/shadersPrograms/pointVertexShader.glsl", "dependencies/include/shadersPrograms/pointFragmentShader.glsl");
+    Shader cullShader("dependencies/include/shadersPrograms/cullComputeShader.glsl");
+    Shader gpuShader("dependencies/include/shadersPrograms/gpuVertexShader.glsl", "dependencies/include/shadersPrograms/instancedFragmentShader.glsl");
+    Shader gpuPointShader("dependencies/include/shadersPrograms/gpuPointVertexShader.glsl", "dependencies/include/shadersPrograms/pointFragmentShader.glsl");
+    Shader *drawShaders[] = {&instancedShader, &pointShader, &gpuShader, &gpuPointShader};
+    for (Shader *shader : drawShaders)
+    {
+        shader->setUniformBlockBinding("FrameData", FrameUniforms::BINDING);
+        shader->setUniformBlockBinding("TextureResidency", TextureArray::RESIDENCY_BINDING);
+    }
+
+    // no detail requests, so both layers stream in fully before anything is drawn
+    TextureArray textures(1024, 512);
+    int moonLayer = textures.addLayer("PlanetTextureMaps/moonmap1k.jpg");
+    int sunLayer = textures.addLayer("PlanetTextureMaps/sunmap.jpg");
+    textures.build();
+    textures.finish();
+
+    Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+    glm::mat4 view = camera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)WIDTH / HEIGHT, 0.1f, 100.0f);
+    FrameUniforms frameUniforms;
+    frameUniforms.setCamera(view, projection, camera.Position);
+    frameUniforms.setDirLight(glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.3f), glm::vec3(1.1f, 1.1f, 0.4f), glm::vec3(1.0f, 1.0f, 0.5f));
+    frameUniforms.setPointLight(glm::vec3(1.0f), glm::vec3(0.0f, 0.0f, 0.1f), glm::vec3(0.2f), glm::vec3(0.5f));
+    frameUniforms.upload();
+
+    MeshArena arena;
+    InstancedRenderer instanced(arena, 8, 256);
+    GpuDrivenRenderer gpuDriven(arena, cullShader, 8, 256);
+    for (int b = 0; b < sceneBodies; ++b)
+        gpuDriven.addBody(sceneModel(b), b == 0 ? sunLayer : moonLayer);
+
+    std::vector<unsigned char> instancedPixels, gpuPixels;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    instanced.setView(camera.Position, projection, HEIGHT);
+    instanced.begin();
+    for (int b = 0; b < sceneBodies; ++b)
+        instanced.add(sceneModel(b), b == 0 ? sunLayer : moonLayer, 0, (unsigned int)b);
+    instanced.draw(instancedShader.ID, pointShader.ID, textures);
+    readPixels(instancedPixels);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gpuDriven.setView(camera.Position, view, projection, HEIGHT);
+    gpuDriven.draw(gpuShader.ID, gpuPointShader.ID, textures);
+    readPixels(gpuPixels);
+    std::vector<unsigned int> gpuCounts;
+    gpuDriven.readLevelCounts(gpuCounts);
+
+    bool passed = gpuCounts.size() == (std::size_t)instanced.getLevelCount() + 1;
+    std::cout << "instances per level, points last" << std::endl;
+    std::cout << "  InstancedRenderer:";
+    for (int l = 0; l <= instanced.getLevelCount(); ++l)
+        std::cout << " " << instanced.getLevelInstanceCount(l);
+    std::cout << std::endl << "  GpuDrivenRenderer:";
+    for (std::size_t l = 0; l < gpuCounts.size(); ++l)
+    {
+        std::cout << " " << gpuCounts[l];
+        passed = passed && (int)l <= instanced.getLevelCount() && gpuCounts[l] == instanced.getLevelInstanceCount((int)l);
+    }
+    std::cout << std::endl;
+    std::size_t differing = 0;
+    for (std::size_t i = 0; i < instancedPixels.size(); ++i)
+        differing += instancedPixels[i] != gpuPixels[i];
+    passed = passed && differing == 0;
+    std::cout << "  " << differing << " differing channel values" << std::endl;
+
+    // CPU time is what draw() takes to submit; the GPU time includes the cull dispatch
+    std::cout << std::fixed << std::setprecision(3);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (pass == 1)
+            for (unsigned int b = 0; b < extraBodies; ++b)
+            {
+                glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3((b % 1000) * 0.01f - 5.0f, -30.0f, -(float)(b / 1000) * 0.01f));
+                gpuDriven.addBody(glm::scale(model, glm::vec3(0.01f)), moonLayer);
+            }
+        gpuDriven.draw(gpuShader.ID, gpuPointShader.ID, textures); // uploads the new bodies
+        glFinish();
+
+        Timer timer;
+        double submitMs = 0.0;
+        timer.start();
+        for (int f = 0; f < frames; ++f)
+        {
+            Timer submit;
+            submit.start();
+            gpuDriven.draw(gpuShader.ID, gpuPointShader.ID, textures);
+            submit.stop();
+            submitMs += submit.getElapsedTimeInMilliSec();
+        }
+        glFinish();
+        timer.stop();
+        std::cout << std::setw(8) << gpuDriven.getBodyCount() << " bodies: " << std::setw(8) << submitMs / frames << " ms CPU, "
+                  << std::setw(8) << timer.getElapsedTimeInMilliSec() / frames << " ms with the GPU per frame" << std::endl;
+    }
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colorBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned int extraBodies = argc > 1 ? (unsigned int)std::atoi(argv[1]) : 1000000;
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(WIDTH, HEIGHT, "gpuDrivenBench", NULL, NULL);
+    if (window == NULL || (glfwMakeContextCurrent(window), !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) ||
+        !GpuDrivenRenderer::isSupported())
+    {
+        std::cout << "no GL 4.3 context with vertex storage blocks, nothing to compare" << std::endl;
+        glfwTerminate();
+        return 0;
+    }
+
+    bool passed = compareAndTime(extraBodies);
+    glfwTerminate();
+    std::cout << (passed ? "renderers match" : "RENDERERS DIFFER") << std::endl;
+    return passed ? 0 : 1;
+}
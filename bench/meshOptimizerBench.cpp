@@ -0,0 +1,49 @@
+// Vertex cache / fetch optimization on generated spheres.
+// Prints simulated ACMR/ATVR (16 and 32 entry FIFO caches) of the row-by-row
+// index order and of the optimized order, plus the time spent optimizing.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <Sphere/Sphere.h>
+#include <Timer/Timer.h>
+#include <meshOptimizer/MeshOptimizer.h>
+
+static void report(const char *label, const std::vector<unsigned int> &indices, std::size_t vertexCount)
+{
+    VertexCacheStats small = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertexCount, 16);
+    VertexCacheStats large = MeshOptimizer::analyzeVertexCache(indices.data(), indices.size(), vertexCount, 32);
+    std::cout << "  " << std::left << std::setw(10) << label << std::right << std::fixed << std::setprecision(3)
+              << "ACMR16 " << small.acmr << "  ATVR16 " << small.atvr
+              << "  ACMR32 " << large.acmr << "  ATVR32 " << large.atvr << std::endl;
+}
+
+int main()
+{
+    const int sizes[][2] = {{72, 36}, {256, 128}, {1024, 512}, {2048, 1024}};
+
+    for (const int *size : sizes)
+    {
+        Sphere sphere(1.0f, size[0], size[1]);
+        std::size_t vertexCount = sphere.getVertexCount();
+        std::vector<unsigned int> indices(sphere.getIndices(), sphere.getIndices() + sphere.getIndexCount());
+
+        std::cout << size[0] << "x" << size[1] << ": " << vertexCount << " vertices, "
+                  << sphere.getTriangleCount() << " triangles" << std::endl;
+        report("original", indices, vertexCount);
+
+        Timer timer;
+        timer.start();
+        MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+        timer.stop();
+        double cacheTime = timer.getElapsedTimeInMilliSec();
+
+        timer.start();
+        MeshOptimizer::optimizeVertexFetch(indices.data(), indices.size(), vertexCount);
+        timer.stop();
+        double fetchTime = timer.getElapsedTimeInMilliSec();
+
+        report("optimized", indices, vertexCount);
+        std::cout << "  vertex cache " << cacheTime << " ms, vertex fetch " << fetchTime << " ms" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+// Accuracy and speed of OrbitKernel on every target the CPU supports.
+// Each SIMD target is checked against the scalar reference: sincos over a
+// sweep of angles, a million bodies, half of them on eccentric inclined
+// orbits, evaluated at a few seconds and at a few months, and their model
+// matrices. Kepler's equation is checked on every target against bisection
+// in double. Then every kernel is timed per frame, and evaluate() at growing
+// time jumps. Exits with 1 when a target is off by more than the tolerances
+// below.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <Timer/Timer.h>
+#include <planet/BodyStore.h>
+#include <planet/OrbitKernel.h>
+
+static const float SINCOS_TOLERANCE = 4e-7f;   // absolute, |angle| <= 1e4
+static const float KEPLER_TOLERANCE = 1e-6f;   // radians, eccentricity up to 0.95
+static const float POSITION_TOLERANCE = 1e-5f; // relative to the orbit radius
+static const float MODEL_TOLERANCE = 1e-6f;    // relative to the matrix scale
+
+static void fillBodies(BodyStore &bodies, unsigned int count)
+{
+    bodies.clear();
+    bodies.reserve(count);
+    std::srand(1);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        unsigned int body = bodies.add(0.01f + (float)(std::rand() % 100) * 0.001f);
+        float radius = 0.1f + (float)(std::rand() % 1000) * 0.01f;
+        float speed = (float)(std::rand() % 2000 - 1000) * 0.005f;
+        if (i % 2 == 0)
+        {
+            bodies.orbitRadius[body] = radius;
+            bodies.setOrbitSpeed(body, speed);
+        }
+        else
+        {
+            OrbitalElements elements;
+            elements.semiMajorAxis = radius;
+            elements.eccentricity = (float)(std::rand() % 96) * 0.01f;
+            elements.inclination = (float)(std::rand() % 1000) * 0.00314f;
+            elements.ascendingNode = (float)(std::rand() % 2000 - 1000) * 0.00314f;
+            elements.periapsis = (float)(std::rand() % 2000 - 1000) * 0.00314f;
+            elements.meanAnomaly = (float)(std::rand() % 2000 - 1000) * 0.00314f;
+            elements.period = speed != 0.0f ? 6.28318531f / speed : 0.0f;
+            bodies.setOrbit(body, elements);
+        }
+        bodies.setSpin(body, (float)(std::rand() % 2000 - 1000) * 0.01f);
+        bodies.scale[body] = 0.5f + (float)(std::rand() % 100) * 0.01f;
+        bodies.centerY[body] = (float)(std::rand() % 100) * 0.01f;
+        if (i % 1000 != 0)
+            bodies.setParent(body, (int)(i - i % 1000));
+    }
+}
+
+static double timeMs(Timer &timer)
+{
+    timer.stop();
+    return timer.getElapsedTimeInMilliSec();
+}
+
+// E - e sin E = M by bisection, M in [-pi, pi]
+static double solveKeplerBisection(double mean, double e)
+{
+    double low = -4.0, high = 4.0;
+    for (int k = 0; k < 64; ++k)
+    {
+        double mid = 0.5 * (low + high);
+        if (mid - e * std::sin(mid) > mean)
+            high = mid;
+        else
+            low = mid;
+    }
+    return 0.5 * (low + high);
+}
+
+// largest offset difference to the reference, relative to the orbit radius
+static float orbitError(const BodyStore &bodies, const BodyStore &reference)
+{
+    float error = 0.0f;
+    for (std::size_t i = 0; i < bodies.size(); ++i)
+    {
+        float dx = bodies.offsetX[i] - reference.offsetX[i];
+        float dy = bodies.offsetY[i] - reference.offsetY[i];
+        float dz = bodies.offsetZ[i] - reference.offsetZ[i];
+        error = std::fmax(error, std::sqrt(dx * dx + dy * dy + dz * dz) / bodies.orbitRadius[i]);
+    }
+    return error;
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned int count = argc > 1 ? (unsigned int)std::atoi(argv[1]) : 1000000;
+    const double shortTime = 5.0;           // 300 frames at 60 Hz
+    const double longTime = 90.0 * 86400.0; // a season of real time
+    bool passed = true;
+
+    std::cout << "best target: " << OrbitKernel::getTargetName(OrbitKernel::getBestTarget()) << std::endl;
+
+    // reference results
+    std::vector<float> angles(1 << 20);
+    for (std::size_t i = 0; i < angles.size(); ++i)
+        angles[i] = -1e4f + 2e4f * (float)i / (float)angles.size();
+    std::vector<float> refSin(angles.size()), refCos(angles.size()), sines(angles.size()), cosines(angles.size());
+    OrbitKernel::sincos(angles.data(), refSin.data(), refCos.data(), angles.size(), ORBIT_KERNEL_SCALAR);
+
+    // a grid of mean anomalies and eccentricities
+    const std::size_t keplerMeans = 4096, keplerEccentricities = 96;
+    std::vector<float> means, eccentricities, anomalies(keplerMeans * keplerEccentricities);
+    std::vector<double> refAnomalies;
+    for (std::size_t e = 0; e < keplerEccentricities; ++e)
+        for (std::size_t m = 0; m < keplerMeans; ++m)
+        {
+            means.push_back(-3.14159265f + 6.2831853f * (float)m / (float)(keplerMeans - 1));
+            eccentricities.push_back((float)e * 0.01f);
+            refAnomalies.push_back(solveKeplerBisection(means.back(), eccentricities.back()));
+        }
+
+    BodyStore reference, referenceLong;
+    fillBodies(reference, count);
+    fillBodies(referenceLong, count);
+    OrbitKernel::evaluate(reference, 0, count, shortTime, ORBIT_KERNEL_SCALAR);
+    OrbitKernel::evaluate(referenceLong, 0, count, longTime, ORBIT_KERNEL_SCALAR);
+    // models take the spin angles at the store's time, a season in so the phases wrap many times
+    BodyStore modelBodies;
+    fillBodies(modelBodies, count);
+    modelBodies.setTime(longTime);
+    std::vector<float> refModels((std::size_t)count * 16), models((std::size_t)count * 16);
+    OrbitKernel::writeModels(modelBodies, NULL, count, refModels.data(), 16 * sizeof(float), ORBIT_KERNEL_SCALAR);
+
+    std::cout << std::setw(9) << "target" << std::setw(12) << "sincos err" << std::setw(12) << "kepler err" << std::setw(12) << "orbit err"
+              << std::setw(12) << "model err" << std::setw(14) << "sincos" << std::setw(14) << "evaluate" << std::setw(14) << "models" << std::endl;
+    for (int t = ORBIT_KERNEL_SCALAR; t < ORBIT_KERNEL_TARGET_COUNT; ++t)
+    {
+        OrbitKernelTarget target = (OrbitKernelTarget)t;
+        if (!OrbitKernel::isSupported(target))
+        {
+            std::cout << std::setw(9) << OrbitKernel::getTargetName(target) << "  not supported" << std::endl;
+            continue;
+        }
+
+        // accuracy against the scalar reference
+        OrbitKernel::sincos(angles.data(), sines.data(), cosines.data(), angles.size(), target);
+        float sincosError = 0.0f;
+        for (std::size_t i = 0; i < angles.size(); ++i)
+            sincosError = std::fmax(sincosError, std::fmax(std::fabs(sines[i] - refSin[i]), std::fabs(cosines[i] - refCos[i])));
+
+        OrbitKernel::solveKepler(means.data(), eccentricities.data(), anomalies.data(), means.size(), target);
+        double keplerError = 0.0;
+        for (std::size_t i = 0; i < means.size(); ++i)
+            keplerError = std::fmax(keplerError, std::fabs(anomalies[i] - refAnomalies[i]));
+
+        BodyStore bodies;
+        fillBodies(bodies, count);
+        OrbitKernel::evaluate(bodies, 0, count, shortTime, target);
+        float positionError = orbitError(bodies, reference);
+        OrbitKernel::evaluate(bodies, 0, count, longTime, target);
+        positionError = std::fmax(positionError, orbitError(bodies, referenceLong));
+
+        OrbitKernel::writeModels(modelBodies, NULL, count, models.data(), 16 * sizeof(float), target);
+        float modelError = 0.0f;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            float k = modelBodies.scale[i] * modelBodies.radius[i];
+            for (int e = 0; e < 12; ++e)
+                modelError = std::fmax(modelError, std::fabs(models[i * 16 + e] - refModels[i * 16 + e]) / k);
+            for (int e = 12; e < 16; ++e)
+                modelError = std::fmax(modelError, std::fabs(models[i * 16 + e] - refModels[i * 16 + e]));
+        }
+
+        bool ok = sincosError <= SINCOS_TOLERANCE && keplerError <= KEPLER_TOLERANCE && positionError <= POSITION_TOLERANCE &&
+                  modelError <= MODEL_TOLERANCE;
+        passed = passed && ok;
+
+        // speed, per call over the whole set
+        const int runs = 20;
+        Timer timer;
+        timer.start();
+        for (int r = 0; r < runs; ++r)
+            OrbitKernel::sincos(angles.data(), sines.data(), cosines.data(), count < angles.size() ? count : angles.size(), target);
+        double sincosMs = timeMs(timer) / runs;
+        timer.start();
+        for (int r = 0; r < runs; ++r)
+            OrbitKernel::evaluate(bodies, 0, count, shortTime + r / 60.0, target);
+        double evaluateMs = timeMs(timer) / runs;
+        timer.start();
+        for (int r = 0; r < runs; ++r)
+            OrbitKernel::writeModels(bodies, NULL, count, models.data(), 16 * sizeof(float), target);
+        double modelsMs = timeMs(timer) / runs;
+
+        std::cout << std::setw(9) << OrbitKernel::getTargetName(target) << std::scientific << std::setprecision(1)
+                  << std::setw(12) << sincosError << std::setw(12) << keplerError << std::setw(12) << positionError << std::setw(12) << modelError
+                  << std::fixed << std::setprecision(2) << std::setw(11) << sincosMs << " ms" << std::setw(11) << evaluateMs << " ms"
+                  << std::setw(11) << modelsMs << " ms" << (ok ? "" : "  FAILED") << std::endl;
+    }
+
+    // what BodyStore costs per frame with the best target, parents included: playing on,
+    // then jumping forwards and backwards by ever larger steps
+    BodyStore bodies;
+    fillBodies(bodies, count);
+    Timer timer;
+    timer.start();
+    for (int f = 0; f < 20; ++f)
+        bodies.update(1.0f / 60.0f);
+    std::cout << "BodyStore::update, " << count << " bodies: " << std::fixed << std::setprecision(2) << timeMs(timer) / 20 << " ms" << std::endl;
+    const double jumps[] = {1.0, 3600.0, 86400.0 * 365.0, -86400.0 * 365.0 * 100.0};
+    for (std::size_t j = 0; j < sizeof(jumps) / sizeof(jumps[0]); ++j)
+    {
+        timer.start();
+        for (int f = 0; f < 20; ++f)
+            bodies.setTime(bodies.getTime() + jumps[j]);
+        std::cout << "  setTime, steps of " << std::setw(12) << std::setprecision(0) << jumps[j] << " s: " << std::setprecision(2)
+                  << timeMs(timer) / 20 << " ms" << std::endl;
+    }
+
+    std::cout << (passed ? "all targets within tolerance" : "ACCURACY CHECK FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
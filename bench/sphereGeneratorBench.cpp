@@ -0,0 +1,126 @@
+// Triangle cost of the Sphere generators at equal silhouette error.
+// The worst silhouette error of an inscribed mesh is the largest gap between
+// the sphere and a triangle plane, r - min |n . v|. For a few on-screen radii
+// this finds the cheapest sectorCount of each type whose gap stays under half
+// a pixel, and prints the resulting triangle and vertex counts. Then it
+// checks the packed vertex format of each type: normals decoded the way the
+// vertex shaders do must stay within 2/255 of the float ones, so diffuse
+// light moves by at most 2 levels of an 8-bit channel. Exits with 1 when
+// they do not.
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <Sphere/Sphere.h>
+
+static float silhouetteError(const Sphere &sphere)
+{
+    const float *v = sphere.getVertices();
+    const unsigned int *indices = sphere.getIndices();
+    float minDistance = sphere.getRadius();
+    for (unsigned int i = 0; i < sphere.getIndexCount(); i += 3)
+    {
+        const float *a = v + indices[i] * 3;
+        const float *b = v + indices[i + 1] * 3;
+        const float *c = v + indices[i + 2] * 3;
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length == 0.0f)
+            continue; // degenerate
+        float distance = fabsf(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]) / length;
+        if (distance < minDistance)
+            minDistance = distance;
+    }
+    return sphere.getRadius() - minDistance;
+}
+
+// the octahedral normal of the packed vertices as octDecode() in the vertex shaders reads it
+static void decodeNormal(const short *packed, float *n)
+{
+    float ex = std::fmax(packed[0] / 32767.0f, -1.0f), ey = std::fmax(packed[1] / 32767.0f, -1.0f);
+    n[0] = ex;
+    n[1] = ey;
+    n[2] = 1.0f - std::fabs(ex) - std::fabs(ey);
+    float t = std::fmax(-n[2], 0.0f);
+    n[0] += n[0] >= 0.0f ? -t : t;
+    n[1] += n[1] >= 0.0f ? -t : t;
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    for (int k = 0; k < 3; ++k)
+        n[k] /= length;
+}
+
+// largest distance between the float normals and the decoded packed ones
+static float packedNormalError(Sphere &sphere)
+{
+    sphere.setPacked(true);
+    const short *packed = (const short *)sphere.getVertexData();
+    const float *normals = sphere.getNormals();
+    float maxError = 0.0f;
+    for (unsigned int i = 0; i < sphere.getVertexCount(); ++i)
+    {
+        float n[3];
+        decodeNormal(packed + i * 8 + 4, n);
+        float dx = n[0] - normals[i * 3], dy = n[1] - normals[i * 3 + 1], dz = n[2] - normals[i * 3 + 2];
+        maxError = std::fmax(maxError, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    return maxError;
+}
+
+// the error only shrinks as sectorCount grows, so bisect for the smallest that fits
+static int cheapestSectors(Sphere::Type type, float relativeError)
+{
+    int low = 4, high = 2048;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        Sphere sphere(1.0f, mid, mid / 2, true, 3, type);
+        if (silhouetteError(sphere) <= relativeError)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low;
+}
+
+int main()
+{
+    const char *names[] = {"uv", "ico", "cube"};
+    const int radii[] = {50, 200, 800, 2000};
+    const float tolerance = 0.5f; // pixels
+
+    for (int radius : radii)
+    {
+        std::cout << "radius " << radius << " px, error <= " << tolerance << " px" << std::endl;
+        unsigned int uvTriangles = 0;
+        for (int type = Sphere::TYPE_UV; type <= Sphere::TYPE_CUBE; ++type)
+        {
+            int sectors = cheapestSectors((Sphere::Type)type, tolerance / (float)radius);
+            Sphere sphere(1.0f, sectors, sectors / 2, true, 3, (Sphere::Type)type);
+            if (type == Sphere::TYPE_UV)
+                uvTriangles = sphere.getTriangleCount();
+            std::cout << "  " << std::left << std::setw(5) << names[type] << std::right
+                      << "sectors " << std::setw(4) << sectors
+                      << "  triangles " << std::setw(7) << sphere.getTriangleCount()
+                      << "  vertices " << std::setw(7) << sphere.getVertexCount()
+                      << "  error " << std::fixed << std::setprecision(3) << silhouetteError(sphere) * radius << " px"
+                      << "  " << std::setprecision(2) << (float)sphere.getTriangleCount() / uvTriangles << "x uv triangles"
+                      << std::defaultfloat << std::endl;
+        }
+    }
+
+    // |n . l - n' . l| <= |n - n'| for any light direction l
+    const float normalTolerance = 2.0f / 255.0f;
+    bool passed = true;
+    std::cout << "packed normals, error in 8-bit levels of diffuse light" << std::endl;
+    for (int type = Sphere::TYPE_UV; type <= Sphere::TYPE_CUBE; ++type)
+    {
+        Sphere sphere(1.0f, 256, 128, true, 3, (Sphere::Type)type);
+        float error = packedNormalError(sphere);
+        passed = passed && error <= normalTolerance;
+        std::cout << "  " << std::left << std::setw(5) << names[type] << std::right << std::fixed << std::setprecision(4)
+                  << error * 255.0f << std::defaultfloat << std::endl;
+    }
+    std::cout << (passed ? "packed normals within 2/255" : "PACKED NORMALS OFF BY MORE THAN 2/255") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Startup cost and size of the planet maps with and without the BC1 cache.
+// For every map this times the uncompressed path (JPG decode, resample and
+// RGB mip chain), a bake into the cache and a cache hit, and prints the layer
+// size of both formats and the PSNR of the BC1 top level. Running it also
+// leaves the baked files in the cache, ready for the first launch.
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <stb_image.h>
+#include <Timer/Timer.h>
+#include <renderer/TextureCache.h>
+#include <renderer/TextureLoader.h>
+
+static void decodeBC1Block(const unsigned char *block, unsigned char texels[16][3])
+{
+    unsigned short c[2] = {(unsigned short)(block[0] | block[1] << 8), (unsigned short)(block[2] | block[3] << 8)};
+    int palette[4][3];
+    for (int e = 0; e < 2; ++e)
+    {
+        int r = (c[e] >> 11) & 31, g = (c[e] >> 5) & 63, b = c[e] & 31;
+        palette[e][0] = (r << 3) | (r >> 2);
+        palette[e][1] = (g << 2) | (g >> 4);
+        palette[e][2] = (b << 3) | (b >> 2);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        if (c[0] > c[1])
+        {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        }
+        else
+        {
+            palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+            palette[3][i] = 0;
+        }
+    }
+    unsigned int indices = block[4] | block[5] << 8 | block[6] << 16 | (unsigned int)block[7] << 24;
+    for (int t = 0; t < 16; ++t)
+        for (int i = 0; i < 3; ++i)
+            texels[t][i] = (unsigned char)palette[(indices >> (2 * t)) & 3][i];
+}
+
+static double topLevelPsnr(const unsigned char *rgb, const unsigned char *blocks, int width, int height)
+{
+    double squared = 0.0;
+    unsigned char texels[16][3];
+    for (int by = 0; by < height / 4; ++by)
+        for (int bx = 0; bx < width / 4; ++bx)
+        {
+            decodeBC1Block(blocks + ((std::size_t)by * (width / 4) + bx) * 8, texels);
+            for (int t = 0; t < 16; ++t)
+            {
+                const unsigned char *p = rgb + ((std::size_t)(by * 4 + t / 4) * width + bx * 4 + t % 4) * 3;
+                for (int i = 0; i < 3; ++i)
+                {
+                    double d = (double)p[i] - texels[t][i];
+                    squared += d * d;
+                }
+            }
+        }
+    double mse = squared / ((double)width * height * 3);
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+int main(int argc, char **argv)
+{
+    const int width = 1024, height = 512;
+    std::string directory = argc > 1 ? argv[1] : "PlanetTextureMaps/cache";
+    const char *maps[] = {"sunmap.jpg", "mercurymap.jpg", "venusmap.jpg", "earthmap1k.jpg",
+                          "moonmap1k.jpg", "marsmap1k.jpg", "jupitermap.jpg", "neptunemap.jpg"};
+    TextureCache cache(directory);
+    stbi_set_flip_vertically_on_load_thread(1);
+
+    std::size_t rgbSize = TextureLoader::getMipChainSize(width, height, 3);
+    std::size_t bc1Size = TextureCache::getChainSize(width, height);
+    std::cout << "layer " << width << "x" << height << " with mips: RGB8 " << rgbSize / 1024 << " KiB, BC1 "
+              << bc1Size / 1024 << " KiB (" << std::fixed << std::setprecision(1) << (double)rgbSize / bc1Size << "x smaller)\n";
+    std::cout << std::setw(16) << "map" << std::setw(14) << "decode+mips" << std::setw(10) << "bake"
+              << std::setw(12) << "cache hit" << std::setw(10) << "PSNR" << "\n";
+
+    double totalDecode = 0.0, totalHit = 0.0;
+    for (unsigned int m = 0; m < sizeof(maps) / sizeof(maps[0]); ++m)
+    {
+        std::string path = std::string("PlanetTextureMaps/") + maps[m];
+        Timer timer;
+
+        // what every launch paid before the cache
+        timer.start();
+        int w, h, n;
+        unsigned char *data = stbi_load(path.c_str(), &w, &h, &n, 3);
+        if (!data)
+        {
+            std::cout << std::setw(16) << maps[m] << "  missing\n";
+            continue;
+        }
+        std::vector<unsigned char> rgb(rgbSize);
+        if (w == width && h == height)
+            std::copy(data, data + (std::size_t)width * height * 3, rgb.begin());
+        else
+            TextureLoader::resample(data, w, h, rgb.data(), width, height);
+        stbi_image_free(data);
+        TextureLoader::buildMipChain(rgb.data(), width, height, 3);
+        timer.stop();
+        double decodeMs = timer.getElapsedTimeInMilliSec();
+
+        std::vector<unsigned char> blocks;
+        std::vector<unsigned char> file;
+        {
+            FILE *f = std::fopen(path.c_str(), "rb");
+            std::fseek(f, 0, SEEK_END);
+            file.resize(std::ftell(f));
+            std::fseek(f, 0, SEEK_SET);
+            std::fread(file.data(), 1, file.size(), f);
+            std::fclose(f);
+        }
+        timer.start();
+        TextureCache::bake(file.data(), file.size(), width, height, blocks);
+        timer.stop();
+        double bakeMs = timer.getElapsedTimeInMilliSec();
+
+        // the first fetch writes the file, the second one is what a launch pays
+        cache.fetch(path, width, height, blocks);
+        timer.start();
+        cache.fetch(path, width, height, blocks);
+        timer.stop();
+        double hitMs = timer.getElapsedTimeInMilliSec();
+
+        totalDecode += decodeMs;
+        totalHit += hitMs;
+        std::cout << std::setw(16) << maps[m] << std::setw(12) << decodeMs << "ms" << std::setw(8) << bakeMs << "ms"
+                  << std::setw(10) << hitMs << "ms" << std::setw(8) << topLevelPsnr(rgb.data(), blocks.data() + TextureCache::getLevelOffset(width, height, 0), width, height) << "dB\n";
+    }
+    std::cout << std::setw(16) << "total" << std::setw(12) << totalDecode << "ms" << std::setw(18) << totalHit << "ms\n";
+    return 0;
+}
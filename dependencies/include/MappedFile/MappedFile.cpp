@@ -0,0 +1,83 @@
+#include "MappedFile.h"
+
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : data(NULL), size(0)
+{
+#if defined(WIN32) || defined(_WIN32)
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#endif
+}
+MappedFile::~MappedFile()
+{
+    close();
+}
+bool MappedFile::open(const std::string &path)
+{
+    close();
+#if defined(WIN32) || defined(_WIN32)
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping)
+        data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        close();
+        return false;
+    }
+    size = (std::size_t)fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *view = mmap(NULL, (std::size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+    data = (const unsigned char *)view;
+    size = (std::size_t)info.st_size;
+#endif
+    return true;
+}
+void MappedFile::close()
+{
+#if defined(WIN32) || defined(_WIN32)
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    mapping = NULL;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data)
+        munmap((void *)data, size);
+#endif
+    data = NULL;
+    size = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include <string>
+#include <cstddef>
+
+// Read-only view of a whole file mapped into memory, so large caches are paged
+// in on first touch instead of being copied through a read buffer.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // false when the file is missing or empty; any previous mapping is released
+    bool open(const std::string &path);
+    void close();
+
+    bool isOpen() const
+    {
+        return data != NULL;
+    };
+    const unsigned char *getData() const
+    {
+        return data;
+    };
+    std::size_t getSize() const
+    {
+        return size;
+    };
+
+private:
+    const unsigned char *data;
+    std::size_t size;
+#if defined(WIN32) || defined(_WIN32)
+    void *file;
+    void *mapping;
+#endif
+
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+};
+
+#endif
@@ -24,24 +24,162 @@
 #include <iostream>
 #include <iomanip>
 #include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 #include "Sphere.h"
+#include <meshOptimizer/MeshOptimizer.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <immintrin.h>
+#define SPHERE_HAS_SSE 1
+#endif
 
 // constants //////////////////////////////////////////////////////////////////
 const int MIN_SECTOR_COUNT = 2;
 const int MIN_STACK_COUNT = 2;
+const std::size_t STREAM_MIN_BYTES = 1 << 20; // smaller arrays are better left in the cache for upload()
+
+///////////////////////////////////////////////////////////////////////////////
+// worker threads kept for the life of the program, so a rebuild does not pay
+// for creating and joining threads; run() splits [0, rows) into contiguous
+// ranges, the calling thread takes the first and waits for the others
+///////////////////////////////////////////////////////////////////////////////
+class RowPool
+{
+public:
+    static RowPool &get()
+    {
+        static RowPool pool;
+        return pool;
+    }
+    int getThreadCount() const { return (int)workers.size() + 1; }
+
+    void run(int rows, int threads, const std::function<void(int, int)> &work)
+    {
+        std::lock_guard<std::mutex> running(runMutex); // one mesh at a time
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &work;
+            jobRows = rows;
+            jobThreads = threads;
+            remaining = threads - 1;
+            ++generation;
+        }
+        started.notify_all();
+        work(0, rows / threads);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return remaining == 0; });
+        job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex runMutex;
+    std::mutex mutex;
+    std::condition_variable started;
+    std::condition_variable finished;
+    const std::function<void(int, int)> *job = nullptr;
+    int jobRows = 0;
+    int jobThreads = 0;
+    int remaining = 0;
+    unsigned int generation = 0;
+    bool stopping = false;
+
+    RowPool()
+    {
+        int threads = (int)std::thread::hardware_concurrency();
+        for (int t = 1; t < threads; ++t)
+            workers.push_back(std::thread(&RowPool::work, this, t));
+    }
+    ~RowPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        started.notify_all();
+        for (std::size_t t = 0; t < workers.size(); ++t)
+            workers[t].join();
+    }
+
+    void work(int index)
+    {
+        unsigned int seen = 0;
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            started.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            if (index >= jobThreads)
+                continue;
+            const std::function<void(int, int)> &work = *job;
+            int first = (int)((long long)jobRows * index / jobThreads);
+            int last = (int)((long long)jobRows * (index + 1) / jobThreads);
+            lock.unlock();
+
+            work(first, last);
+
+            lock.lock();
+            if (--remaining == 0)
+                finished.notify_one();
+        }
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// run work(first, last) over [0, rows) split into contiguous ranges, one per
+// pool thread; small meshes stay on the calling thread
+///////////////////////////////////////////////////////////////////////////////
+template <class Work>
+static void forEachRowRange(int rows, std::size_t itemsPerRow, const Work &work)
+{
+    const std::size_t MIN_ITEMS_PER_THREAD = 32768;
+
+    std::size_t useful = (std::size_t)rows * itemsPerRow / MIN_ITEMS_PER_THREAD;
+    if (useful <= 1 || rows <= 1 || std::thread::hardware_concurrency() <= 1)
+    {
+        work(0, rows);
+        return;
+    }
+
+    RowPool &pool = RowPool::get();
+    int threads = pool.getThreadCount();
+    if ((std::size_t)threads > useful)
+        threads = (int)useful;
+    if (threads > rows)
+        threads = rows;
+    if (threads <= 1)
+    {
+        work(0, rows);
+        return;
+    }
+    pool.run(rows, threads, work);
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // ctor
 ///////////////////////////////////////////////////////////////////////////////
-Sphere::Sphere(float radius, int sectors, int stacks, bool smooth, int up) : interleavedStride(32)
+Sphere::Sphere(float radius, int sectors, int stacks, bool smooth, int up, Type type) : interleavedStride(32), optimized(false), packed(false), packedStride(16), dirty(true)
 {
-    set(radius, sectors, stacks, smooth, up);
+    set(radius, sectors, stacks, smooth, up, type);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // setters
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::set(float radius, int sectors, int stacks, bool smooth, int up)
+{
+    set(radius, sectors, stacks, smooth, up, type);
+}
+
+void Sphere::set(float radius, int sectors, int stacks, bool smooth, int up, Type type)
 {
     if (radius > 0)
         this->radius = radius;
@@ -55,29 +193,28 @@ void Sphere::set(float radius, int sectors, int stacks, bool smooth, int up)
     this->upAxis = up;
     if (up < 1 || up > 3)
         this->upAxis = 3;
+    this->type = type;
 
-    if (smooth)
-        buildVerticesSmooth();
-    else
-        buildVerticesFlat();
+    // built once, on the next access
+    dirty = true;
 }
 
 void Sphere::setRadius(float radius)
 {
     if (radius != this->radius)
-        set(radius, sectorCount, stackCount, smooth, upAxis);
+        set(radius, sectorCount, stackCount, smooth, upAxis, type);
 }
 
 void Sphere::setSectorCount(int sectors)
 {
     if (sectors != this->sectorCount)
-        set(radius, sectors, stackCount, smooth, upAxis);
+        set(radius, sectors, stackCount, smooth, upAxis, type);
 }
 
 void Sphere::setStackCount(int stacks)
 {
     if (stacks != this->stackCount)
-        set(radius, sectorCount, stacks, smooth, upAxis);
+        set(radius, sectorCount, stacks, smooth, upAxis, type);
 }
 
 void Sphere::setSmooth(bool smooth)
@@ -86,10 +223,7 @@ void Sphere::setSmooth(bool smooth)
         return;
 
     this->smooth = smooth;
-    if (smooth)
-        buildVerticesSmooth();
-    else
-        buildVerticesFlat();
+    dirty = true;
 }
 
 void Sphere::setUpAxis(int up)
@@ -97,8 +231,73 @@ void Sphere::setUpAxis(int up)
     if (this->upAxis == up || up < 1 || up > 3)
         return;
 
+    // a pending rebuild applies it anyway
+    if (dirty || cpuReleased)
+    {
+        this->upAxis = up;
+        dirty = true;
+        return;
+    }
+
     changeUpAxis(this->upAxis, up);
     this->upAxis = up;
+
+    if (packed)
+        buildPackedVertices();
+    gpuDirty = true;
+}
+
+void Sphere::setType(Type type)
+{
+    if (this->type == type)
+        return;
+
+    this->type = type;
+    dirty = true;
+}
+
+void Sphere::setOptimized(bool optimized)
+{
+    if (this->optimized == optimized)
+        return;
+
+    // turning it off keeps the current order, the next rebuild restores the row order
+    this->optimized = optimized;
+    if (dirty || cpuReleased)
+    {
+        dirty = true;
+        return;
+    }
+    if (optimized)
+    {
+        optimizeMesh();
+        if (packed)
+            buildPackedVertices();
+        gpuDirty = true;
+    }
+}
+
+void Sphere::setPacked(bool packed)
+{
+    if (this->packed == packed)
+        return;
+
+    this->packed = packed;
+    if (dirty || cpuReleased)
+    {
+        dirty = true;
+        return;
+    }
+    if (packed)
+    {
+        buildPackedVertices();
+    }
+    else
+    {
+        std::vector<short>().swap(packedVertices);
+        std::vector<unsigned short>().swap(shortIndices);
+    }
+    gpuDirty = true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -106,6 +305,8 @@ void Sphere::setUpAxis(int up)
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::reverseNormals()
 {
+    restoreCpuData();
+
     std::size_t i, j;
     std::size_t count = normals.size();
     for (i = 0, j = 3; i < count; i += 3, j += 8)
@@ -121,6 +322,7 @@ void Sphere::reverseNormals()
     }
 
     // also reverse triangle windings
+    indexedSectors = indexedStacks = 0;
     unsigned int tmp;
     count = indices.size();
     for (i = 0; i < count; i += 3)
@@ -129,6 +331,10 @@ void Sphere::reverseNormals()
         indices[i] = indices[i + 2];
         indices[i + 2] = tmp;
     }
+
+    if (packed)
+        buildPackedVertices();
+    gpuDirty = true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -136,6 +342,7 @@ void Sphere::reverseNormals()
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::printSelf() const
 {
+    ensureBuilt();
     std::cout << "===== Sphere =====\n"
               << "        Radius: " << radius << "\n"
               << "  Sector Count: " << sectorCount << "\n"
@@ -146,42 +353,226 @@ void Sphere::printSelf() const
               << "   Index Count: " << getIndexCount() << "\n"
               << "  Vertex Count: " << getVertexCount() << "\n"
               << "  Normal Count: " << getNormalCount() << "\n"
-              << "TexCoord Count: " << getTexCoordCount() << std::endl;
+              << "TexCoord Count: " << getTexCoordCount() << "\n"
+              << "     CPU Bytes: " << getMemoryUsage().cpuBytes << (cpuReleased ? " (released)" : "") << "\n"
+              << " Compact Bytes: " << getMemoryUsage().compactBytes << "\n"
+              << "     GPU Bytes: " << getMemoryUsage().gpuBytes << std::endl;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// draw a sphere in VertexArray mode
+// create VAO/VBO/EBO from the current format
 // OpenGL RC must be set before calling it
 ///////////////////////////////////////////////////////////////////////////////
-void Sphere::draw() const
+void Sphere::upload() const
 {
+    if (buffersInitialized && !gpuDirty && !dirty)
+        return;
+    ensureBuilt();
+
     if (!buffersInitialized)
     {
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
-        glBindVertexArray(VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferData(GL_ARRAY_BUFFER, interleavedVertices.size() * sizeof(float),
-                     interleavedVertices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                     indices.data(), GL_STATIC_DRAW);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, interleavedStride, (void *)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, interleavedStride, (void *)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        // texCoord
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, interleavedStride, (void *)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-
-        glBindVertexArray(0);
-        buffersInitialized = true;
+        gpuVertexCapacity = 0;
+        gpuIndexCapacity = 0;
     }
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    uploadBuffer(GL_ARRAY_BUFFER, getVertexData(), getVertexDataSize(), gpuVertexCapacity);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, getIndexData(), getIndexDataSize(), gpuIndexCapacity);
+
+    // the format may have changed since the last upload
+    int stride = getInterleavedStride();
+    if (packed)
+    {
+        // normal arrives as 2 octahedral components, decode it in the vertex shader
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (void *)0);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void *)(4 * sizeof(short)));
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)(6 * sizeof(short)));
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+
+    glBindVertexArray(0);
+    buffersInitialized = true;
+    gpuDirty = false;
+
+    // draw() must not depend on the CPU arrays, they may be released
+    gpuIndexCount = getIndexCount();
+    gpuIndexType = getIndexType();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// fill the bound buffer: a mesh that fits the current storage orphans it and
+// is copied in with glBufferSubData, a larger one reallocates
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::uploadBuffer(unsigned int target, const void *data, std::size_t size, std::size_t &capacity)
+{
+    if (size > 0 && size <= capacity)
+    {
+        glBufferData(target, capacity, NULL, GL_STATIC_DRAW);
+        glBufferSubData(target, 0, size, data);
+    }
+    else
+    {
+        glBufferData(target, size, data, GL_STATIC_DRAW);
+        capacity = size;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// free the CPU arrays; without an up-to-date GPU copy the sphere stays dirty,
+// so the next upload() rebuilds them instead of sending empty arrays
+// keepCompact keeps positions (6 bytes per vertex) and indices for picking
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::releaseCpuData(bool keepCompact)
+{
+    if (cpuReleased)
+        return;
+
+    if (keepCompact)
+    {
+        ensureBuilt();
+        std::size_t count = vertices.size();
+        compactPositions.resize(count);
+        float scale = 32767.0f / radius;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            float p = vertices[i] * scale;
+            p = p < -32767.0f ? -32767.0f : (p > 32767.0f ? 32767.0f : p);
+            compactPositions[i] = (short)lroundf(p);
+        }
+        if (count / 3 <= 65536)
+            compactShortIndices.assign(indices.begin(), indices.end());
+        else
+            compactIndices = indices;
+    }
+
+    clearArrays();
+    std::vector<float>().swap(interleavedVertices);
+    std::vector<short>().swap(packedVertices);
+    std::vector<unsigned short>().swap(shortIndices);
+    cpuReleased = true;
+    if (!buffersInitialized || gpuDirty)
+        dirty = true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rebuild the arrays of a released sphere before changing them
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::restoreCpuData()
+{
+    if (cpuReleased)
+        dirty = true;
+    ensureBuilt();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// run the rebuild left by the setters; the arrays are a cache of the
+// parameters, so this is logically const
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::ensureBuilt() const
+{
+    if (dirty)
+        const_cast<Sphere *>(this)->buildVertices();
+}
+
+SphereMemory Sphere::getMemoryUsage() const
+{
+    SphereMemory memory;
+    memory.cpuBytes = (vertices.capacity() + normals.capacity() + texCoords.capacity() + interleavedVertices.capacity()) * sizeof(float) +
+                      (indices.capacity() + lineIndices.capacity()) * sizeof(unsigned int) +
+                      (packedVertices.capacity() + shortIndices.capacity()) * sizeof(short);
+    memory.compactBytes = compactPositions.capacity() * sizeof(short) + compactShortIndices.capacity() * sizeof(unsigned short) +
+                          compactIndices.capacity() * sizeof(unsigned int);
+    memory.gpuBytes = buffersInitialized ? gpuVertexCapacity + gpuIndexCapacity : 0;
+    return memory;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ray/triangle test (Moller-Trumbore) against every triangle
+///////////////////////////////////////////////////////////////////////////////
+bool Sphere::intersectRay(const float origin[3], const float dir[3], float &t) const
+{
+    const float EPSILON = 0.000001f;
+
+    if (!cpuReleased)
+        ensureBuilt();
+    std::size_t indexCount;
+    if (!cpuReleased)
+        indexCount = indices.size();
+    else
+        indexCount = compactShortIndices.empty() ? compactIndices.size() : compactShortIndices.size();
+
+    float scale = radius / 32767.0f;
+    bool hit = false;
+    for (std::size_t i = 0; i < indexCount; i += 3)
+    {
+        float p[3][3];
+        for (int k = 0; k < 3; ++k)
+        {
+            if (!cpuReleased)
+            {
+                const float *v = &vertices[indices[i + k] * 3];
+                p[k][0] = v[0];
+                p[k][1] = v[1];
+                p[k][2] = v[2];
+            }
+            else
+            {
+                unsigned int index = compactShortIndices.empty() ? compactIndices[i + k] : compactShortIndices[i + k];
+                const short *v = &compactPositions[index * 3];
+                p[k][0] = v[0] * scale;
+                p[k][1] = v[1] * scale;
+                p[k][2] = v[2] * scale;
+            }
+        }
+
+        float e1[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+        float e2[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+        float q[3] = {dir[1] * e2[2] - dir[2] * e2[1], dir[2] * e2[0] - dir[0] * e2[2], dir[0] * e2[1] - dir[1] * e2[0]};
+        float det = e1[0] * q[0] + e1[1] * q[1] + e1[2] * q[2];
+        if (fabsf(det) < EPSILON * EPSILON)
+            continue; // parallel
+        float detInv = 1.0f / det;
+        float o[3] = {origin[0] - p[0][0], origin[1] - p[0][1], origin[2] - p[0][2]};
+        float u = (o[0] * q[0] + o[1] * q[1] + o[2] * q[2]) * detInv;
+        if (u < 0.0f || u > 1.0f)
+            continue;
+        float r[3] = {o[1] * e1[2] - o[2] * e1[1], o[2] * e1[0] - o[0] * e1[2], o[0] * e1[1] - o[1] * e1[0]};
+        float v = (dir[0] * r[0] + dir[1] * r[1] + dir[2] * r[2]) * detInv;
+        if (v < 0.0f || u + v > 1.0f)
+            continue;
+        float distance = (e2[0] * r[0] + e2[1] * r[1] + e2[2] * r[2]) * detInv;
+        if (distance >= 0.0f && (!hit || distance < t))
+        {
+            t = distance;
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// draw a sphere in VertexArray mode
+// OpenGL RC must be set before calling it
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::draw() const
+{
+    // no-op unless the mesh changed since the last upload
+    upload();
 
     glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(gpuIndexCount), gpuIndexType, 0);
     glBindVertexArray(0);
 }
 
@@ -240,6 +631,7 @@ void Sphere::updateRadius()
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::clearArrays()
 {
+    indexedSectors = indexedStacks = 0;
     std::vector<float>().swap(vertices);
     std::vector<float>().swap(normals);
     std::vector<float>().swap(texCoords);
@@ -247,6 +639,33 @@ void Sphere::clearArrays()
     std::vector<unsigned int>().swap(lineIndices);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// build vertices for the current type and shading
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::buildVertices()
+{
+    // every build regenerates the full CPU arrays, the GPU copy is refreshed by the next upload()
+    dirty = false;
+    gpuDirty = true;
+    cpuReleased = false;
+    std::vector<short>().swap(compactPositions);
+    std::vector<unsigned short>().swap(compactShortIndices);
+    std::vector<unsigned int>().swap(compactIndices);
+
+    // only the smooth UV builder keeps its indices across rebuilds
+    if (type != TYPE_UV || !smooth)
+        indexedSectors = indexedStacks = 0;
+
+    if (type == TYPE_ICO)
+        buildVerticesIco();
+    else if (type == TYPE_CUBE)
+        buildVerticesCube();
+    else if (smooth)
+        buildVerticesSmooth();
+    else
+        buildVerticesFlat();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // build vertices of sphere with smooth shading using parametric equation
 // x = r * cos(u) * cos(v)
@@ -259,88 +678,151 @@ void Sphere::buildVerticesSmooth()
 {
     const float PI = acos(-1.0f);
 
-    // clear memory of prev arrays
-    clearArrays();
-
-    float x, y, z, xy;                           // vertex position
-    float nx, ny, nz, lengthInv = 1.0f / radius; // normal
-    float s, t;                                  // texCoord
-
+    float lengthInv = 1.0f / radius; // normal
     float sectorStep = 2 * PI / sectorCount;
     float stackStep = PI / stackCount;
-    float sectorAngle, stackAngle;
 
-    for (int i = 0; i <= stackCount; ++i)
+    // every stack uses the same sector angles, so their sin/cos are computed once
+    std::vector<float> sectorCos(sectorCount + 1);
+    std::vector<float> sectorSin(sectorCount + 1);
+    for (int j = 0; j <= sectorCount; ++j)
     {
-        stackAngle = PI / 2 - i * stackStep; // starting from pi/2 to -pi/2
-        xy = radius * cosf(stackAngle);      // r * cos(u)
-        z = radius * sinf(stackAngle);       // r * sin(u)
-
-        // add (sectorCount+1) vertices per stack
-        // the first and last vertices have same position and normal, but different tex coords
-        for (int j = 0; j <= sectorCount; ++j)
-        {
-            sectorAngle = j * sectorStep; // starting from 0 to 2pi
-
-            // vertex position
-            x = xy * cosf(sectorAngle); // r * cos(u) * cos(v)
-            y = xy * sinf(sectorAngle); // r * cos(u) * sin(v)
-            addVertex(x, y, z);
-
-            // normalized vertex normal
-            nx = x * lengthInv;
-            ny = y * lengthInv;
-            nz = z * lengthInv;
-            addNormal(nx, ny, nz);
-
-            // vertex tex coord between [0, 1]
-            s = (float)j / sectorCount;
-            t = (float)i / stackCount;
-            addTexCoord(s, t);
-        }
+        float sectorAngle = j * sectorStep; // starting from 0 to 2pi
+        sectorCos[j] = cosf(sectorAngle);
+        sectorSin[j] = sinf(sectorAngle);
     }
 
-    // indices
-    //  k1--k1+1
-    //  |  / |
-    //  | /  |
-    //  k2--k2+1
-    unsigned int k1, k2;
-    for (int i = 0; i < stackCount; ++i)
+    // (sectorCount+1) vertices per stack
+    // the first and last vertices have same position and normal, but different tex coords
+    // arrays are sized exactly and overwritten in place, a rebuild reuses their memory
+    int columns = sectorCount + 1;
+    std::size_t vertexCount = (std::size_t)(stackCount + 1) * columns;
+    vertices.resize(vertexCount * 3);
+    normals.resize(vertexCount * 3);
+    texCoords.resize(vertexCount * 2);
+    interleavedVertices.resize(vertexCount * 8);
+
+    // the interleaved copy is only read back by upload(), so large meshes stream
+    // it past the cache instead of first reading every line they overwrite
+    bool streamInterleaved = vertexCount * 8 * sizeof(float) >= STREAM_MIN_BYTES && ((std::size_t)&interleavedVertices[0] & 15) == 0;
+
+    // stacks are independent, every range writes its own rows of all 4 arrays
+    forEachRowRange(stackCount + 1, columns, [&](int firstStack, int lastStack)
     {
-        k1 = i * (sectorCount + 1); // beginning of current stack
-        k2 = k1 + sectorCount + 1;  // beginning of next stack
-
-        for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+        for (int i = firstStack; i < lastStack; ++i)
         {
-            // 2 triangles per sector excluding 1st and last stacks
-            if (i != 0)
-            {
-                addIndices(k1, k2, k1 + 1); // k1---k2---k1+1
-            }
-
-            if (i != (stackCount - 1))
+            float stackAngle = PI / 2 - i * stackStep; // starting from pi/2 to -pi/2
+            float xy = radius * cosf(stackAngle);      // r * cos(u)
+            float z = radius * sinf(stackAngle);       // r * sin(u)
+            float nz = z * lengthInv;
+            float t = (float)i / stackCount;
+
+            std::size_t first = (std::size_t)i * columns;
+            float *v = &vertices[first * 3];
+            float *n = &normals[first * 3];
+            float *tc = &texCoords[first * 2];
+            float *iv = &interleavedVertices[first * 8];
+            for (int j = 0; j < columns; ++j, v += 3, n += 3, tc += 2, iv += 8)
             {
-                addIndices(k1 + 1, k2, k2 + 1); // k1+1---k2---k2+1
+                float x = xy * sectorCos[j]; // r * cos(u) * cos(v)
+                float y = xy * sectorSin[j]; // r * cos(u) * sin(v)
+                float nx = x * lengthInv;
+                float ny = y * lengthInv;
+                float s = (float)j / sectorCount;
+
+                v[0] = x;
+                v[1] = y;
+                v[2] = z;
+                n[0] = nx;
+                n[1] = ny;
+                n[2] = nz;
+                tc[0] = s;
+                tc[1] = t;
+#ifdef SPHERE_HAS_SSE
+                if (streamInterleaved)
+                {
+                    _mm_stream_ps(iv, _mm_set_ps(nx, z, y, x));
+                    _mm_stream_ps(iv + 4, _mm_set_ps(t, s, nz, ny));
+                    continue;
+                }
+#endif
+                iv[0] = x;
+                iv[1] = y;
+                iv[2] = z;
+                iv[3] = nx;
+                iv[4] = ny;
+                iv[5] = nz;
+                iv[6] = s;
+                iv[7] = t;
             }
+        }
+#ifdef SPHERE_HAS_SSE
+        if (streamInterleaved)
+            _mm_sfence(); // streamed stores are visible to the thread that waits for this range
+#endif
+    });
 
-            // vertical lines for all stacks
-            lineIndices.push_back(k1);
-            lineIndices.push_back(k2);
-            if (i != 0) // horizontal lines except 1st stack
+    // indices depend only on the grid; a rebuild of the same grid (a new radius
+    // or up axis) keeps them unless they were reordered or flipped since
+    if (indexedSectors != sectorCount || indexedStacks != stackCount)
+    {
+        // indices
+        //  k1--k1+1
+        //  |  / |
+        //  | /  |
+        //  k2--k2+1
+        // 1 triangle per sector in the first and last stacks, 2 in the others;
+        // vertical lines for all stacks, horizontal lines except 1st stack
+        indices.resize((std::size_t)6 * sectorCount * (stackCount - 1));
+        lineIndices.resize((std::size_t)sectorCount * (4 * stackCount - 2));
+        forEachRowRange(stackCount, sectorCount, [&](int firstStack, int lastStack)
+        {
+            for (int i = firstStack; i < lastStack; ++i)
             {
-                lineIndices.push_back(k1);
-                lineIndices.push_back(k1 + 1);
+                std::size_t row = i == 0 ? 0 : (std::size_t)sectorCount * (6 * i - 3);
+                std::size_t lineRow = i == 0 ? 0 : (std::size_t)sectorCount * (4 * i - 2);
+                unsigned int *tri = &indices[0] + row;
+                unsigned int *line = &lineIndices[0] + lineRow;
+
+                unsigned int k1 = i * columns; // beginning of current stack
+                unsigned int k2 = k1 + columns; // beginning of next stack
+                for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+                {
+                    if (i != 0)
+                    {
+                        *tri++ = k1; // k1---k2---k1+1
+                        *tri++ = k2;
+                        *tri++ = k1 + 1;
+                    }
+                    if (i != (stackCount - 1))
+                    {
+                        *tri++ = k1 + 1; // k1+1---k2---k2+1
+                        *tri++ = k2;
+                        *tri++ = k2 + 1;
+                    }
+
+                    *line++ = k1;
+                    *line++ = k2;
+                    if (i != 0)
+                    {
+                        *line++ = k1;
+                        *line++ = k1 + 1;
+                    }
+                }
             }
-        }
+        });
     }
-
-    // generate interleaved vertex array as well
-    buildInterleavedVertices();
+    indexedSectors = optimized ? 0 : sectorCount;
+    indexedStacks = optimized ? 0 : stackCount;
 
     // change up axis from Z-axis to the given
     if (this->upAxis != 3)
         changeUpAxis(3, this->upAxis);
+
+    if (optimized)
+        optimizeMesh();
+    if (packed)
+        buildPackedVertices();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -351,156 +833,540 @@ void Sphere::buildVerticesFlat()
 {
     const float PI = acos(-1.0f);
 
-    // tmp vertex definition (x,y,z,s,t)
-    struct Vertex
-    {
-        float x, y, z, s, t;
-    };
-    std::vector<Vertex> tmpVertices;
-
     float sectorStep = 2 * PI / sectorCount;
     float stackStep = PI / stackCount;
-    float sectorAngle, stackAngle;
 
-    // compute all vertices first, each vertex contains (x,y,z,s,t) except normal
+    // grid corners (x,y,z,s,t) come from per-sector and per-stack tables
+    std::vector<float> sectorCos(sectorCount + 1);
+    std::vector<float> sectorSin(sectorCount + 1);
+    for (int j = 0; j <= sectorCount; ++j)
+    {
+        float sectorAngle = j * sectorStep; // starting from 0 to 2pi
+        sectorCos[j] = cosf(sectorAngle);
+        sectorSin[j] = sinf(sectorAngle);
+    }
+    std::vector<float> stackXY(stackCount + 1);
+    std::vector<float> stackZ(stackCount + 1);
     for (int i = 0; i <= stackCount; ++i)
     {
-        stackAngle = PI / 2 - i * stackStep;  // starting from pi/2 to -pi/2
-        float xy = radius * cosf(stackAngle); // r * cos(u)
-        float z = radius * sinf(stackAngle);  // r * sin(u)
+        float stackAngle = PI / 2 - i * stackStep; // starting from pi/2 to -pi/2
+        stackXY[i] = radius * cosf(stackAngle);    // r * cos(u)
+        stackZ[i] = radius * sinf(stackAngle);     // r * sin(u)
+    }
 
-        // add (sectorCount+1) vertices per stack
-        // the first and last vertices have same position and normal, but different tex coords
-        for (int j = 0; j <= sectorCount; ++j)
+    // 3 vertices, 1 triangle and 2 or 4 line indices per sector in the first
+    // and last stacks, 4 vertices, 2 triangles and 4 line indices in the others;
+    // arrays are sized exactly and overwritten in place
+    std::size_t vertexCount = (std::size_t)sectorCount * (4 * stackCount - 2);
+    vertices.resize(vertexCount * 3);
+    normals.resize(vertexCount * 3);
+    texCoords.resize(vertexCount * 2);
+    interleavedVertices.resize(vertexCount * 8);
+    indices.resize((std::size_t)6 * sectorCount * (stackCount - 1));
+    lineIndices.resize((std::size_t)sectorCount * (4 * stackCount - 2));
+
+    forEachRowRange(stackCount, sectorCount * 4, [&](int firstStack, int lastStack)
+    {
+        float corner[4][5]; // v1, v2, v3, v4 as x,y,z,s,t
+        float n[3];         // 1 face normal
+        for (int i = firstStack; i < lastStack; ++i)
         {
-            sectorAngle = j * sectorStep; // starting from 0 to 2pi
-
-            Vertex vertex;
-            vertex.x = xy * cosf(sectorAngle); // x = r * cos(u) * cos(v)
-            vertex.y = xy * sinf(sectorAngle); // y = r * cos(u) * sin(v)
-            vertex.z = z;                      // z = r * sin(u)
-            vertex.s = (float)j / sectorCount; // s
-            vertex.t = (float)i / stackCount;  // t
-            tmpVertices.push_back(vertex);
+            unsigned int index = i == 0 ? 0 : (unsigned int)(sectorCount * (4 * i - 1)); // first vertex of the stack
+            unsigned int *tri = &indices[0] + (i == 0 ? 0 : (std::size_t)sectorCount * (6 * i - 3));
+            unsigned int *line = &lineIndices[0] + (i == 0 ? 0 : (std::size_t)sectorCount * (4 * i - 2));
+
+            for (int j = 0; j < sectorCount; ++j)
+            {
+                // get 4 vertices per sector
+                //  v1--v3
+                //  |    |
+                //  v2--v4
+                for (int k = 0; k < 4; ++k)
+                {
+                    int row = i + (k & 1);
+                    int column = j + (k >> 1);
+                    corner[k][0] = stackXY[row] * sectorCos[column]; // x = r * cos(u) * cos(v)
+                    corner[k][1] = stackXY[row] * sectorSin[column]; // y = r * cos(u) * sin(v)
+                    corner[k][2] = stackZ[row];                      // z = r * sin(u)
+                    corner[k][3] = (float)column / sectorCount;      // s
+                    corner[k][4] = (float)row / stackCount;          // t
+                }
+
+                // first stack: v1-v2-v4, last stack: v1-v2-v3, others: the quad v1-v2-v3-v4
+                int used[4] = {0, 1, 2, 3};
+                int count = 4;
+                if (i == 0)
+                {
+                    used[2] = 3;
+                    count = 3;
+                }
+                else if (i == (stackCount - 1))
+                {
+                    count = 3;
+                }
+                const float *a = corner[used[0]], *b = corner[used[1]], *c = corner[used[2]];
+                computeFaceNormal(a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1], c[2], n);
+
+                for (int k = 0; k < count; ++k)
+                {
+                    const float *p = corner[used[k]];
+                    std::size_t vi = index + k;
+                    float *v = &vertices[vi * 3];
+                    float *vn = &normals[vi * 3];
+                    float *tc = &texCoords[vi * 2];
+                    float *iv = &interleavedVertices[vi * 8];
+                    v[0] = iv[0] = p[0];
+                    v[1] = iv[1] = p[1];
+                    v[2] = iv[2] = p[2];
+                    vn[0] = iv[3] = n[0];
+                    vn[1] = iv[4] = n[1];
+                    vn[2] = iv[5] = n[2];
+                    tc[0] = iv[6] = p[3];
+                    tc[1] = iv[7] = p[4];
+                }
+
+                // triangles, and lines (first stack requires only vertical line)
+                *tri++ = index;
+                *tri++ = index + 1;
+                *tri++ = index + 2;
+                *line++ = index;
+                *line++ = index + 1;
+                if (i != 0)
+                {
+                    *line++ = index;
+                    *line++ = index + 2;
+                }
+                if (count == 4)
+                {
+                    *tri++ = index + 2;
+                    *tri++ = index + 1;
+                    *tri++ = index + 3;
+                }
+                index += count; // for next
+            }
         }
+    });
+
+    // change up axis from Z-axis to the given
+    if (this->upAxis != 3)
+        changeUpAxis(3, this->upAxis);
+
+    if (optimized)
+        optimizeMesh();
+    if (packed)
+        buildPackedVertices();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// build vertices of a geodesic sphere: every face of an icosahedron is split
+// into n x n triangles and the grid points are pushed onto the unit sphere.
+// The icosahedron has a vertex on each pole and two rings of 5 in between,
+// the lower ring turned by 36 degrees. An icosahedron edge spans atan(2)
+// radians, so n is chosen to put about sectorCount edges on a great circle.
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::buildVerticesIco()
+{
+    const float PI = acos(-1.0f);
+
+    int n = (int)lroundf(sectorCount * atanf(2.0f) / (2 * PI));
+    if (n < 1)
+        n = 1;
+
+    // 12 corners: north pole, upper ring, lower ring, south pole
+    float corners[12][3];
+    float ringZ = 1.0f / sqrtf(5.0f);
+    float ringXY = 2.0f / sqrtf(5.0f);
+    corners[0][0] = corners[0][1] = 0.0f;
+    corners[0][2] = 1.0f;
+    for (int i = 0; i < 5; ++i)
+    {
+        float upper = i * 2 * PI / 5;
+        float lower = upper + PI / 5;
+        corners[1 + i][0] = ringXY * cosf(upper);
+        corners[1 + i][1] = ringXY * sinf(upper);
+        corners[1 + i][2] = ringZ;
+        corners[6 + i][0] = ringXY * cosf(lower);
+        corners[6 + i][1] = ringXY * sinf(lower);
+        corners[6 + i][2] = -ringZ;
     }
+    corners[11][0] = corners[11][1] = 0.0f;
+    corners[11][2] = -1.0f;
 
-    // clear memory of prev arrays
-    clearArrays();
+    int faces[20][3];
+    for (int i = 0; i < 5; ++i)
+    {
+        int j = (i + 1) % 5;
+        int f[4][3] = {{0, 1 + i, 1 + j}, {1 + i, 6 + i, 1 + j}, {1 + j, 6 + i, 6 + j}, {11, 6 + j, 6 + i}};
+        for (int k = 0; k < 4; ++k)
+            for (int c = 0; c < 3; ++c)
+                faces[i * 4 + k][c] = f[k][c];
+    }
 
-    Vertex v1, v2, v3, v4; // 4 vertex positions and tex coords
-    std::vector<float> n;  // 1 face normal
+    // a grid point is a*A + b*B + c*C with a+b+c = n; the (corner, weight) pairs
+    // with non-zero weight identify it exactly, so shared edges are merged
+    std::vector<float> points;
+    std::vector<unsigned int> triangles;
+    std::unordered_map<unsigned long long, unsigned int> lookup;
+    std::vector<unsigned int> grid((n + 1) * (n + 2) / 2);
 
-    int i, j, k, vi1, vi2;
-    int index = 0; // index for vertex
-    for (i = 0; i < stackCount; ++i)
+    for (int f = 0; f < 20; ++f)
     {
-        vi1 = i * (sectorCount + 1); // index of tmpVertices
-        vi2 = (i + 1) * (sectorCount + 1);
+        const int *face = faces[f];
+        for (int i = 0; i <= n; ++i)
+        {
+            for (int j = 0; j <= i; ++j)
+            {
+                int weights[3] = {n - i, i - j, j};
+
+                // key: up to 3 sorted 16-bit (corner, weight) entries
+                unsigned int entries[3];
+                int count = 0;
+                for (int c = 0; c < 3; ++c)
+                    if (weights[c] > 0)
+                        entries[count++] = (unsigned int)(face[c] * (n + 1) + weights[c]);
+                for (int a = 1; a < count; ++a)
+                    for (int b = a; b > 0 && entries[b - 1] > entries[b]; --b)
+                    {
+                        unsigned int tmp = entries[b];
+                        entries[b] = entries[b - 1];
+                        entries[b - 1] = tmp;
+                    }
+                unsigned long long key = 0;
+                for (int c = 0; c < count; ++c)
+                    key = (key << 16) | entries[c];
+
+                std::unordered_map<unsigned long long, unsigned int>::iterator it = lookup.find(key);
+                if (it == lookup.end())
+                {
+                    float x = 0, y = 0, z = 0;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        x += weights[c] * corners[face[c]][0];
+                        y += weights[c] * corners[face[c]][1];
+                        z += weights[c] * corners[face[c]][2];
+                    }
+                    float lengthInv = 1.0f / sqrtf(x * x + y * y + z * z);
+                    unsigned int index = (unsigned int)points.size() / 3;
+                    points.push_back(x * lengthInv);
+                    points.push_back(y * lengthInv);
+                    points.push_back(z * lengthInv);
+                    it = lookup.insert(std::make_pair(key, index)).first;
+                }
+                grid[i * (i + 1) / 2 + j] = it->second;
+            }
+        }
 
-        for (j = 0; j < sectorCount; ++j, ++vi1, ++vi2)
+        // row i has i+1 points, each cell is (i,j) (i+1,j) (i+1,j+1) plus (i,j) (i+1,j+1) (i,j+1)
+        for (int i = 0; i < n; ++i)
         {
-            // get 4 vertices per sector
-            //  v1--v3
-            //  |    |
-            //  v2--v4
-            v1 = tmpVertices[vi1];
-            v2 = tmpVertices[vi2];
-            v3 = tmpVertices[vi1 + 1];
-            v4 = tmpVertices[vi2 + 1];
-
-            // if 1st stack and last stack, store only 1 triangle per sector
-            // otherwise, store 2 triangles (quad) per sector
-            if (i == 0) // a triangle for first stack ==========================
+            for (int j = 0; j <= i; ++j)
             {
-                // put a triangle
-                addVertex(v1.x, v1.y, v1.z);
-                addVertex(v2.x, v2.y, v2.z);
-                addVertex(v4.x, v4.y, v4.z);
-
-                // put tex coords of triangle
-                addTexCoord(v1.s, v1.t);
-                addTexCoord(v2.s, v2.t);
-                addTexCoord(v4.s, v4.t);
-
-                // put normal
-                n = computeFaceNormal(v1.x, v1.y, v1.z, v2.x, v2.y, v2.z, v4.x, v4.y, v4.z);
-                for (k = 0; k < 3; ++k) // same normals for 3 vertices
+                unsigned int k1 = grid[i * (i + 1) / 2 + j];
+                unsigned int k2 = grid[(i + 1) * (i + 2) / 2 + j];
+                unsigned int k3 = grid[(i + 1) * (i + 2) / 2 + j + 1];
+                triangles.push_back(k1);
+                triangles.push_back(k2);
+                triangles.push_back(k3);
+                if (j < i)
                 {
-                    addNormal(n[0], n[1], n[2]);
+                    triangles.push_back(k1);
+                    triangles.push_back(k3);
+                    triangles.push_back(grid[i * (i + 1) / 2 + j + 1]);
                 }
+            }
+        }
+    }
 
-                // put indices of 1 triangle
-                addIndices(index, index + 1, index + 2);
+    buildVerticesFromUnitMesh(points, triangles);
+}
 
-                // indices for line (first stack requires only vertical line)
-                lineIndices.push_back(index);
-                lineIndices.push_back(index + 1);
+///////////////////////////////////////////////////////////////////////////////
+// build vertices of a cube-sphere: an n x n grid on each face of the cube
+// [-1,1]^3, spaced by equal angles (tan) instead of equal lengths so the cells
+// stay close in size, then normalized. A great circle crosses 4 faces, so
+// n = sectorCount / 4, rounded up to even to put a vertex on each pole.
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::buildVerticesCube()
+{
+    const float PI = acos(-1.0f);
+
+    int n = (sectorCount + 3) / 4;
+    n += n & 1;
+    if (n < 2)
+        n = 2;
 
-                index += 3; // for next
+    // grid points are merged through their integer lattice coords in [-n, n]
+    std::vector<float> points;
+    std::vector<unsigned int> triangles;
+    std::unordered_map<unsigned long long, unsigned int> lookup;
+    std::vector<unsigned int> grid((n + 1) * (n + 1));
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int sign = -1; sign <= 1; sign += 2)
+        {
+            int uAxis = (axis + 1) % 3;
+            int vAxis = (axis + 2) % 3;
+            for (int i = 0; i <= n; ++i)
+            {
+                for (int j = 0; j <= n; ++j)
+                {
+                    int lattice[3];
+                    lattice[axis] = sign * n;
+                    lattice[uAxis] = 2 * i - n;
+                    lattice[vAxis] = 2 * j - n;
+                    unsigned long long key = ((unsigned long long)(lattice[0] + n) << 32) |
+                                             ((unsigned long long)(lattice[1] + n) << 16) |
+                                             (unsigned long long)(lattice[2] + n);
+
+                    std::unordered_map<unsigned long long, unsigned int>::iterator it = lookup.find(key);
+                    if (it == lookup.end())
+                    {
+                        float p[3];
+                        for (int c = 0; c < 3; ++c)
+                            p[c] = c == axis ? (float)sign : tanf(PI / 4 * lattice[c] / n);
+                        float lengthInv = 1.0f / sqrtf(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+                        unsigned int index = (unsigned int)points.size() / 3;
+                        points.push_back(p[0] * lengthInv);
+                        points.push_back(p[1] * lengthInv);
+                        points.push_back(p[2] * lengthInv);
+                        it = lookup.insert(std::make_pair(key, index)).first;
+                    }
+                    grid[i * (n + 1) + j] = it->second;
+                }
             }
-            else if (i == (stackCount - 1)) // a triangle for last stack =========
+
+            // k1--k1+1
+            // |  / |
+            // k2--k2+1
+            for (int i = 0; i < n; ++i)
             {
-                // put a triangle
-                addVertex(v1.x, v1.y, v1.z);
-                addVertex(v2.x, v2.y, v2.z);
-                addVertex(v3.x, v3.y, v3.z);
-
-                // put tex coords of triangle
-                addTexCoord(v1.s, v1.t);
-                addTexCoord(v2.s, v2.t);
-                addTexCoord(v3.s, v3.t);
-
-                // put normal
-                n = computeFaceNormal(v1.x, v1.y, v1.z, v2.x, v2.y, v2.z, v3.x, v3.y, v3.z);
-                for (k = 0; k < 3; ++k) // same normals for 3 vertices
+                for (int j = 0; j < n; ++j)
                 {
-                    addNormal(n[0], n[1], n[2]);
+                    unsigned int k1 = grid[i * (n + 1) + j];
+                    unsigned int k2 = grid[(i + 1) * (n + 1) + j];
+                    unsigned int k3 = grid[i * (n + 1) + j + 1];
+                    unsigned int k4 = grid[(i + 1) * (n + 1) + j + 1];
+                    triangles.push_back(k1);
+                    triangles.push_back(k2);
+                    triangles.push_back(k3);
+                    triangles.push_back(k3);
+                    triangles.push_back(k2);
+                    triangles.push_back(k4);
                 }
+            }
+        }
+    }
 
-                // put indices of 1 triangle
-                addIndices(index, index + 1, index + 2);
+    buildVerticesFromUnitMesh(points, triangles);
+}
 
-                // indices for lines (last stack requires both vert/hori lines)
-                lineIndices.push_back(index);
-                lineIndices.push_back(index + 1);
-                lineIndices.push_back(index);
-                lineIndices.push_back(index + 2);
+///////////////////////////////////////////////////////////////////////////////
+// turn a closed mesh of unit vectors into the sphere arrays
+// tex coords follow the UV sphere: s = longitude / 2pi, t = (pi/2 - latitude) / pi.
+// Triangles crossing the s = 0 meridian are cut along it, with s = 0 on one
+// side and s = 1 on the other, so no tex coord leaves [0,1] (the packed format
+// stores them as unorm16). Pole vertices get one copy per triangle with the
+// mean s of the other two corners.
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::buildVerticesFromUnitMesh(std::vector<float> &points, std::vector<unsigned int> &triangles)
+{
+    const float PI = acos(-1.0f);
+    const float EPSILON = 0.000001f;
 
-                index += 3; // for next
-            }
-            else // 2 triangles for others ====================================
+    // clear memory of prev arrays
+    clearArrays();
+
+    // wind every triangle counter-clockwise seen from outside
+    std::size_t triangleCount = triangles.size() / 3;
+    for (std::size_t i = 0; i < triangleCount; ++i)
+    {
+        const float *a = &points[triangles[i * 3] * 3];
+        const float *b = &points[triangles[i * 3 + 1] * 3];
+        const float *c = &points[triangles[i * 3 + 2] * 3];
+        float n[3];
+        computeFaceNormal(a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1], c[2], n);
+        if (n[0] * (a[0] + b[0] + c[0]) + n[1] * (a[1] + b[1] + c[1]) + n[2] * (a[2] + b[2] + c[2]) < 0)
+            std::swap(triangles[i * 3 + 1], triangles[i * 3 + 2]);
+    }
+
+    // side of the seam half-plane y = 0, x > 0: +1, -1, or 0 on it (poles included)
+    std::size_t pointCount = points.size() / 3;
+    std::vector<float> s(pointCount);
+    std::vector<int> side(pointCount);
+    std::vector<bool> pole(pointCount);
+    for (std::size_t i = 0; i < pointCount; ++i)
+    {
+        float x = points[i * 3], y = points[i * 3 + 1], z = points[i * 3 + 2];
+        pole[i] = fabsf(z) > 1.0f - EPSILON;
+        if (pole[i] || (fabsf(y) < EPSILON && x > 0))
+        {
+            s[i] = 0.0f;
+            side[i] = 0;
+        }
+        else
+        {
+            s[i] = atan2f(y, x) / (2 * PI);
+            if (s[i] < 0)
+                s[i] += 1.0f;
+            side[i] = y > 0 ? 1 : -1;
+        }
+    }
+
+    // copies for the s = 1 side: seam points, and edge/seam crossings (s = 0 copy, then s = 1 copy)
+    std::unordered_map<unsigned int, unsigned int> seamCopies;
+    std::unordered_map<unsigned long long, unsigned int> crossings;
+    std::vector<unsigned int> cut;
+    cut.reserve(triangles.size());
+    for (std::size_t i = 0; i < triangleCount; ++i)
+    {
+        const unsigned int *t = &triangles[i * 3];
+        float minS = 1.0f, maxS = 0.0f;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (pole[t[k]])
+                continue;
+            minS = s[t[k]] < minS ? s[t[k]] : minS;
+            maxS = s[t[k]] > maxS ? s[t[k]] : maxS;
+        }
+        if (maxS - minS <= 0.5f)
+        {
+            cut.insert(cut.end(), t, t + 3);
+            continue;
+        }
+
+        // clip against both sides of the seam, then fan the two convex pieces
+        for (int keep = 1; keep >= -1; keep -= 2)
+        {
+            unsigned int polygon[4];
+            int count = 0;
+            for (int k = 0; k < 3; ++k)
             {
-                // put quad vertices: v1-v2-v3-v4
-                addVertex(v1.x, v1.y, v1.z);
-                addVertex(v2.x, v2.y, v2.z);
-                addVertex(v3.x, v3.y, v3.z);
-                addVertex(v4.x, v4.y, v4.z);
-
-                // put tex coords of quad
-                addTexCoord(v1.s, v1.t);
-                addTexCoord(v2.s, v2.t);
-                addTexCoord(v3.s, v3.t);
-                addTexCoord(v4.s, v4.t);
-
-                // put normal
-                n = computeFaceNormal(v1.x, v1.y, v1.z, v2.x, v2.y, v2.z, v3.x, v3.y, v3.z);
-                for (k = 0; k < 4; ++k) // same normals for 4 vertices
+                unsigned int a = t[k], b = t[(k + 1) % 3];
+                if (side[a] == keep)
                 {
-                    addNormal(n[0], n[1], n[2]);
+                    polygon[count++] = a;
+                }
+                else if (side[a] == 0)
+                {
+                    if (keep > 0 || pole[a])
+                    {
+                        polygon[count++] = a;
+                    }
+                    else
+                    {
+                        std::unordered_map<unsigned int, unsigned int>::iterator it = seamCopies.find(a);
+                        if (it == seamCopies.end())
+                        {
+                            // copied out first, insert() may reallocate under its own range
+                            unsigned int index = (unsigned int)s.size();
+                            float corner[3] = {points[a * 3], points[a * 3 + 1], points[a * 3 + 2]};
+                            points.insert(points.end(), corner, corner + 3);
+                            s.push_back(1.0f);
+                            pole.push_back(false);
+                            it = seamCopies.insert(std::make_pair(a, index)).first;
+                        }
+                        polygon[count++] = it->second;
+                    }
                 }
 
-                // put indices of quad (2 triangles)
-                addIndices(index, index + 1, index + 2);
-                addIndices(index + 2, index + 1, index + 3);
+                if (side[a] * side[b] < 0)
+                {
+                    unsigned long long key = a < b ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+                    std::unordered_map<unsigned long long, unsigned int>::iterator it = crossings.find(key);
+                    if (it == crossings.end())
+                    {
+                        const float *pa = &points[a * 3];
+                        const float *pb = &points[b * 3];
+                        float f = pa[1] / (pa[1] - pb[1]);
+                        float p[3] = {pa[0] + f * (pb[0] - pa[0]), 0.0f, pa[2] + f * (pb[2] - pa[2])};
+                        float lengthInv = 1.0f / sqrtf(p[0] * p[0] + p[2] * p[2]);
+                        unsigned int index = (unsigned int)s.size();
+                        for (int copy = 0; copy < 2; ++copy)
+                        {
+                            points.push_back(p[0] * lengthInv);
+                            points.push_back(0.0f);
+                            points.push_back(p[2] * lengthInv);
+                            s.push_back((float)copy);
+                            pole.push_back(false);
+                        }
+                        it = crossings.insert(std::make_pair(key, index)).first;
+                    }
+                    polygon[count++] = it->second + (keep > 0 ? 0 : 1);
+                }
+            }
+            for (int k = 1; k + 1 < count; ++k)
+            {
+                cut.push_back(polygon[0]);
+                cut.push_back(polygon[k]);
+                cut.push_back(polygon[k + 1]);
+            }
+        }
+    }
 
-                // indices for lines
-                lineIndices.push_back(index);
-                lineIndices.push_back(index + 1);
-                lineIndices.push_back(index);
-                lineIndices.push_back(index + 2);
+    // one pole copy per triangle, s halfway between the other two corners
+    triangleCount = cut.size() / 3;
+    for (std::size_t i = 0; i < triangleCount; ++i)
+    {
+        unsigned int *t = &cut[i * 3];
+        for (int k = 0; k < 3; ++k)
+        {
+            if (!pole[t[k]])
+                continue;
+            unsigned int index = (unsigned int)s.size();
+            float corner[3] = {points[t[k] * 3], points[t[k] * 3 + 1], points[t[k] * 3 + 2]};
+            points.insert(points.end(), corner, corner + 3);
+            s.push_back((s[t[(k + 1) % 3]] + s[t[(k + 2) % 3]]) * 0.5f);
+            pole.push_back(false);
+            t[k] = index;
+        }
+    }
+
+    if (smooth)
+    {
+        pointCount = s.size();
+        for (std::size_t i = 0; i < pointCount; ++i)
+        {
+            const float *p = &points[i * 3];
+            addVertex(p[0] * radius, p[1] * radius, p[2] * radius);
+            addNormal(p[0], p[1], p[2]);
+            addTexCoord(s[i], acosf(p[2] < -1.0f ? -1.0f : (p[2] > 1.0f ? 1.0f : p[2])) / PI);
+        }
+        for (std::size_t i = 0; i < triangleCount; ++i)
+            addIndices(cut[i * 3], cut[i * 3 + 1], cut[i * 3 + 2]);
+    }
+    else
+    {
+        // no shared vertices, every corner takes the face normal
+        for (std::size_t i = 0; i < triangleCount; ++i)
+        {
+            const float *a = &points[cut[i * 3] * 3];
+            const float *b = &points[cut[i * 3 + 1] * 3];
+            const float *c = &points[cut[i * 3 + 2] * 3];
+            float n[3];
+            computeFaceNormal(a[0], a[1], a[2], b[0], b[1], b[2], c[0], c[1], c[2], n);
+            for (int k = 0; k < 3; ++k)
+            {
+                const float *p = &points[cut[i * 3 + k] * 3];
+                addVertex(p[0] * radius, p[1] * radius, p[2] * radius);
+                addNormal(n[0], n[1], n[2]);
+                addTexCoord(s[cut[i * 3 + k]], acosf(p[2] < -1.0f ? -1.0f : (p[2] > 1.0f ? 1.0f : p[2])) / PI);
+            }
+            addIndices((unsigned int)i * 3, (unsigned int)i * 3 + 1, (unsigned int)i * 3 + 2);
+        }
+    }
 
-                index += 4; // for next
+    // each inner edge is shared by 2 triangles in opposite directions, keep one
+    std::size_t count = indices.size();
+    for (std::size_t i = 0; i < count; i += 3)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int a = indices[i + k], b = indices[i + (k + 1) % 3];
+            if (a < b || !smooth)
+            {
+                lineIndices.push_back(a);
+                lineIndices.push_back(b);
             }
         }
     }
@@ -511,6 +1377,11 @@ void Sphere::buildVerticesFlat()
     // change up axis from Z-axis to the given
     if (this->upAxis != 3)
         changeUpAxis(3, this->upAxis);
+
+    if (optimized)
+        optimizeMesh();
+    if (packed)
+        buildPackedVertices();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -538,6 +1409,123 @@ void Sphere::buildInterleavedVertices()
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// generate packed vertices: 16 bytes per vertex
+// position: snorm16 x,y,z of (vertex / radius) plus 1 pad
+// normal:   octahedral encoding, 2 x snorm16
+// texCoord: 2 x unorm16
+// indices are also narrowed to 16 bits if every vertex is addressable
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::buildPackedVertices()
+{
+    std::vector<short>().swap(packedVertices);
+    std::vector<unsigned short>().swap(shortIndices);
+
+    std::size_t count = vertices.size() / 3;
+    packedVertices.resize(count * (packedStride / sizeof(short)));
+
+    float scale = 1.0f / radius;
+    short *dst = &packedVertices[0];
+    for (std::size_t i = 0; i < count; ++i, dst += 8)
+    {
+        const float *v = &vertices[i * 3];
+        const float *n = &normals[i * 3];
+        const float *t = &texCoords[i * 2];
+
+        for (int k = 0; k < 3; ++k)
+        {
+            float p = v[k] * scale;
+            p = p < -1.0f ? -1.0f : (p > 1.0f ? 1.0f : p);
+            dst[k] = (short)lroundf(p * 32767.0f);
+        }
+        dst[3] = 0;
+
+        // project onto the octahedron |x|+|y|+|z| = 1, fold the lower half over the diagonals
+        float l1 = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+        float ox = l1 > 0.0f ? n[0] / l1 : 0.0f;
+        float oy = l1 > 0.0f ? n[1] / l1 : 0.0f;
+        if (n[2] < 0.0f)
+        {
+            float fx = (1.0f - fabsf(oy)) * (ox >= 0.0f ? 1.0f : -1.0f);
+            float fy = (1.0f - fabsf(ox)) * (oy >= 0.0f ? 1.0f : -1.0f);
+            ox = fx;
+            oy = fy;
+        }
+        dst[4] = (short)lroundf(ox * 32767.0f);
+        dst[5] = (short)lroundf(oy * 32767.0f);
+
+        for (int k = 0; k < 2; ++k)
+        {
+            float s = t[k] < 0.0f ? 0.0f : (t[k] > 1.0f ? 1.0f : t[k]);
+            ((unsigned short *)dst)[6 + k] = (unsigned short)lroundf(s * 65535.0f);
+        }
+    }
+
+    if (count <= 65536)
+        shortIndices.assign(indices.begin(), indices.end());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// reorder triangles for vertex cache reuse, then renumber vertices in the order
+// they are first used, and apply the same permutation to every vertex array
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::optimizeMesh()
+{
+    std::size_t vertexCount = vertices.size() / 3;
+    MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), vertexCount);
+    std::vector<unsigned int> remap = MeshOptimizer::optimizeVertexFetch(indices.data(), indices.size(), vertexCount);
+
+    MeshOptimizer::remapVertices(vertices, 3, remap);
+    MeshOptimizer::remapVertices(normals, 3, remap);
+    MeshOptimizer::remapVertices(texCoords, 2, remap);
+    MeshOptimizer::remapVertices(interleavedVertices, 8, remap);
+
+    std::size_t count = lineIndices.size();
+    for (std::size_t i = 0; i < count; ++i)
+        lineIndices[i] = remap[lineIndices[i]];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// vertex/index data for the GPU in the selected format
+///////////////////////////////////////////////////////////////////////////////
+const void *Sphere::getVertexData() const
+{
+    ensureBuilt();
+    if (packed)
+        return packedVertices.data();
+    return interleavedVertices.data();
+}
+
+unsigned int Sphere::getVertexDataSize() const
+{
+    ensureBuilt();
+    if (packed)
+        return (unsigned int)packedVertices.size() * sizeof(short);
+    return getInterleavedVertexSize();
+}
+
+const void *Sphere::getIndexData() const
+{
+    ensureBuilt();
+    if (getIndexType() == GL_UNSIGNED_SHORT)
+        return shortIndices.data();
+    return indices.data();
+}
+
+unsigned int Sphere::getIndexDataSize() const
+{
+    ensureBuilt();
+    if (getIndexType() == GL_UNSIGNED_SHORT)
+        return (unsigned int)shortIndices.size() * sizeof(unsigned short);
+    return getIndexSize();
+}
+
+unsigned int Sphere::getIndexType() const
+{
+    ensureBuilt();
+    return (packed && !shortIndices.empty()) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // transform vertex/normal (x,y,z) coords
 // assume from/to values are validated: 1~3 and from != to
@@ -670,16 +1658,17 @@ void Sphere::addIndices(unsigned int i1, unsigned int i2, unsigned int i3)
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// return face normal of a triangle v1-v2-v3
-// if a triangle has no surface (normal length = 0), then return a zero vector
+// compute face normal of a triangle v1-v2-v3 into normal[3]
+// if a triangle has no surface (normal length = 0), then write a zero vector
 ///////////////////////////////////////////////////////////////////////////////
-std::vector<float> Sphere::computeFaceNormal(float x1, float y1, float z1, // v1
-                                             float x2, float y2, float z2, // v2
-                                             float x3, float y3, float z3) // v3
+void Sphere::computeFaceNormal(float x1, float y1, float z1, // v1
+                               float x2, float y2, float z2, // v2
+                               float x3, float y3, float z3, // v3
+                               float normal[3])
 {
     const float EPSILON = 0.000001f;
 
-    std::vector<float> normal(3, 0.0f); // default return value (0,0,0)
+    normal[0] = normal[1] = normal[2] = 0.0f; // default (0,0,0)
     float nx, ny, nz;
 
     // find 2 edge vectors: v1-v2, v1-v3
@@ -705,6 +1694,4 @@ std::vector<float> Sphere::computeFaceNormal(float x1, float y1, float z1, // v1
         normal[1] = ny * lengthInv;
         normal[2] = nz * lengthInv;
     }
-
-    return normal;
 }
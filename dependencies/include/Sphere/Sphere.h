@@ -5,6 +5,20 @@
 // The min number of sectors is 2 and the min number of stacks are 2.
 // The default up axis is +Z axis. You can change the up axis with setUpAxis():
 // X=1, Y=2, Z=3.
+// setPacked(true) switches the GPU vertex format from 32-byte V/N/T floats to
+// 16 bytes: snorm16 position (relative to radius), octahedral snorm16 normal
+// and unorm16 tex coords, with 16-bit indices when the mesh allows it.
+// setType() swaps the UV sphere for a subdivided icosahedron or a normalized
+// cube with the same radius, normals, tex coords and GPU formats. sectorCount
+// then sets the number of edges around a great circle and stackCount is unused.
+// upload() creates the VAO/VBO/EBO (draw() does it on first use) and
+// releaseCpuData() then frees the CPU arrays, optionally keeping a compact
+// position/index copy for intersectRay(); a sphere released before its upload
+// is rebuilt by it. getMemoryUsage() reports all three.
+// Setters only record the change; the mesh is rebuilt once, on the next access
+// or draw(), and an uploaded sphere refreshes its buffers in place.
+// setOptimized(true) reorders triangles for the post-transform vertex cache
+// and vertices for fetch locality (see MeshOptimizer) after every rebuild.
 //
 //  AUTHOR: Song Ho Ahn (song.ahn@gmail.com)
 // CREATED: 2017-11-01
@@ -15,12 +29,28 @@
 #define GEOMETRY_SPHERE_H
 
 #include <vector>
+#include <cstddef>
+
+// bytes held by a Sphere
+struct SphereMemory
+{
+    std::size_t cpuBytes;     // vertex/normal/texCoord/index/line/interleaved/packed arrays
+    std::size_t compactBytes; // snorm16 positions and indices kept by releaseCpuData(true)
+    std::size_t gpuBytes;     // VBO + EBO
+};
 
 class Sphere
 {
 public:
+    enum Type
+    {
+        TYPE_UV,   // sectors x stacks (default)
+        TYPE_ICO,  // geodesic subdivision of an icosahedron with a vertex on each pole
+        TYPE_CUBE  // equal-angle grid on each cube face, pushed onto the sphere
+    };
+
     // ctor/dtor
-    Sphere(float radius = 1.0f, int sectorCount = 36, int stackCount = 18, bool smooth = true, int up = 3);
+    Sphere(float radius = 1.0f, int sectorCount = 36, int stackCount = 18, bool smooth = true, int up = 3, Type type = TYPE_UV);
     ~Sphere() {}
 
     // getters/setters
@@ -28,37 +58,69 @@ public:
     int getSectorCount() const { return sectorCount; }
     int getStackCount() const { return stackCount; }
     int getUpAxis() const { return upAxis; }
-    void set(float radius, int sectorCount, int stackCount, bool smooth = true, int up = 3);
+    Type getType() const { return type; }
+    void set(float radius, int sectorCount, int stackCount, bool smooth = true, int up = 3); // keeps the type
+    void set(float radius, int sectorCount, int stackCount, bool smooth, int up, Type type);
     void setRadius(float radius);
     void setSectorCount(int sectorCount);
     void setStackCount(int stackCount);
     void setSmooth(bool smooth);
     void setUpAxis(int up);
+    void setType(Type type);
+    void setPacked(bool packed);
+    bool isPacked() const { return packed; }
+    void setOptimized(bool optimized);
+    bool isOptimized() const { return optimized; }
     void reverseNormals();
 
     // for vertex data
-    unsigned int getVertexCount() const { return (unsigned int)vertices.size() / 3; }
-    unsigned int getNormalCount() const { return (unsigned int)normals.size() / 3; }
-    unsigned int getTexCoordCount() const { return (unsigned int)texCoords.size() / 2; }
-    unsigned int getIndexCount() const { return (unsigned int)indices.size(); }
-    unsigned int getLineIndexCount() const { return (unsigned int)lineIndices.size(); }
+    unsigned int getVertexCount() const { ensureBuilt(); return (unsigned int)vertices.size() / 3; }
+    unsigned int getNormalCount() const { ensureBuilt(); return (unsigned int)normals.size() / 3; }
+    unsigned int getTexCoordCount() const { ensureBuilt(); return (unsigned int)texCoords.size() / 2; }
+    unsigned int getIndexCount() const { ensureBuilt(); return (unsigned int)indices.size(); }
+    unsigned int getLineIndexCount() const { ensureBuilt(); return (unsigned int)lineIndices.size(); }
     unsigned int getTriangleCount() const { return getIndexCount() / 3; }
-    unsigned int getVertexSize() const { return (unsigned int)vertices.size() * sizeof(float); }
-    unsigned int getNormalSize() const { return (unsigned int)normals.size() * sizeof(float); }
-    unsigned int getTexCoordSize() const { return (unsigned int)texCoords.size() * sizeof(float); }
-    unsigned int getIndexSize() const { return (unsigned int)indices.size() * sizeof(unsigned int); }
-    unsigned int getLineIndexSize() const { return (unsigned int)lineIndices.size() * sizeof(unsigned int); }
-    const float *getVertices() const { return vertices.data(); }
-    const float *getNormals() const { return normals.data(); }
-    const float *getTexCoords() const { return texCoords.data(); }
-    const unsigned int *getIndices() const { return indices.data(); }
-    const unsigned int *getLineIndices() const { return lineIndices.data(); }
+    unsigned int getVertexSize() const { ensureBuilt(); return (unsigned int)vertices.size() * sizeof(float); }
+    unsigned int getNormalSize() const { ensureBuilt(); return (unsigned int)normals.size() * sizeof(float); }
+    unsigned int getTexCoordSize() const { ensureBuilt(); return (unsigned int)texCoords.size() * sizeof(float); }
+    unsigned int getIndexSize() const { ensureBuilt(); return (unsigned int)indices.size() * sizeof(unsigned int); }
+    unsigned int getLineIndexSize() const { ensureBuilt(); return (unsigned int)lineIndices.size() * sizeof(unsigned int); }
+    const float *getVertices() const { ensureBuilt(); return vertices.data(); }
+    const float *getNormals() const { ensureBuilt(); return normals.data(); }
+    const float *getTexCoords() const { ensureBuilt(); return texCoords.data(); }
+    const unsigned int *getIndices() const { ensureBuilt(); return indices.data(); }
+    const unsigned int *getLineIndices() const { ensureBuilt(); return lineIndices.data(); }
 
     // for interleaved vertices: V/N/T
     unsigned int getInterleavedVertexCount() const { return getVertexCount(); }                                        // # of vertices
-    unsigned int getInterleavedVertexSize() const { return (unsigned int)interleavedVertices.size() * sizeof(float); } // # of bytes
-    int getInterleavedStride() const { return interleavedStride; }                                                     // should be 32 bytes
-    const float *getInterleavedVertices() const { return interleavedVertices.data(); }
+    unsigned int getInterleavedVertexSize() const { ensureBuilt(); return (unsigned int)interleavedVertices.size() * sizeof(float); } // # of bytes
+    int getInterleavedStride() const { return packed ? packedStride : interleavedStride; }                             // 32 bytes, 16 if packed
+    const float *getInterleavedVertices() const { ensureBuilt(); return interleavedVertices.data(); }
+
+    // GPU-ready vertex/index data in the selected format
+    // packed positions are in units of the radius, scale them by getPositionScale()
+    const void *getVertexData() const;
+    unsigned int getVertexDataSize() const;
+    const void *getIndexData() const;
+    unsigned int getIndexDataSize() const;
+    unsigned int getIndexType() const; // GL_UNSIGNED_INT or GL_UNSIGNED_SHORT
+    float getPositionScale() const { return packed ? radius : 1.0f; }
+
+    // attribute-less mode: no buffers, proceduralVertexShader.glsl rebuilds vertex n of
+    // this many from gl_VertexID, in the triangle order of buildVerticesSmooth() (TYPE_UV only)
+    static unsigned int getProceduralVertexCount(int sectorCount, int stackCount) { return 6u * sectorCount * (stackCount - 1); }
+    unsigned int getProceduralVertexCount() const { return getProceduralVertexCount(sectorCount, stackCount); }
+
+    // residency: upload needs a GL context, released arrays come back on the next rebuild
+    void upload() const;
+    void releaseCpuData(bool keepCompact = false);
+    bool isCpuResident() const { return !cpuReleased; }
+    bool isUploaded() const { return buffersInitialized; }
+    SphereMemory getMemoryUsage() const;
+
+    // nearest hit of origin + t * dir with the mesh (object space, t >= 0),
+    // from the full arrays or the compact copy; false if neither is kept
+    bool intersectRay(const float origin[3], const float dir[3], float &t) const;
 
     // draw in VertexArray mode
     void draw() const;                                  // draw surface
@@ -71,18 +133,28 @@ public:
 protected:
 private:
     // member functions
+    void buildVertices();
+    void restoreCpuData();
+    void ensureBuilt() const;
+    static void uploadBuffer(unsigned int target, const void *data, std::size_t size, std::size_t &capacity);
     void buildVerticesSmooth();
     void buildVerticesFlat();
+    void buildVerticesIco();
+    void buildVerticesCube();
+    void buildVerticesFromUnitMesh(std::vector<float> &points, std::vector<unsigned int> &triangles);
     void buildInterleavedVertices();
+    void buildPackedVertices();
+    void optimizeMesh();
     void changeUpAxis(int from, int to);
     void clearArrays();
     void addVertex(float x, float y, float z);
     void addNormal(float x, float y, float z);
     void addTexCoord(float s, float t);
     void addIndices(unsigned int i1, unsigned int i2, unsigned int i3);
-    std::vector<float> computeFaceNormal(float x1, float y1, float z1,
-                                         float x2, float y2, float z2,
-                                         float x3, float y3, float z3);
+    void computeFaceNormal(float x1, float y1, float z1,
+                           float x2, float y2, float z2,
+                           float x3, float y3, float z3,
+                           float normal[3]);
 
     // memeber vars
     float radius;
@@ -90,6 +162,7 @@ private:
     int stackCount;  // latitude, # of stacks
     bool smooth;
     int upAxis; // +X=1, +Y=2, +z=3 (default)
+    Type type;
     std::vector<float> vertices;
     std::vector<float> normals;
     std::vector<float> texCoords;
@@ -99,11 +172,35 @@ private:
     // interleaved
     std::vector<float> interleavedVertices;
     int interleavedStride;
+
+    bool optimized;
+
+    // packed: snorm16 x,y,z,pad | snorm16 octahedral normal | unorm16 s,t
+    bool packed;
+    std::vector<short> packedVertices;
+    std::vector<unsigned short> shortIndices; // only when packed and < 65536 vertices
+    int packedStride;
+    bool dirty; // parameters changed since the last build
+    int indexedSectors = 0; // grid the smooth UV indices were generated for, 0 when
+    int indexedStacks = 0;  // they hold anything else
+
+    // after releaseCpuData(): snorm16 x,y,z relative to radius, and indices
+    // (16-bit when every vertex is addressable)
+    bool cpuReleased = false;
+    std::vector<short> compactPositions;
+    std::vector<unsigned short> compactShortIndices;
+    std::vector<unsigned int> compactIndices;
+
     //to use vertexpointt
     mutable unsigned int VAO = 0;
     mutable unsigned int VBO = 0;
     mutable unsigned int EBO = 0;
     mutable bool buffersInitialized = false;
+    mutable bool gpuDirty = false; // arrays changed since the last upload
+    mutable unsigned int gpuIndexCount = 0;
+    mutable unsigned int gpuIndexType = 0;
+    mutable std::size_t gpuVertexCapacity = 0;
+    mutable std::size_t gpuIndexCapacity = 0;
 };
 
 #endif
@@ -0,0 +1,68 @@
+#include <glad/glad.h>
+#include "SphereLod.h"
+#include "Sphere.h"
+
+SphereLod::SphereLod(int minSectors, int maxSectors, bool packed) : interleavedStride(32), indexType(GL_UNSIGNED_SHORT), packed(packed)
+{
+    if (minSectors < 4)
+        minSectors = 4;
+    if (maxSectors < minSectors)
+        maxSectors = minSectors;
+
+    std::vector<Sphere> spheres;
+    for (int sectors = minSectors; sectors <= maxSectors; sectors *= 2)
+    {
+        spheres.push_back(Sphere(1.0f, sectors, sectors / 2));
+        spheres.back().setOptimized(true);
+        spheres.back().setPacked(packed);
+        if (spheres.back().getIndexType() != GL_UNSIGNED_SHORT)
+            indexType = GL_UNSIGNED_INT;
+    }
+
+    for (std::size_t i = 0; i < spheres.size(); ++i)
+    {
+        const Sphere &sphere = spheres[i];
+        interleavedStride = sphere.getInterleavedStride();
+
+        SphereLevel level;
+        level.sectorCount = sphere.getSectorCount();
+        level.stackCount = sphere.getStackCount();
+        level.baseVertex = (unsigned int)(vertexData.size() / interleavedStride);
+        level.vertexCount = sphere.getVertexCount();
+        level.firstIndex = (unsigned int)(indexData.size() / getIndexTypeSize());
+        level.indexCount = sphere.getIndexCount();
+        levels.push_back(level);
+
+        const unsigned char *vertices = (const unsigned char *)sphere.getVertexData();
+        vertexData.insert(vertexData.end(), vertices, vertices + sphere.getVertexDataSize());
+
+        // a level with 32-bit indices forces the whole chain to 32 bits
+        if (indexType == sphere.getIndexType())
+        {
+            const unsigned char *indices = (const unsigned char *)sphere.getIndexData();
+            indexData.insert(indexData.end(), indices, indices + sphere.getIndexDataSize());
+        }
+        else
+        {
+            const unsigned char *indices = (const unsigned char *)sphere.getIndices();
+            indexData.insert(indexData.end(), indices, indices + sphere.getIndexSize());
+        }
+    }
+}
+
+unsigned int SphereLod::getIndexTypeSize() const
+{
+    return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+}
+
+int SphereLod::selectLevel(float screenRadius, float pixelsPerEdge) const
+{
+    // sectors needed so that each edge along the equator spans about pixelsPerEdge
+    float sectorsNeeded = 6.2831853f * screenRadius / pixelsPerEdge;
+    for (int i = 0; i < (int)levels.size(); ++i)
+    {
+        if (levels[i].sectorCount >= sectorsNeeded)
+            return i;
+    }
+    return (int)levels.size() - 1;
+}
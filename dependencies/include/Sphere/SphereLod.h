@@ -0,0 +1,52 @@
+#ifndef GEOMETRY_SPHERE_LOD_H
+#define GEOMETRY_SPHERE_LOD_H
+
+#include <vector>
+
+// one tessellation level inside the shared LOD buffers
+struct SphereLevel
+{
+    int sectorCount;
+    int stackCount;
+    unsigned int baseVertex; // added to every index of the level
+    unsigned int vertexCount;
+    unsigned int firstIndex; // offset into the index array
+    unsigned int indexCount;
+};
+
+// Chain of unit spheres from minSectors x minSectors/2 up to maxSectors x maxSectors/2,
+// doubling each level. All levels share one vertex array and one index array in the
+// Sphere vertex format (packed by default), reordered for the vertex cache; each level's indices start from 0 and
+// are drawn with its base vertex, so 16-bit indices suffice while every single
+// level stays under 65536 vertices.
+class SphereLod
+{
+public:
+    SphereLod(int minSectors = 8, int maxSectors = 256, bool packed = true);
+
+    int getLevelCount() const { return (int)levels.size(); }
+    const SphereLevel &getLevel(int level) const { return levels[level]; }
+
+    // coarsest level whose equator edges span at most pixelsPerEdge for a sphere of the given screen
+    // radius, the finest level when none is fine enough
+    int selectLevel(float screenRadius, float pixelsPerEdge) const;
+
+    bool isPacked() const { return packed; }
+    int getInterleavedStride() const { return interleavedStride; }
+    unsigned int getIndexType() const { return indexType; }
+    unsigned int getIndexTypeSize() const;
+    unsigned int getVertexDataSize() const { return (unsigned int)vertexData.size(); }
+    unsigned int getIndexDataSize() const { return (unsigned int)indexData.size(); }
+    const void *getVertexData() const { return vertexData.data(); }
+    const void *getIndexData() const { return indexData.data(); }
+
+private:
+    std::vector<SphereLevel> levels;
+    std::vector<unsigned char> vertexData;
+    std::vector<unsigned char> indexData;
+    int interleavedStride;
+    unsigned int indexType;
+    bool packed;
+};
+
+#endif
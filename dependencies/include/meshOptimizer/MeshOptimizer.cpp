@@ -0,0 +1,218 @@
+#include "MeshOptimizer.h"
+#include <cmath>
+
+namespace
+{
+    // Forsyth scoring parameters, from "Linear-Speed Vertex Cache Optimisation"
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    const unsigned int MAX_VALENCE = 32; // valence boost is tabulated up to this many live triangles
+
+    struct ScoreTables
+    {
+        float cache[CACHE_SIZE];
+        float valence[MAX_VALENCE];
+
+        ScoreTables()
+        {
+            for (int i = 0; i < CACHE_SIZE; ++i)
+            {
+                // used by the last triangle: fixed score so it is not favoured too much
+                if (i < 3)
+                    cache[i] = LAST_TRIANGLE_SCORE;
+                else
+                    cache[i] = powf(1.0f - (float)(i - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+            }
+            valence[0] = 0.0f;
+            for (unsigned int i = 1; i < MAX_VALENCE; ++i)
+                valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+        }
+    };
+    const ScoreTables SCORES;
+
+    float vertexScore(int cachePosition, unsigned int liveTriangles)
+    {
+        if (liveTriangles == 0)
+            return -1.0f; // nothing left to draw with this vertex
+
+        float score = cachePosition >= 0 ? SCORES.cache[cachePosition] : 0.0f;
+
+        // boost vertices with few triangles left so they get finished off
+        if (liveTriangles < MAX_VALENCE)
+            score += SCORES.valence[liveTriangles];
+        else
+            score += VALENCE_BOOST_SCALE * powf((float)liveTriangles, -VALENCE_BOOST_POWER);
+        return score;
+    }
+}
+
+VertexCacheStats MeshOptimizer::analyzeVertexCache(const unsigned int *indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize)
+{
+    VertexCacheStats stats;
+    stats.misses = 0;
+
+    // FIFO: a vertex is cached if it entered within the last cacheSize misses
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    for (std::size_t i = 0; i < indexCount; ++i)
+    {
+        unsigned int v = indices[i];
+        if (time - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = time++;
+            ++stats.misses;
+        }
+    }
+
+    std::size_t triangles = indexCount / 3;
+    stats.acmr = triangles ? (float)stats.misses / triangles : 0.0f;
+    stats.atvr = vertexCount ? (float)stats.misses / vertexCount : 0.0f;
+    return stats;
+}
+
+void MeshOptimizer::optimizeVertexCache(unsigned int *indices, std::size_t indexCount, std::size_t vertexCount)
+{
+    std::size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles adjacency in one flat array
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (std::size_t i = 0; i < indexCount; ++i)
+        ++liveTriangles[indices[i]];
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+    std::vector<unsigned int> adjacency(indexCount);
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (std::size_t i = 0; i < indexCount; ++i)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        score[v] = vertexScore(-1, liveTriangles[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    std::vector<char> emitted(triangleCount, 0);
+    for (std::size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<unsigned int> result(indexCount);
+    int cache[CACHE_SIZE + 3];
+    int cacheCount = 0;
+    std::size_t scanPosition = 0; // fallback search when nothing in the cache is usable
+
+    long best = 0;
+    for (std::size_t t = 1; t < triangleCount; ++t)
+        if (triangleScore[t] > triangleScore[best])
+            best = (long)t;
+
+    for (std::size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (best < 0)
+        {
+            // cache exhausted: take the next triangle still waiting in input order
+            while (emitted[scanPosition])
+                ++scanPosition;
+            best = (long)scanPosition;
+        }
+
+        const unsigned int *tri = indices + best * 3;
+        result[emittedCount * 3] = tri[0];
+        result[emittedCount * 3 + 1] = tri[1];
+        result[emittedCount * 3 + 2] = tri[2];
+        emitted[best] = 1;
+
+        // the triangle's vertices move to the front of the LRU cache
+        int newCache[CACHE_SIZE + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = tri[k];
+            newCache[newCount++] = (int)v;
+
+            // drop the triangle from the vertex's live list
+            unsigned int *begin = &adjacency[adjacencyOffset[v]];
+            unsigned int *end = begin + liveTriangles[v];
+            for (unsigned int *it = begin; it != end; ++it)
+            {
+                if (*it == (unsigned int)best)
+                {
+                    *it = *(end - 1);
+                    break;
+                }
+            }
+            --liveTriangles[v];
+        }
+        for (int c = 0; c < cacheCount; ++c)
+        {
+            int v = cache[c];
+            if (v != (int)tri[0] && v != (int)tri[1] && v != (int)tri[2])
+                newCache[newCount++] = v;
+        }
+
+        // rescore everything that was or is in the cache
+        for (int c = 0; c < newCount; ++c)
+        {
+            int v = newCache[c];
+            int position = c < CACHE_SIZE ? c : -1;
+            cachePosition[v] = position;
+            float newScore = vertexScore(position, liveTriangles[v]);
+            float delta = newScore - score[v];
+            score[v] = newScore;
+
+            for (unsigned int a = 0; a < liveTriangles[v]; ++a)
+                triangleScore[adjacency[adjacencyOffset[v] + a]] += delta;
+        }
+
+        cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+        for (int c = 0; c < cacheCount; ++c)
+            cache[c] = newCache[c];
+
+        // next triangle: the best one touching the cache
+        best = -1;
+        float bestScore = -1.0f;
+        for (int c = 0; c < cacheCount; ++c)
+        {
+            int v = cache[c];
+            for (unsigned int a = 0; a < liveTriangles[v]; ++a)
+            {
+                unsigned int t = adjacency[adjacencyOffset[v] + a];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = (long)t;
+                }
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < indexCount; ++i)
+        indices[i] = result[i];
+}
+
+std::vector<unsigned int> MeshOptimizer::optimizeVertexFetch(unsigned int *indices, std::size_t indexCount, std::size_t vertexCount)
+{
+    const unsigned int UNUSED = 0xffffffff;
+    std::vector<unsigned int> remap(vertexCount, UNUSED);
+
+    unsigned int next = 0;
+    for (std::size_t i = 0; i < indexCount; ++i)
+    {
+        unsigned int &target = remap[indices[i]];
+        if (target == UNUSED)
+            target = next++;
+        indices[i] = target;
+    }
+
+    for (std::size_t v = 0; v < vertexCount; ++v)
+        if (remap[v] == UNUSED)
+            remap[v] = next++;
+
+    return remap;
+}
@@ -0,0 +1,43 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+#include <vector>
+#include <cstddef>
+
+// simulated post-transform cache behaviour of an index buffer
+struct VertexCacheStats
+{
+    unsigned int misses; // vertices transformed
+    float acmr;          // average cache miss ratio: misses per triangle (0.5 ideal on big grids, 3 worst)
+    float atvr;          // average transformed vertex ratio: misses per vertex (1 ideal)
+};
+
+// Index/vertex reordering for triangle lists.
+// optimizeVertexCache reorders triangles with Tom Forsyth's linear-speed
+// algorithm so vertices are reused while still in the post-transform cache;
+// optimizeVertexFetch then renumbers vertices in first-use order so fetches
+// walk the vertex buffer forwards.
+class MeshOptimizer
+{
+public:
+    // FIFO cache simulation, cacheSize entries
+    static VertexCacheStats analyzeVertexCache(const unsigned int *indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize = 16);
+
+    static void optimizeVertexCache(unsigned int *indices, std::size_t indexCount, std::size_t vertexCount);
+
+    // rewrites indices in place and returns remap[oldVertex] = newVertex;
+    // vertices never referenced are moved to the end
+    static std::vector<unsigned int> optimizeVertexFetch(unsigned int *indices, std::size_t indexCount, std::size_t vertexCount);
+
+    // moves each vertex of size elementCount to remap[vertex], for use on every vertex attribute array
+    template <typename T>
+    static void remapVertices(std::vector<T> &data, std::size_t elementCount, const std::vector<unsigned int> &remap)
+    {
+        std::vector<T> result(data.size());
+        for (std::size_t v = 0; v < remap.size(); ++v)
+            for (std::size_t k = 0; k < elementCount; ++k)
+                result[remap[v] * elementCount + k] = data[v * elementCount + k];
+        data.swap(result);
+    }
+};
+
+#endif
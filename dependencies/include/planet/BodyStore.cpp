@@ -0,0 +1,289 @@
+#include "BodyStore.h"
+#include "OrbitKernel.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+
+unsigned int BodyStore::add(float r, int layer)
+{
+    orbitRadius.push_back(0.0f);
+    orbitSpeed.push_back(0.0f);
+    meanAnomaly.push_back(0.0f);
+    eccentricity.push_back(0.0f);
+    majorX.push_back(1.0f);
+    majorY.push_back(0.0f);
+    majorZ.push_back(0.0f);
+    minorX.push_back(0.0f);
+    minorY.push_back(0.0f);
+    minorZ.push_back(1.0f);
+    spin.push_back(1.0f);
+    spinPhase.push_back(0.0f);
+    scale.push_back(1.0f);
+    radius.push_back(r);
+    parent.push_back((int)NO_PARENT);
+    textureLayer.push_back(layer);
+    centerX.push_back(0.0f);
+    centerY.push_back(0.0f);
+    centerZ.push_back(0.0f);
+    offsetX.push_back(0.0f);
+    offsetY.push_back(0.0f);
+    offsetZ.push_back(0.0f);
+    x.push_back(0.0f);
+    y.push_back(0.0f);
+    z.push_back(0.0f);
+    movedFrame.push_back((unsigned int)DIRTY);
+    // a root may go anywhere in the order
+    unsigned int body = (unsigned int)(x.size() - 1);
+    order.push_back(body);
+    return body;
+}
+void BodyStore::reserve(std::size_t count)
+{
+    orbitRadius.reserve(count);
+    orbitSpeed.reserve(count);
+    meanAnomaly.reserve(count);
+    eccentricity.reserve(count);
+    majorX.reserve(count);
+    majorY.reserve(count);
+    majorZ.reserve(count);
+    minorX.reserve(count);
+    minorY.reserve(count);
+    minorZ.reserve(count);
+    spin.reserve(count);
+    spinPhase.reserve(count);
+    scale.reserve(count);
+    radius.reserve(count);
+    parent.reserve(count);
+    textureLayer.reserve(count);
+    centerX.reserve(count);
+    centerY.reserve(count);
+    centerZ.reserve(count);
+    offsetX.reserve(count);
+    offsetY.reserve(count);
+    offsetZ.reserve(count);
+    x.reserve(count);
+    y.reserve(count);
+    z.reserve(count);
+    movedFrame.reserve(count);
+    order.reserve(count);
+}
+void BodyStore::clear()
+{
+    orbitRadius.clear();
+    orbitSpeed.clear();
+    meanAnomaly.clear();
+    eccentricity.clear();
+    majorX.clear();
+    majorY.clear();
+    majorZ.clear();
+    minorX.clear();
+    minorY.clear();
+    minorZ.clear();
+    spin.clear();
+    spinPhase.clear();
+    scale.clear();
+    radius.clear();
+    parent.clear();
+    textureLayer.clear();
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    offsetX.clear();
+    offsetY.clear();
+    offsetZ.clear();
+    x.clear();
+    y.clear();
+    z.clear();
+    movedFrame.clear();
+    order.clear();
+    orderDirty = false;
+    inOrder = true;
+    time = 0.0;
+}
+void BodyStore::update(float deltaTime)
+{
+    setTime(time + deltaTime);
+}
+void BodyStore::setTime(double t)
+{
+    // orbit offsets of the bodies that orbit or were changed, then world positions, parents
+    // first; with the indices in depth-first order a chunk at a time, so the offsets are
+    // still in cache when they are placed
+    time = t;
+    const unsigned int *sorted = getOrder().data();
+    ++frame;
+    std::size_t count = size();
+    if (inOrder)
+        for (std::size_t first = 0; first < count; first += PLACE_CHUNK)
+        {
+            std::size_t end = first + PLACE_CHUNK < count ? first + PLACE_CHUNK : count;
+            evaluateMoving(first, end);
+            place(NULL, first, end);
+        }
+    else
+    {
+        evaluateMoving(0, count);
+        place(sorted, 0, count);
+    }
+}
+void BodyStore::place(const unsigned int *sorted, std::size_t first, std::size_t end)
+{
+    // orbiting bodies are placed without looking at the stamps; the others when they were changed
+    // or their parent moved, so static subtrees keep their positions
+    const unsigned int now = frame;
+    const int *up = parent.data();
+    const float *speed = orbitSpeed.data();
+    unsigned int *moved = movedFrame.data();
+    const float *cx = centerX.data(), *cy = centerY.data(), *cz = centerZ.data();
+    const float *ox = offsetX.data(), *oy = offsetY.data(), *oz = offsetZ.data();
+    float *wx = x.data(), *wy = y.data(), *wz = z.data();
+    for (std::size_t k = first; k < end; ++k)
+    {
+        unsigned int i = sorted ? sorted[k] : (unsigned int)k;
+        int p = up[i];
+        if (speed[i] == 0.0f)
+        {
+            if (moved[i] != DIRTY && (p == NO_PARENT || (speed[p] == 0.0f && moved[p] != now)))
+                continue;
+            moved[i] = now;
+        }
+        float anchorX = 0.0f, anchorY = 0.0f, anchorZ = 0.0f;
+        if (p != NO_PARENT)
+        {
+            anchorX = wx[p];
+            anchorY = wy[p];
+            anchorZ = wz[p];
+        }
+        wx[i] = anchorX + cx[i] + ox[i];
+        wy[i] = anchorY + cy[i] + oy[i];
+        wz[i] = anchorZ + cz[i] + oz[i];
+    }
+}
+void BodyStore::evaluateMoving(std::size_t first, std::size_t end)
+{
+    // blocks of bodies at rest keep what they have, runs of the other blocks go to the kernel at once
+    std::size_t run = end;
+    for (std::size_t block = first; block < end; block += EVALUATE_BLOCK)
+    {
+        std::size_t blockEnd = block + EVALUATE_BLOCK < end ? block + EVALUATE_BLOCK : end;
+        bool moving = false;
+        for (std::size_t i = block; i < blockEnd && !moving; ++i)
+            moving = orbitSpeed[i] != 0.0f || movedFrame[i] == DIRTY;
+        if (moving && run == end)
+            run = block;
+        else if (!moving && run != end)
+        {
+            OrbitKernel::evaluate(*this, run, block - run, time);
+            run = end;
+        }
+    }
+    if (run != end)
+        OrbitKernel::evaluate(*this, run, end - run, time);
+}
+bool BodyStore::setOrbit(unsigned int body, const OrbitalElements &elements)
+{
+    if (!(elements.eccentricity >= 0.0f && elements.eccentricity < 1.0f))
+        return false;
+    orbitRadius[body] = elements.semiMajorAxis;
+    orbitSpeed[body] = elements.period != 0.0f ? 2.0f * glm::pi<float>() / elements.period : 0.0f;
+    meanAnomaly[body] = elements.meanAnomaly;
+    eccentricity[body] = elements.eccentricity;
+
+    // periapsis and the point a quarter orbit on, turned by the periapsis argument
+    // within the plane, tilted about the line of nodes, then turned about y; the
+    // astronomical z axis is our y, so an orbit without inclination runs from +x to +z
+    float cosNode = std::cos(elements.ascendingNode), sinNode = std::sin(elements.ascendingNode);
+    float cosPeri = std::cos(elements.periapsis), sinPeri = std::sin(elements.periapsis);
+    float cosIncl = std::cos(elements.inclination), sinIncl = std::sin(elements.inclination);
+    majorX[body] = cosNode * cosPeri - sinNode * sinPeri * cosIncl;
+    majorZ[body] = sinNode * cosPeri + cosNode * sinPeri * cosIncl;
+    majorY[body] = sinPeri * sinIncl;
+    minorX[body] = -cosNode * sinPeri - sinNode * cosPeri * cosIncl;
+    minorZ[body] = -sinNode * sinPeri + cosNode * cosPeri * cosIncl;
+    minorY[body] = cosPeri * sinIncl;
+    markDirty(body);
+    return true;
+}
+void BodyStore::setOrbitSpeed(unsigned int body, float speed)
+{
+    // the same mean anomaly now at the new rate, so the body goes on from where it is
+    double now = meanAnomaly[body] + (double)orbitSpeed[body] * time;
+    meanAnomaly[body] = (float)std::remainder(now - (double)speed * time, 2.0 * glm::pi<double>());
+    orbitSpeed[body] = speed;
+    markDirty(body);
+}
+void BodyStore::setSpin(unsigned int body, float s)
+{
+    double now = spinPhase[body] + (double)spin[body] * time;
+    spinPhase[body] = (float)std::remainder(now - (double)s * time, 2.0 * glm::pi<double>());
+    spin[body] = s;
+}
+bool BodyStore::setParent(unsigned int body, int p)
+{
+    if (p != NO_PARENT && (p < 0 || (std::size_t)p >= size()))
+        return false;
+    // walking up from the new parent must not reach the body
+    for (int ancestor = p; ancestor != NO_PARENT; ancestor = parent[ancestor])
+        if ((unsigned int)ancestor == body)
+            return false;
+    parent[body] = p;
+    movedFrame[body] = DIRTY;
+    orderDirty = true;
+    return true;
+}
+const std::vector<unsigned int> &BodyStore::getOrder()
+{
+    if (orderDirty)
+        buildOrder();
+    return order;
+}
+void BodyStore::buildOrder()
+{
+    // children of each body as contiguous runs (a counting sort on the parent),
+    // then depth-first from every root in index order
+    std::size_t count = size();
+    std::vector<unsigned int> firstChild(count + 1, 0);
+    for (std::size_t i = 0; i < count; ++i)
+        if (parent[i] != NO_PARENT)
+            ++firstChild[parent[i] + 1];
+    for (std::size_t i = 0; i < count; ++i)
+        firstChild[i + 1] += firstChild[i];
+    std::vector<unsigned int> children(firstChild[count]);
+    std::vector<unsigned int> fill(firstChild.begin(), firstChild.end() - 1);
+    for (std::size_t i = 0; i < count; ++i)
+        if (parent[i] != NO_PARENT)
+            children[fill[parent[i]]++] = (unsigned int)i;
+
+    order.clear();
+    std::vector<unsigned int> stack;
+    for (std::size_t root = 0; root < count; ++root)
+    {
+        if (parent[root] != NO_PARENT)
+            continue;
+        stack.push_back((unsigned int)root);
+        while (!stack.empty())
+        {
+            unsigned int body = stack.back();
+            stack.pop_back();
+            order.push_back(body);
+            // pushed in reverse, so siblings come out in index order
+            for (unsigned int c = firstChild[body + 1]; c > firstChild[body]; --c)
+                stack.push_back(children[c - 1]);
+        }
+    }
+    inOrder = true;
+    for (std::size_t k = 0; k < count && inOrder; ++k)
+        inOrder = order[k] == k;
+    orderDirty = false;
+}
+float BodyStore::getAngle(unsigned int body) const
+{
+    return (float)std::remainder(spinPhase[body] + (double)spin[body] * time, 2.0 * glm::pi<double>());
+}
+glm::mat4 BodyStore::getModelMatrix(unsigned int body) const
+{
+    glm::mat4 trans = glm::mat4(1.0f);
+    trans = glm::translate(trans, getPosition(body));
+    trans = glm::rotate(trans, getAngle(body), glm::vec3(0.0f, 1.0f, 0.0f));
+    trans = glm::scale(trans, glm::vec3(scale[body]));
+    return trans;
+}
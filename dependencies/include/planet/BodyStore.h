@@ -0,0 +1,133 @@
+#ifndef BODY_STORE_H
+#define BODY_STORE_H
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+
+// Shape, orientation and phase of an elliptic orbit around its focus. With
+// no inclination the orbit lies in the xz plane; angles are in radians, the
+// node and periapsis measured from +x towards +z, and the mean anomaly is the
+// one at time 0. A period of 0 keeps the body at that point.
+struct OrbitalElements
+{
+    float semiMajorAxis;
+    float eccentricity; // [0, 1)
+    float inclination;
+    float ascendingNode;
+    float periapsis; // argument of, from the ascending node
+    float meanAnomaly;
+    float period; // seconds, negative for retrograde
+};
+
+// Kinematic state of every body, one contiguous array per field, so update()
+// streams through a few floats per body instead of whole Planet objects.
+// Bodies form a hierarchy (star, planet, moon, sub-satellite, ...): each one
+// sits at its centre, relative to its parent or to the world without one, and
+// orbits that point on a Keplerian ellipse; spin turns only the body itself.
+// Orbit and spin are closed-form functions of the store's time, so setTime()
+// jumps anywhere, backwards included, for the cost of one update().
+// Parents can be set in any order. The store keeps the bodies' indices in
+// depth-first order, so update() places every body in one pass after its
+// parent, and leaves alone the ones that neither orbit, were changed nor have
+// a parent that moved; orbits are only evaluated for blocks of bodies that
+// orbit or were changed. Spin angles are formed where model matrices are
+// written, so update() does not touch them. Indices are handles (Planet, the
+// renderers' ids) and never change, so the pass goes straight through the
+// arrays only when the bodies were added parents first, and through the
+// order otherwise.
+struct BodyStore
+{
+    static const int NO_PARENT = -1;
+
+    std::vector<float> orbitRadius;  // semi-major axis
+    std::vector<float> orbitSpeed;   // mean motion, radians per second
+    std::vector<float> meanAnomaly;  // at time 0
+    std::vector<float> eccentricity;
+    std::vector<float> majorX; // unit vector from the focus towards periapsis
+    std::vector<float> majorY;
+    std::vector<float> majorZ;
+    std::vector<float> minorX; // unit vector a quarter orbit ahead of it
+    std::vector<float> minorY;
+    std::vector<float> minorZ;
+    std::vector<float> spin;      // radians per second about y
+    std::vector<float> spinPhase; // angle at time 0
+    std::vector<float> scale;
+    std::vector<float> radius; // of the body's mesh, before scale
+    std::vector<int> parent;
+    std::vector<int> textureLayer;
+    std::vector<float> centerX; // orbit centre, relative to the parent
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> offsetX; // on the orbit around the centre, written by OrbitKernel::evaluate()
+    std::vector<float> offsetY;
+    std::vector<float> offsetZ;
+    std::vector<float> x; // world position, written by update()
+    std::vector<float> y;
+    std::vector<float> z;
+
+    // returns the index of the new body, a root at rest at the origin
+    unsigned int add(float radius, int textureLayer = 0);
+    void reserve(std::size_t count);
+    void clear();
+    // evaluates every orbit and spin at the time, then places the bodies that moved
+    void setTime(double time);
+    // setTime(getTime() + deltaTime); scaled for time warp, negative to play backwards
+    void update(float deltaTime);
+    double getTime() const
+    {
+        return time;
+    };
+    // false, leaving the orbit as it is, when the eccentricity is not in [0, 1)
+    bool setOrbit(unsigned int body, const OrbitalElements &elements);
+    // change the rates, keeping the body's current position on the orbit and angle
+    void setOrbitSpeed(unsigned int body, float speed);
+    void setSpin(unsigned int body, float spin);
+    // false, leaving the body as it is, when parent is the body or one of its descendants
+    bool setParent(unsigned int body, int parent);
+    // after writing a body's centre or orbit directly, so update() places it again
+    void markDirty(unsigned int body)
+    {
+        movedFrame[body] = DIRTY;
+    };
+    // whether the last update() placed the body or one of its ancestors again
+    bool hasMoved(unsigned int body) const
+    {
+        return orbitSpeed[body] != 0.0f || movedFrame[body] == frame;
+    };
+    // body indices, every parent before its children and each subtree contiguous
+    const std::vector<unsigned int> &getOrder();
+
+    glm::vec3 getPosition(unsigned int body) const
+    {
+        return glm::vec3(x[body], y[body], z[body]);
+    };
+    // spin about y at the current time, in [-pi, pi]
+    float getAngle(unsigned int body) const;
+    float getBoundingRadius(unsigned int body) const
+    {
+        return radius[body] * scale[body];
+    };
+    glm::mat4 getModelMatrix(unsigned int body) const;
+    std::size_t size() const
+    {
+        return x.size();
+    };
+
+private:
+    static const unsigned int DIRTY = ~0u;
+    static const std::size_t EVALUATE_BLOCK = 16; // bodies tested together for evaluate(), a register of them
+    static const std::size_t PLACE_CHUNK = 1024;  // bodies evaluated, then placed while their offsets are in cache
+
+    std::vector<unsigned int> movedFrame; // frame of the last update() that placed a body at rest, or DIRTY
+    std::vector<unsigned int> order;
+    bool orderDirty = false;
+    bool inOrder = true; // order is the identity
+    unsigned int frame = 0;
+    double time = 0.0;
+
+    void buildOrder();
+    void evaluateMoving(std::size_t first, std::size_t end);
+    void place(const unsigned int *sorted, std::size_t first, std::size_t end);
+};
+
+#endif
@@ -0,0 +1,277 @@
+#include "Ephemeris.h"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// built with -Wa,-muse-unaligned-vector-move on mingw, see OrbitKernel.h
+#include <immintrin.h>
+#define EPHEMERIS_HAS_AVX 1
+#endif
+
+namespace
+{
+    const std::size_t RECORD_BYTES = 1024; // DAF records, numbered from 1
+    const int SUMMARY_DOUBLES = 2;         // start and end time
+    const int SUMMARY_INTS = 6;            // target, center, frame, type, first and last address
+    const int SUMMARY_SIZE = SUMMARY_DOUBLES + (SUMMARY_INTS + 1) / 2;
+    const int SPK_CHEBYSHEV_POSITION = 2;
+    const int SPK_CHEBYSHEV_STATE = 3; // velocity coefficients follow, unused here
+    const int MAX_HOPS = 16;           // segment centers followed before giving up on a cycle
+
+    int readInt(const unsigned char *p)
+    {
+        int value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // sum of c[k] T_k(s) for x, y and z, each with n coefficients after the record's midpoint and radius
+    void chebyshevScalar(const double *record, unsigned int n, double s, double *position)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const double *c = record + 2 + axis * n;
+            double b1 = 0.0, b2 = 0.0;
+            for (int k = (int)n - 1; k >= 1; --k)
+            {
+                double b0 = 2.0 * s * b1 - b2 + c[k];
+                b2 = b1;
+                b1 = b0;
+            }
+            position[axis] = s * b1 - b2 + c[0];
+        }
+    }
+
+#ifdef EPHEMERIS_HAS_AVX
+    // the same recurrence with x, y and z in three lanes, rounded the same way as the scalar one
+    __attribute__((target("avx"))) void chebyshevAVX(const double *record, unsigned int n, double s, double *position)
+    {
+        const double *x = record + 2, *y = x + n, *z = y + n;
+        __m256d twoS = _mm256_set1_pd(2.0 * s);
+        __m256d b1 = _mm256_setzero_pd(), b2 = _mm256_setzero_pd();
+        for (int k = (int)n - 1; k >= 1; --k)
+        {
+            __m256d b0 = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(twoS, b1), b2), _mm256_set_pd(0.0, z[k], y[k], x[k]));
+            b2 = b1;
+            b1 = b0;
+        }
+        __m256d sum = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(_mm256_set1_pd(s), b1), b2), _mm256_set_pd(0.0, z[0], y[0], x[0]));
+        double lanes[4];
+        _mm256_storeu_pd(lanes, sum);
+        position[0] = lanes[0];
+        position[1] = lanes[1];
+        position[2] = lanes[2];
+    }
+#endif
+
+    bool hasAVX()
+    {
+#ifdef EPHEMERIS_HAS_AVX
+        static const bool supported = __builtin_cpu_supports("avx");
+        return supported;
+#else
+        return false;
+#endif
+    }
+}
+
+Ephemeris::Ephemeris()
+    : vectorized(hasAVX())
+{
+}
+bool Ephemeris::open(const std::string &path)
+{
+    close();
+    if (!file.open(path))
+        return false;
+    const unsigned char *data = file.getData();
+    if (file.getSize() < RECORD_BYTES || std::memcmp(data, "DAF/SPK ", 8) != 0 || std::memcmp(data + 88, "LTL-IEEE", 8) != 0 ||
+        readInt(data + 8) != SUMMARY_DOUBLES || readInt(data + 12) != SUMMARY_INTS)
+    {
+        std::cerr << "Ephemeris: " << path << " is not a little-endian SPK kernel" << std::endl;
+        close();
+        return false;
+    }
+    if (!readSummaries())
+    {
+        std::cerr << "Ephemeris: " << path << " has a broken summary record" << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+void Ephemeris::close()
+{
+    file.close();
+    segments.clear();
+    bodies.clear();
+    bodyIndex.clear();
+}
+bool Ephemeris::readSummaries()
+{
+    // the summary records form a list from the file record's forward pointer; each
+    // holds next, previous and count, then the summaries, 5 doubles apiece
+    const unsigned char *data = file.getData();
+    const double *words = (const double *)data; // DAF addresses count doubles from 1
+    std::size_t wordCount = file.getSize() / sizeof(double);
+    std::size_t recordCount = file.getSize() / RECORD_BYTES;
+    int record = readInt(data + 76);
+    for (std::size_t visited = 0; record > 0; ++visited)
+    {
+        if ((std::size_t)record > recordCount || visited >= recordCount)
+            return false;
+        const double *summaries = (const double *)(data + (record - 1) * RECORD_BYTES);
+        int count = (int)summaries[2];
+        if (count < 0 || 3 + count * SUMMARY_SIZE > (int)(RECORD_BYTES / sizeof(double)))
+            return false;
+        for (int i = 0; i < count; ++i)
+        {
+            const double *summary = summaries + 3 + i * SUMMARY_SIZE;
+            const unsigned char *ints = (const unsigned char *)(summary + SUMMARY_DOUBLES);
+            int type = readInt(ints + 12);
+            int first = readInt(ints + 16), last = readInt(ints + 20);
+            if (type != SPK_CHEBYSHEV_POSITION && type != SPK_CHEBYSHEV_STATE)
+                continue;
+            if (first < 1 || last < first + 4 || (std::size_t)last > wordCount)
+                return false;
+
+            // directory at the end of the segment: first record's start, interval, record size, records
+            Segment segment;
+            segment.target = readInt(ints);
+            segment.center = readInt(ints + 4);
+            segment.start = summary[0];
+            segment.end = summary[1];
+            segment.records = words + first - 1;
+            segment.init = words[last - 4];
+            segment.intervalLength = words[last - 3];
+            segment.recordSize = (unsigned int)words[last - 2];
+            segment.recordCount = (unsigned int)words[last - 1];
+            unsigned int components = type == SPK_CHEBYSHEV_POSITION ? 3 : 6;
+            segment.coefficients = segment.recordSize >= 2 ? (segment.recordSize - 2) / components : 0;
+            if (segment.coefficients == 0 || segment.recordCount == 0 || !(segment.intervalLength > 0.0) ||
+                (std::size_t)segment.recordCount * segment.recordSize > (std::size_t)(last - first + 1) - 4)
+                return false;
+
+            std::unordered_map<int, unsigned int>::iterator found = bodyIndex.find(segment.target);
+            if (found == bodyIndex.end())
+            {
+                Body body;
+                body.active = -1;
+                body.record = NULL;
+                body.recordStart = body.recordEnd = 0.0;
+                found = bodyIndex.insert(std::make_pair(segment.target, (unsigned int)bodies.size())).first;
+                bodies.push_back(body);
+            }
+            bodies[found->second].segments.push_back((unsigned int)segments.size());
+            segments.push_back(segment);
+        }
+        record = (int)summaries[0];
+    }
+    return true;
+}
+bool Ephemeris::hasBody(int target) const
+{
+    return bodyIndex.find(target) != bodyIndex.end();
+}
+const double *Ephemeris::findRecord(Body &body, double time)
+{
+    // the record of the last lookup usually still covers a frame later
+    if (body.record && time >= body.recordStart && time <= body.recordEnd)
+        return body.record;
+
+    const Segment *segment = NULL;
+    if (body.active >= 0 && time >= segments[body.active].start && time <= segments[body.active].end)
+        segment = &segments[body.active];
+    for (std::size_t i = body.segments.size(); !segment && i > 0; --i)
+    {
+        const Segment &candidate = segments[body.segments[i - 1]];
+        if (time >= candidate.start && time <= candidate.end)
+        {
+            segment = &candidate;
+            body.active = (int)body.segments[i - 1];
+        }
+    }
+    if (!segment)
+        return NULL;
+
+    double index = std::floor((time - segment->init) / segment->intervalLength);
+    unsigned int record = index <= 0.0 ? 0 : index >= segment->recordCount - 1 ? segment->recordCount - 1 : (unsigned int)index;
+    body.record = segment->records + (std::size_t)record * segment->recordSize;
+    // midpoint and radius of the record's interval
+    body.recordStart = body.record[0] - body.record[1];
+    body.recordEnd = body.record[0] + body.record[1];
+    if (body.recordStart < segment->start)
+        body.recordStart = segment->start;
+    if (body.recordEnd > segment->end)
+        body.recordEnd = segment->end;
+    return body.record;
+}
+bool Ephemeris::evaluate(Body &body, double time, double *position, int &center)
+{
+    const double *record = findRecord(body, time);
+    if (!record)
+        return false;
+    const Segment &segment = segments[body.active];
+    double s = (time - record[0]) / record[1];
+#ifdef EPHEMERIS_HAS_AVX
+    if (vectorized)
+    {
+        chebyshevAVX(record, segment.coefficients, s, position);
+        center = segment.center;
+        return true;
+    }
+#endif
+    chebyshevScalar(record, segment.coefficients, s, position);
+    center = segment.center;
+    return true;
+}
+bool Ephemeris::getPosition(int target, int center, double time, double *position)
+{
+    // up from the target until the center or a body without segments, the root of its tree
+    double fromTarget[3] = {0.0, 0.0, 0.0};
+    int reached = target;
+    for (int hop = 0; reached != center && hop < MAX_HOPS; ++hop)
+    {
+        std::unordered_map<int, unsigned int>::iterator found = bodyIndex.find(reached);
+        if (found == bodyIndex.end())
+            break;
+        double offset[3];
+        if (!evaluate(bodies[found->second], time, offset, reached))
+            return false;
+        fromTarget[0] += offset[0];
+        fromTarget[1] += offset[1];
+        fromTarget[2] += offset[2];
+    }
+
+    // then, unless the center was on the way, up from the center to the same body
+    double fromCenter[3] = {0.0, 0.0, 0.0};
+    int other = center;
+    for (int hop = 0; other != reached; ++hop)
+    {
+        std::unordered_map<int, unsigned int>::iterator found = bodyIndex.find(other);
+        if (found == bodyIndex.end() || hop == MAX_HOPS)
+            return false;
+        double offset[3];
+        if (!evaluate(bodies[found->second], time, offset, other))
+            return false;
+        fromCenter[0] += offset[0];
+        fromCenter[1] += offset[1];
+        fromCenter[2] += offset[2];
+    }
+    position[0] = fromTarget[0] - fromCenter[0];
+    position[1] = fromTarget[1] - fromCenter[1];
+    position[2] = fromTarget[2] - fromCenter[2];
+    return true;
+}
+bool Ephemeris::getPositions(const int *targets, const int *centers, std::size_t count, double time, double *out)
+{
+    bool found = true;
+    for (std::size_t i = 0; i < count; ++i)
+        found = getPosition(targets[i], centers[i], time, out + 3 * i) && found;
+    return found;
+}
+void Ephemeris::setVectorized(bool enabled)
+{
+    vectorized = enabled && hasAVX();
+}
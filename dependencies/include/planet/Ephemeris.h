@@ -0,0 +1,102 @@
+#ifndef EPHEMERIS_H
+#define EPHEMERIS_H
+#include <MappedFile/MappedFile.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+// NAIF ids of the bodies in the planetary kernels (DE4xx)
+enum EphemerisBody
+{
+    EPHEMERIS_SOLAR_SYSTEM_BARYCENTER = 0,
+    EPHEMERIS_MERCURY_BARYCENTER = 1,
+    EPHEMERIS_VENUS_BARYCENTER = 2,
+    EPHEMERIS_EARTH_MOON_BARYCENTER = 3,
+    EPHEMERIS_MARS_BARYCENTER = 4,
+    EPHEMERIS_JUPITER_BARYCENTER = 5,
+    EPHEMERIS_SATURN_BARYCENTER = 6,
+    EPHEMERIS_URANUS_BARYCENTER = 7,
+    EPHEMERIS_NEPTUNE_BARYCENTER = 8,
+    EPHEMERIS_PLUTO_BARYCENTER = 9,
+    EPHEMERIS_SUN = 10,
+    EPHEMERIS_MOON = 301,
+    EPHEMERIS_EARTH = 399
+};
+
+// Positions from a binary SPK kernel (.bsp, the DAF layout JPL ships its
+// ephemerides in), segments of type 2 and 3: Chebyshev polynomials per fixed
+// time interval. open() maps the file and reads only its summary records, so
+// startup does not depend on the kernel's size and the coefficients are read
+// in place, paged in when first evaluated. Each target keeps its active
+// segment and record, so a frame close to the last one goes straight to the
+// Clenshaw recurrence, which runs x, y and z as the lanes of one AVX register
+// when the CPU has it. Times are TDB seconds past J2000, positions km in the
+// kernel's frame (J2000 equatorial for the DE kernels). Little-endian kernels
+// only.
+class Ephemeris
+{
+public:
+    Ephemeris();
+
+    // false when the file is missing or not a little-endian SPK; segments of other types are skipped
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const
+    {
+        return file.isOpen();
+    };
+    std::size_t getSegmentCount() const
+    {
+        return segments.size();
+    };
+    // whether some segment has the target
+    bool hasBody(int target) const;
+
+    // position of target relative to center, both NAIF ids, following the segments' centers
+    // through their common ancestor; false when a segment in between does not cover the time
+    bool getPosition(int target, int center, double time, double *position);
+    // count positions at once, out holding 3 doubles per target
+    bool getPositions(const int *targets, const int *centers, std::size_t count, double time, double *out);
+
+    // the AVX Clenshaw when the CPU supports it, off for the scalar reference
+    void setVectorized(bool enabled);
+    bool isVectorized() const
+    {
+        return vectorized;
+    };
+
+private:
+    struct Segment
+    {
+        int target;
+        int center;
+        double start, end; // seconds past J2000
+        const double *records;
+        double init, intervalLength;
+        unsigned int recordSize;
+        unsigned int recordCount;
+        unsigned int coefficients; // per component
+    };
+    // the segments of one target and what the last lookup hit
+    struct Body
+    {
+        std::vector<unsigned int> segments; // later ones in the file take precedence
+        int active;                         // segment of the last lookup, -1 before it
+        const double *record;
+        double recordStart, recordEnd;
+    };
+
+    MappedFile file;
+    std::vector<Segment> segments;
+    std::vector<Body> bodies;
+    std::unordered_map<int, unsigned int> bodyIndex; // target -> bodies
+    bool vectorized;
+
+    bool readSummaries();
+    // position of the body relative to the center of the segment that covers the time
+    bool evaluate(Body &body, double time, double *position, int &center);
+    const double *findRecord(Body &body, double time);
+};
+
+#endif
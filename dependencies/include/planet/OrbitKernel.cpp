@@ -0,0 +1,573 @@
+#include "OrbitKernel.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <cmath>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ORBIT_KERNEL_HAS_SIMD 1
+#endif
+
+namespace
+{
+    const double TWO_PI = 6.28318530717958647692;
+    const double INV_TWO_PI = 0.159154943091895335769;
+    const float TWO_OVER_PI = 0.636619772367581343f;
+    // pi/2 in three parts, the first two short enough for q * part to be exact
+    const float PIO2_1 = 1.5703125f;
+    const float PIO2_2 = 4.837512969970703125e-4f;
+    const float PIO2_3 = 7.54978995489188216e-8f;
+    // Cephes sinf/cosf on [-pi/4, pi/4]
+    const float S1 = -1.6666654611e-1f, S2 = 8.3321608736e-3f, S3 = -1.9515295891e-4f;
+    const float C1 = 4.166664568298827e-2f, C2 = -1.388731625493765e-3f, C3 = 2.443315711809948e-5f;
+
+    // Halley steps from Danby's E = M + 0.85 e sign(M): enough for float precision up to e = 0.98
+    const int KEPLER_ITERATIONS = 4;
+    const float DANBY_K = 0.85f;
+
+    // bodies per sincos call in writeModels(), small enough for the stack
+    const std::size_t MODEL_BATCH = 64;
+
+    struct OrbitArrays
+    {
+        const float *orbitSpeed;
+        const float *meanAnomaly;
+        const float *orbitRadius;
+        const float *eccentricity;
+        const float *majorX, *majorY, *majorZ;
+        const float *minorX, *minorY, *minorZ;
+        float *offsetX, *offsetY, *offsetZ;
+    };
+
+    // start + rate * time in double, wrapped into [-pi, pi] before it goes to float
+    float phase(float start, float rate, double time)
+    {
+        double a = start + (double)rate * time;
+        return (float)(a - TWO_PI * std::floor(a * INV_TWO_PI + 0.5));
+    }
+    float keplerScalar(float mean, float e)
+    {
+        if (e == 0.0f)
+            return mean;
+        float anomaly = mean + std::copysign(DANBY_K * e, mean);
+        for (int k = 0; k < KEPLER_ITERATIONS; ++k)
+        {
+            float es = e * std::sin(anomaly);
+            float f = anomaly - es - mean;
+            float d1 = 1.0f - e * std::cos(anomaly);
+            anomaly -= f * d1 / (d1 * d1 - 0.5f * f * es);
+        }
+        return anomaly;
+    }
+    void sincosScalar(const float *angles, float *sines, float *cosines, std::size_t first, std::size_t count)
+    {
+        for (std::size_t i = first; i < count; ++i)
+        {
+            sines[i] = std::sin(angles[i]);
+            cosines[i] = std::cos(angles[i]);
+        }
+    }
+    void solveKeplerScalar(const float *means, const float *e, float *anomalies, std::size_t first, std::size_t count)
+    {
+        for (std::size_t i = first; i < count; ++i)
+            anomalies[i] = keplerScalar(means[i], e[i]);
+    }
+    void evaluateScalar(const OrbitArrays &a, double time, std::size_t first, std::size_t count)
+    {
+        for (std::size_t i = first; i < count; ++i)
+        {
+            float e = a.eccentricity[i];
+            float anomaly = keplerScalar(phase(a.meanAnomaly[i], a.orbitSpeed[i], time), e);
+            // in the orbit's plane, from the focus
+            float px = a.orbitRadius[i] * (std::cos(anomaly) - e);
+            float py = a.orbitRadius[i] * std::sqrt(1.0f - e * e) * std::sin(anomaly);
+            a.offsetX[i] = px * a.majorX[i] + py * a.minorX[i];
+            a.offsetY[i] = px * a.majorY[i] + py * a.minorY[i];
+            a.offsetZ[i] = px * a.majorZ[i] + py * a.minorZ[i];
+        }
+    }
+    // translate * rotateY * scale with k = scale * radius, column-major
+    void storeModel(float *m, float c, float s, float k, float x, float y, float z)
+    {
+        m[0] = c * k;
+        m[1] = 0.0f;
+        m[2] = -s * k;
+        m[3] = 0.0f;
+        m[4] = 0.0f;
+        m[5] = k;
+        m[6] = 0.0f;
+        m[7] = 0.0f;
+        m[8] = s * k;
+        m[9] = 0.0f;
+        m[10] = c * k;
+        m[11] = 0.0f;
+        m[12] = x;
+        m[13] = y;
+        m[14] = z;
+        m[15] = 1.0f;
+    }
+
+#ifdef ORBIT_KERNEL_HAS_SIMD
+    // each target: a sincos of one register, then the sincos, Kepler and evaluate loops over
+    // whole registers, returning where the scalar code has to take over
+
+    __attribute__((target("sse4.1"))) inline void sincosSSE4(__m128 x, __m128 &s, __m128 &c)
+    {
+        __m128 q = _mm_round_ps(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(PIO2_1)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PIO2_2)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PIO2_3)));
+        __m128 z = _mm_mul_ps(r, r);
+
+        __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(S3), z), _mm_set1_ps(S2)), z), _mm_set1_ps(S1));
+        __m128 sr = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), r), r);
+        __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(C3), z), _mm_set1_ps(C2)), z), _mm_set1_ps(C1));
+        __m128 cr = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(pc, z), z), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)));
+
+        // odd quadrants swap sine and cosine, bit 1 of q and of q + 1 negates them
+        __m128i qi = _mm_cvtps_epi32(q);
+        __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(qi, one), one));
+        __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(qi, two), 30));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(qi, one), two), 30));
+        s = _mm_xor_ps(_mm_blendv_ps(sr, cr, swap), sinSign);
+        c = _mm_xor_ps(_mm_blendv_ps(cr, sr, swap), cosSign);
+    }
+    __attribute__((target("sse4.1"))) std::size_t sincosSSE4(const float *angles, float *sines, float *cosines, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 s, c;
+            sincosSSE4(_mm_loadu_ps(angles + i), s, c);
+            _mm_storeu_ps(sines + i, s);
+            _mm_storeu_ps(cosines + i, c);
+        }
+        return i;
+    }
+    __attribute__((target("sse4.1"))) inline __m128d wrapSSE4(__m128d a)
+    {
+        __m128d turns = _mm_floor_pd(_mm_add_pd(_mm_mul_pd(a, _mm_set1_pd(INV_TWO_PI)), _mm_set1_pd(0.5)));
+        return _mm_sub_pd(a, _mm_mul_pd(turns, _mm_set1_pd(TWO_PI)));
+    }
+    __attribute__((target("sse4.1"))) inline __m128 phaseSSE4(const float *start, const float *rate, __m128d time)
+    {
+        __m128 s = _mm_loadu_ps(start), r = _mm_loadu_ps(rate);
+        __m128d lo = _mm_add_pd(_mm_cvtps_pd(s), _mm_mul_pd(_mm_cvtps_pd(r), time));
+        __m128d hi = _mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(s, s)), _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(r, r)), time));
+        return _mm_movelh_ps(_mm_cvtpd_ps(wrapSSE4(lo)), _mm_cvtpd_ps(wrapSSE4(hi)));
+    }
+    __attribute__((target("sse4.1"))) inline __m128 keplerSSE4(__m128 mean, __m128 e)
+    {
+        __m128 anomaly = _mm_add_ps(mean, _mm_or_ps(_mm_mul_ps(_mm_set1_ps(DANBY_K), e), _mm_and_ps(mean, _mm_set1_ps(-0.0f))));
+        for (int k = 0; k < KEPLER_ITERATIONS; ++k)
+        {
+            __m128 s, c;
+            sincosSSE4(anomaly, s, c);
+            __m128 es = _mm_mul_ps(e, s);
+            __m128 f = _mm_sub_ps(_mm_sub_ps(anomaly, es), mean);
+            __m128 d1 = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(e, c));
+            __m128 denominator = _mm_sub_ps(_mm_mul_ps(d1, d1), _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), f), es));
+            anomaly = _mm_sub_ps(anomaly, _mm_div_ps(_mm_mul_ps(f, d1), denominator));
+        }
+        return anomaly;
+    }
+    __attribute__((target("sse4.1"))) std::size_t solveKeplerSSE4(const float *means, const float *e, float *anomalies, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(anomalies + i, keplerSSE4(_mm_loadu_ps(means + i), _mm_loadu_ps(e + i)));
+        return i;
+    }
+    __attribute__((target("sse4.1"))) std::size_t evaluateSSE4(const OrbitArrays &a, double time, std::size_t count)
+    {
+        __m128d t = _mm_set1_pd(time);
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 mean = phaseSSE4(a.meanAnomaly + i, a.orbitSpeed + i, t);
+            __m128 e = _mm_loadu_ps(a.eccentricity + i);
+            __m128 anomaly = _mm_movemask_ps(_mm_cmpneq_ps(e, _mm_setzero_ps())) ? keplerSSE4(mean, e) : mean;
+
+            __m128 s, c;
+            sincosSSE4(anomaly, s, c);
+            __m128 radius = _mm_loadu_ps(a.orbitRadius + i);
+            __m128 px = _mm_mul_ps(radius, _mm_sub_ps(c, e));
+            __m128 py = _mm_mul_ps(_mm_mul_ps(radius, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(e, e)))), s);
+            _mm_storeu_ps(a.offsetX + i, _mm_add_ps(_mm_mul_ps(px, _mm_loadu_ps(a.majorX + i)), _mm_mul_ps(py, _mm_loadu_ps(a.minorX + i))));
+            _mm_storeu_ps(a.offsetY + i, _mm_add_ps(_mm_mul_ps(px, _mm_loadu_ps(a.majorY + i)), _mm_mul_ps(py, _mm_loadu_ps(a.minorY + i))));
+            _mm_storeu_ps(a.offsetZ + i, _mm_add_ps(_mm_mul_ps(px, _mm_loadu_ps(a.majorZ + i)), _mm_mul_ps(py, _mm_loadu_ps(a.minorZ + i))));
+        }
+        return i;
+    }
+    __attribute__((target("sse4.1"))) std::size_t phasesSSE4(const float *start, const float *rate, double time, float *out, std::size_t count)
+    {
+        __m128d t = _mm_set1_pd(time);
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_ps(out + i, phaseSSE4(start + i, rate + i, t));
+        return i;
+    }
+
+    __attribute__((target("avx2,fma"))) inline void sincosAVX2(__m256 x, __m256 &s, __m256 &c)
+    {
+        __m256 q = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PIO2_1), x);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PIO2_2), r);
+        r = _mm256_fnmadd_ps(q, _mm256_set1_ps(PIO2_3), r);
+        __m256 z = _mm256_mul_ps(r, r);
+
+        __m256 ps = _mm256_fmadd_ps(_mm256_fmadd_ps(_mm256_set1_ps(S3), z, _mm256_set1_ps(S2)), z, _mm256_set1_ps(S1));
+        __m256 sr = _mm256_fmadd_ps(_mm256_mul_ps(ps, z), r, r);
+        __m256 pc = _mm256_fmadd_ps(_mm256_fmadd_ps(_mm256_set1_ps(C3), z, _mm256_set1_ps(C2)), z, _mm256_set1_ps(C1));
+        __m256 cr = _mm256_fmadd_ps(_mm256_mul_ps(pc, z), z, _mm256_fnmadd_ps(_mm256_set1_ps(0.5f), z, _mm256_set1_ps(1.0f)));
+
+        __m256i qi = _mm256_cvtps_epi32(q);
+        __m256i one = _mm256_set1_epi32(1), two = _mm256_set1_epi32(2);
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(qi, one), one));
+        __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(qi, two), 30));
+        __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(qi, one), two), 30));
+        s = _mm256_xor_ps(_mm256_blendv_ps(sr, cr, swap), sinSign);
+        c = _mm256_xor_ps(_mm256_blendv_ps(cr, sr, swap), cosSign);
+    }
+    __attribute__((target("avx2,fma"))) std::size_t sincosAVX2(const float *angles, float *sines, float *cosines, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 s, c;
+            sincosAVX2(_mm256_loadu_ps(angles + i), s, c);
+            _mm256_storeu_ps(sines + i, s);
+            _mm256_storeu_ps(cosines + i, c);
+        }
+        return i;
+    }
+    __attribute__((target("avx2,fma"))) inline __m256d wrapAVX2(__m256d a)
+    {
+        __m256d turns = _mm256_floor_pd(_mm256_fmadd_pd(a, _mm256_set1_pd(INV_TWO_PI), _mm256_set1_pd(0.5)));
+        return _mm256_fnmadd_pd(turns, _mm256_set1_pd(TWO_PI), a);
+    }
+    __attribute__((target("avx2,fma"))) inline __m256 phaseAVX2(const float *start, const float *rate, __m256d time)
+    {
+        __m256d lo = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(rate)), time, _mm256_cvtps_pd(_mm_loadu_ps(start)));
+        __m256d hi = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm_loadu_ps(rate + 4)), time, _mm256_cvtps_pd(_mm_loadu_ps(start + 4)));
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(wrapAVX2(lo))), _mm256_cvtpd_ps(wrapAVX2(hi)), 1);
+    }
+    __attribute__((target("avx2,fma"))) inline __m256 keplerAVX2(__m256 mean, __m256 e)
+    {
+        __m256 anomaly = _mm256_add_ps(mean, _mm256_or_ps(_mm256_mul_ps(_mm256_set1_ps(DANBY_K), e), _mm256_and_ps(mean, _mm256_set1_ps(-0.0f))));
+        for (int k = 0; k < KEPLER_ITERATIONS; ++k)
+        {
+            __m256 s, c;
+            sincosAVX2(anomaly, s, c);
+            __m256 es = _mm256_mul_ps(e, s);
+            __m256 f = _mm256_sub_ps(_mm256_sub_ps(anomaly, es), mean);
+            __m256 d1 = _mm256_fnmadd_ps(e, c, _mm256_set1_ps(1.0f));
+            __m256 denominator = _mm256_fnmadd_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), f), es, _mm256_mul_ps(d1, d1));
+            anomaly = _mm256_sub_ps(anomaly, _mm256_div_ps(_mm256_mul_ps(f, d1), denominator));
+        }
+        return anomaly;
+    }
+    __attribute__((target("avx2,fma"))) std::size_t solveKeplerAVX2(const float *means, const float *e, float *anomalies, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(anomalies + i, keplerAVX2(_mm256_loadu_ps(means + i), _mm256_loadu_ps(e + i)));
+        return i;
+    }
+    __attribute__((target("avx2,fma"))) std::size_t evaluateAVX2(const OrbitArrays &a, double time, std::size_t count)
+    {
+        __m256d t = _mm256_set1_pd(time);
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 mean = phaseAVX2(a.meanAnomaly + i, a.orbitSpeed + i, t);
+            __m256 e = _mm256_loadu_ps(a.eccentricity + i);
+            __m256 anomaly = _mm256_movemask_ps(_mm256_cmp_ps(e, _mm256_setzero_ps(), _CMP_NEQ_UQ)) ? keplerAVX2(mean, e) : mean;
+
+            __m256 s, c;
+            sincosAVX2(anomaly, s, c);
+            __m256 radius = _mm256_loadu_ps(a.orbitRadius + i);
+            __m256 px = _mm256_mul_ps(radius, _mm256_sub_ps(c, e));
+            __m256 py = _mm256_mul_ps(_mm256_mul_ps(radius, _mm256_sqrt_ps(_mm256_fnmadd_ps(e, e, _mm256_set1_ps(1.0f)))), s);
+            _mm256_storeu_ps(a.offsetX + i, _mm256_fmadd_ps(py, _mm256_loadu_ps(a.minorX + i), _mm256_mul_ps(px, _mm256_loadu_ps(a.majorX + i))));
+            _mm256_storeu_ps(a.offsetY + i, _mm256_fmadd_ps(py, _mm256_loadu_ps(a.minorY + i), _mm256_mul_ps(px, _mm256_loadu_ps(a.majorY + i))));
+            _mm256_storeu_ps(a.offsetZ + i, _mm256_fmadd_ps(py, _mm256_loadu_ps(a.minorZ + i), _mm256_mul_ps(px, _mm256_loadu_ps(a.majorZ + i))));
+        }
+        return i;
+    }
+    __attribute__((target("avx2,fma"))) std::size_t phasesAVX2(const float *start, const float *rate, double time, float *out, std::size_t count)
+    {
+        __m256d t = _mm256_set1_pd(time);
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(out + i, phaseAVX2(start + i, rate + i, t));
+        return i;
+    }
+
+    __attribute__((target("avx512f"))) inline void sincosAVX512(__m512 x, __m512 &s, __m512 &c)
+    {
+        __m512 q = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT);
+        __m512 r = _mm512_fnmadd_ps(q, _mm512_set1_ps(PIO2_1), x);
+        r = _mm512_fnmadd_ps(q, _mm512_set1_ps(PIO2_2), r);
+        r = _mm512_fnmadd_ps(q, _mm512_set1_ps(PIO2_3), r);
+        __m512 z = _mm512_mul_ps(r, r);
+
+        __m512 ps = _mm512_fmadd_ps(_mm512_fmadd_ps(_mm512_set1_ps(S3), z, _mm512_set1_ps(S2)), z, _mm512_set1_ps(S1));
+        __m512 sr = _mm512_fmadd_ps(_mm512_mul_ps(ps, z), r, r);
+        __m512 pc = _mm512_fmadd_ps(_mm512_fmadd_ps(_mm512_set1_ps(C3), z, _mm512_set1_ps(C2)), z, _mm512_set1_ps(C1));
+        __m512 cr = _mm512_fmadd_ps(_mm512_mul_ps(pc, z), z, _mm512_fnmadd_ps(_mm512_set1_ps(0.5f), z, _mm512_set1_ps(1.0f)));
+
+        // sign flips as integer xors, the float ones need AVX-512DQ
+        __m512i qi = _mm512_cvtps_epi32(q);
+        __m512i one = _mm512_set1_epi32(1), two = _mm512_set1_epi32(2);
+        __mmask16 swap = _mm512_test_epi32_mask(qi, one);
+        __m512i sinSign = _mm512_slli_epi32(_mm512_and_si512(qi, two), 30);
+        __m512i cosSign = _mm512_slli_epi32(_mm512_and_si512(_mm512_add_epi32(qi, one), two), 30);
+        s = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_mask_blend_ps(swap, sr, cr)), sinSign));
+        c = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(_mm512_mask_blend_ps(swap, cr, sr)), cosSign));
+    }
+    __attribute__((target("avx512f"))) std::size_t sincosAVX512(const float *angles, float *sines, float *cosines, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m512 s, c;
+            sincosAVX512(_mm512_loadu_ps(angles + i), s, c);
+            _mm512_storeu_ps(sines + i, s);
+            _mm512_storeu_ps(cosines + i, c);
+        }
+        return i;
+    }
+    __attribute__((target("avx512f"))) inline __m512d wrapAVX512(__m512d a)
+    {
+        __m512d turns = _mm512_floor_pd(_mm512_fmadd_pd(a, _mm512_set1_pd(INV_TWO_PI), _mm512_set1_pd(0.5)));
+        return _mm512_fnmadd_pd(turns, _mm512_set1_pd(TWO_PI), a);
+    }
+    __attribute__((target("avx512f"))) inline __m512 phaseAVX512(const float *start, const float *rate, __m512d time)
+    {
+        __m512d lo = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(rate)), time, _mm512_cvtps_pd(_mm256_loadu_ps(start)));
+        __m512d hi = _mm512_fmadd_pd(_mm512_cvtps_pd(_mm256_loadu_ps(rate + 8)), time, _mm512_cvtps_pd(_mm256_loadu_ps(start + 8)));
+        // joined as doubles, the 8-float insert needs AVX-512DQ
+        __m512d joined = _mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(_mm512_cvtpd_ps(wrapAVX512(lo)))),
+                                            _mm256_castps_pd(_mm512_cvtpd_ps(wrapAVX512(hi))), 1);
+        return _mm512_castpd_ps(joined);
+    }
+    __attribute__((target("avx512f"))) inline __m512 keplerAVX512(__m512 mean, __m512 e)
+    {
+        __m512i signBits = _mm512_and_si512(_mm512_castps_si512(mean), _mm512_set1_epi32((int)0x80000000));
+        __m512 start = _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(_mm512_mul_ps(_mm512_set1_ps(DANBY_K), e)), signBits));
+        __m512 anomaly = _mm512_add_ps(mean, start);
+        for (int k = 0; k < KEPLER_ITERATIONS; ++k)
+        {
+            __m512 s, c;
+            sincosAVX512(anomaly, s, c);
+            __m512 es = _mm512_mul_ps(e, s);
+            __m512 f = _mm512_sub_ps(_mm512_sub_ps(anomaly, es), mean);
+            __m512 d1 = _mm512_fnmadd_ps(e, c, _mm512_set1_ps(1.0f));
+            __m512 denominator = _mm512_fnmadd_ps(_mm512_mul_ps(_mm512_set1_ps(0.5f), f), es, _mm512_mul_ps(d1, d1));
+            anomaly = _mm512_sub_ps(anomaly, _mm512_div_ps(_mm512_mul_ps(f, d1), denominator));
+        }
+        return anomaly;
+    }
+    __attribute__((target("avx512f"))) std::size_t solveKeplerAVX512(const float *means, const float *e, float *anomalies, std::size_t count)
+    {
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+            _mm512_storeu_ps(anomalies + i, keplerAVX512(_mm512_loadu_ps(means + i), _mm512_loadu_ps(e + i)));
+        return i;
+    }
+    __attribute__((target("avx512f"))) std::size_t evaluateAVX512(const OrbitArrays &a, double time, std::size_t count)
+    {
+        __m512d t = _mm512_set1_pd(time);
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            __m512 mean = phaseAVX512(a.meanAnomaly + i, a.orbitSpeed + i, t);
+            __m512 e = _mm512_loadu_ps(a.eccentricity + i);
+            __m512 anomaly = _mm512_cmpneq_ps_mask(e, _mm512_setzero_ps()) ? keplerAVX512(mean, e) : mean;
+
+            __m512 s, c;
+            sincosAVX512(anomaly, s, c);
+            __m512 radius = _mm512_loadu_ps(a.orbitRadius + i);
+            __m512 px = _mm512_mul_ps(radius, _mm512_sub_ps(c, e));
+            __m512 py = _mm512_mul_ps(_mm512_mul_ps(radius, _mm512_sqrt_ps(_mm512_fnmadd_ps(e, e, _mm512_set1_ps(1.0f)))), s);
+            _mm512_storeu_ps(a.offsetX + i, _mm512_fmadd_ps(py, _mm512_loadu_ps(a.minorX + i), _mm512_mul_ps(px, _mm512_loadu_ps(a.majorX + i))));
+            _mm512_storeu_ps(a.offsetY + i, _mm512_fmadd_ps(py, _mm512_loadu_ps(a.minorY + i), _mm512_mul_ps(px, _mm512_loadu_ps(a.majorY + i))));
+            _mm512_storeu_ps(a.offsetZ + i, _mm512_fmadd_ps(py, _mm512_loadu_ps(a.minorZ + i), _mm512_mul_ps(px, _mm512_loadu_ps(a.majorZ + i))));
+        }
+        return i;
+    }
+    __attribute__((target("avx512f"))) std::size_t phasesAVX512(const float *start, const float *rate, double time, float *out, std::size_t count)
+    {
+        __m512d t = _mm512_set1_pd(time);
+        std::size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+            _mm512_storeu_ps(out + i, phaseAVX512(start + i, rate + i, t));
+        return i;
+    }
+#endif
+
+    OrbitKernelTarget resolve(OrbitKernelTarget target)
+    {
+        if (target == ORBIT_KERNEL_AUTO)
+            return OrbitKernel::getBestTarget();
+        return OrbitKernel::isSupported(target) ? target : ORBIT_KERNEL_SCALAR;
+    }
+    // start + rate * time for each body, as evaluate() forms the mean anomalies; target resolved
+    void phases(const float *start, const float *rate, double time, float *out, std::size_t count, OrbitKernelTarget target)
+    {
+        std::size_t done = 0;
+        switch (target)
+        {
+#ifdef ORBIT_KERNEL_HAS_SIMD
+        case ORBIT_KERNEL_AVX512:
+            done = phasesAVX512(start, rate, time, out, count);
+            break;
+        case ORBIT_KERNEL_AVX2:
+            done = phasesAVX2(start, rate, time, out, count);
+            break;
+        case ORBIT_KERNEL_SSE4:
+            done = phasesSSE4(start, rate, time, out, count);
+            break;
+#endif
+        default:
+            break;
+        }
+        for (std::size_t i = done; i < count; ++i)
+            out[i] = phase(start[i], rate[i], time);
+    }
+}
+
+OrbitKernelTarget OrbitKernel::getBestTarget()
+{
+#ifdef ORBIT_KERNEL_HAS_SIMD
+    static const OrbitKernelTarget best = __builtin_cpu_supports("avx512f") ? ORBIT_KERNEL_AVX512
+                                          : (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? ORBIT_KERNEL_AVX2
+                                          : __builtin_cpu_supports("sse4.1")                                  ? ORBIT_KERNEL_SSE4
+                                                                                                              : ORBIT_KERNEL_SCALAR;
+    return best;
+#else
+    return ORBIT_KERNEL_SCALAR;
+#endif
+}
+bool OrbitKernel::isSupported(OrbitKernelTarget target)
+{
+    // every CPU with one of the sets has the ones before it
+    return target >= ORBIT_KERNEL_SCALAR && target <= getBestTarget();
+}
+const char *OrbitKernel::getTargetName(OrbitKernelTarget target)
+{
+    static const char *names[] = {"scalar", "SSE4.1", "AVX2", "AVX-512"};
+    return target >= ORBIT_KERNEL_SCALAR && target < ORBIT_KERNEL_TARGET_COUNT ? names[target] : "auto";
+}
+void OrbitKernel::sincos(const float *angles, float *sines, float *cosines, std::size_t count, OrbitKernelTarget target)
+{
+    std::size_t done = 0;
+    switch (resolve(target))
+    {
+#ifdef ORBIT_KERNEL_HAS_SIMD
+    case ORBIT_KERNEL_AVX512:
+        done = sincosAVX512(angles, sines, cosines, count);
+        break;
+    case ORBIT_KERNEL_AVX2:
+        done = sincosAVX2(angles, sines, cosines, count);
+        break;
+    case ORBIT_KERNEL_SSE4:
+        done = sincosSSE4(angles, sines, cosines, count);
+        break;
+#endif
+    default:
+        break;
+    }
+    sincosScalar(angles, sines, cosines, done, count);
+}
+void OrbitKernel::evaluate(BodyStore &bodies, std::size_t first, std::size_t count, double time, OrbitKernelTarget target)
+{
+    OrbitArrays a = {bodies.orbitSpeed.data() + first, bodies.meanAnomaly.data() + first, bodies.orbitRadius.data() + first,
+                     bodies.eccentricity.data() + first,
+                     bodies.majorX.data() + first, bodies.majorY.data() + first, bodies.majorZ.data() + first,
+                     bodies.minorX.data() + first, bodies.minorY.data() + first, bodies.minorZ.data() + first,
+                     bodies.offsetX.data() + first, bodies.offsetY.data() + first, bodies.offsetZ.data() + first};
+    std::size_t done = 0;
+    switch (resolve(target))
+    {
+#ifdef ORBIT_KERNEL_HAS_SIMD
+    case ORBIT_KERNEL_AVX512:
+        done = evaluateAVX512(a, time, count);
+        break;
+    case ORBIT_KERNEL_AVX2:
+        done = evaluateAVX2(a, time, count);
+        break;
+    case ORBIT_KERNEL_SSE4:
+        done = evaluateSSE4(a, time, count);
+        break;
+#endif
+    default:
+        break;
+    }
+    evaluateScalar(a, time, done, count);
+}
+void OrbitKernel::solveKepler(const float *meanAnomalies, const float *eccentricities, float *anomalies, std::size_t count, OrbitKernelTarget target)
+{
+    std::size_t done = 0;
+    switch (resolve(target))
+    {
+#ifdef ORBIT_KERNEL_HAS_SIMD
+    case ORBIT_KERNEL_AVX512:
+        done = solveKeplerAVX512(meanAnomalies, eccentricities, anomalies, count);
+        break;
+    case ORBIT_KERNEL_AVX2:
+        done = solveKeplerAVX2(meanAnomalies, eccentricities, anomalies, count);
+        break;
+    case ORBIT_KERNEL_SSE4:
+        done = solveKeplerSSE4(meanAnomalies, eccentricities, anomalies, count);
+        break;
+#endif
+    default:
+        break;
+    }
+    solveKeplerScalar(meanAnomalies, eccentricities, anomalies, done, count);
+}
+void OrbitKernel::writeModels(const BodyStore &bodies, const unsigned int *indices, std::size_t count, float *out, std::size_t stride, OrbitKernelTarget target)
+{
+    unsigned char *dst = (unsigned char *)out;
+    target = resolve(target);
+    if (target == ORBIT_KERNEL_SCALAR)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            unsigned int body = indices ? indices[i] : (unsigned int)i;
+            glm::mat4 model = glm::scale(bodies.getModelMatrix(body), glm::vec3(bodies.radius[body]));
+            std::memcpy(dst + i * stride, &model[0][0], sizeof(model));
+        }
+        return;
+    }
+
+    // spin angles at the store's time, gathered a batch at a time for one vectorized phase and
+    // sincos; the matrices are then mostly constants and products
+    float starts[MODEL_BATCH], rates[MODEL_BATCH], angles[MODEL_BATCH], sines[MODEL_BATCH], cosines[MODEL_BATCH];
+    for (std::size_t first = 0; first < count; first += MODEL_BATCH)
+    {
+        std::size_t n = count - first < MODEL_BATCH ? count - first : MODEL_BATCH;
+        const float *start = bodies.spinPhase.data() + first, *rate = bodies.spin.data() + first;
+        if (indices)
+        {
+            for (std::size_t k = 0; k < n; ++k)
+            {
+                starts[k] = bodies.spinPhase[indices[first + k]];
+                rates[k] = bodies.spin[indices[first + k]];
+            }
+            start = starts;
+            rate = rates;
+        }
+        phases(start, rate, bodies.getTime(), angles, n, target);
+        sincos(angles, sines, cosines, n, target);
+        for (std::size_t k = 0; k < n; ++k)
+        {
+            unsigned int body = indices ? indices[first + k] : (unsigned int)(first + k);
+            storeModel((float *)(dst + (first + k) * stride), cosines[k], sines[k], bodies.scale[body] * bodies.radius[body],
+                       bodies.x[body], bodies.y[body], bodies.z[body]);
+        }
+    }
+}
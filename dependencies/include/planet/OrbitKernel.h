@@ -0,0 +1,50 @@
+#ifndef ORBIT_KERNEL_H
+#define ORBIT_KERNEL_H
+#include <planet/BodyStore.h>
+#include <cstddef>
+
+// instruction sets OrbitKernel runs on
+enum OrbitKernelTarget
+{
+    ORBIT_KERNEL_AUTO = -1, // the best one the CPU supports
+    ORBIT_KERNEL_SCALAR,    // reference: std::sin/std::cos and glm
+    ORBIT_KERNEL_SSE4,
+    ORBIT_KERNEL_AVX2, // with FMA
+    ORBIT_KERNEL_AVX512,
+    ORBIT_KERNEL_TARGET_COUNT
+};
+
+// Batch kernels over the arrays of a BodyStore: orbits and spins at a point in
+// time for BodyStore::setTime() and model matrices for the renderers' instance
+// buffers. The SIMD targets share one sincos: the angle is reduced around the
+// nearest multiple of pi/2 in three steps (Cody-Waite), Cephes' sinf/cosf
+// polynomials are evaluated on the remainder and swapped and negated per
+// quadrant. It stays within a few 1e-7 of the scalar target for |angle| up to
+// about 1e4. Orbit and spin phases are formed in double and wrapped into
+// [-pi, pi] before going to float, so they hold their precision at any time;
+// Kepler's equation is then solved with a fixed number of Halley steps from
+// Danby's starting guess, skipped for registers of circular orbits. A target
+// the CPU lacks runs as scalar; bench/orbitKernelBench.cpp checks every target
+// against it. mingw-w64 cannot realign the stack for the 32- and 64-byte
+// registers the AVX targets spill at -O0 (GCC bug 54412), so every build of
+// this file, Frustum.cpp or Ephemeris.cpp passes -Wa,-muse-unaligned-vector-move.
+class OrbitKernel
+{
+public:
+    static OrbitKernelTarget getBestTarget();
+    static bool isSupported(OrbitKernelTarget target);
+    static const char *getTargetName(OrbitKernelTarget target);
+
+    static void sincos(const float *angles, float *sines, float *cosines, std::size_t count, OrbitKernelTarget target = ORBIT_KERNEL_AUTO);
+    // for bodies [first, first + count) at the time: offsetX, Y, Z from the focus along the
+    // orbit at mean anomaly meanAnomaly + orbitSpeed * time
+    static void evaluate(BodyStore &bodies, std::size_t first, std::size_t count, double time, OrbitKernelTarget target = ORBIT_KERNEL_AUTO);
+    // eccentric anomalies E of E - e sin E = M, M in [-pi, pi], as evaluate() solves it
+    static void solveKepler(const float *meanAnomalies, const float *eccentricities, float *anomalies, std::size_t count, OrbitKernelTarget target = ORBIT_KERNEL_AUTO);
+    // translate(position) * rotateY(getAngle()) * scale(scale * radius), the unit sphere to world,
+    // of bodies indices[0..count), or the first count bodies when indices is NULL;
+    // written as 16 column-major floats every stride bytes from out
+    static void writeModels(const BodyStore &bodies, const unsigned int *indices, std::size_t count, float *out, std::size_t stride, OrbitKernelTarget target = ORBIT_KERNEL_AUTO);
+};
+
+#endif
@@ -1,58 +1,114 @@
 #include "Planet.h"
 #include <stb_image.h>
 #include <iostream>
+#include <cmath>
 #include <glm/gtc/type_ptr.hpp>
 
-Planet::Planet(float radius, int sectors, int stacks, const std::string &texturePath)
-    : sphere(radius, sectors, stacks), position(0.0f), rotationSpeed(1.0f), angle(0.0f), scale(1.0f)
+Planet::Planet(BodyStore &bodies, float radius, int sectors, int stacks, const std::string &texturePath)
+    : sphere(radius, sectors, stacks), bodies(&bodies)
 {
     textureID = loadTexture(texturePath);
+    body = bodies.add(radius);
 }
-Planet::~Planet()
+Planet::Planet(BodyStore &bodies, float radius, int sectors, int stacks, TextureArray &textures, const std::string &texturePath)
+    : sphere(radius, sectors, stacks), textureArray(&textures), textureID(0), bodies(&bodies)
 {
-    glDeleteTextures(1, &textureID);
+    body = bodies.add(radius, textures.addLayer(texturePath));
 }
-void Planet::update(float deltaTime)
+Planet::~Planet()
 {
-    // rotation
-    angle += rotationSpeed * deltaTime;
-    orbitAngle += orbitSpeed * deltaTime;
-    position.x = orbitCenter.x + orbitRadius * cos(orbitAngle);
-    position.z = orbitCenter.z + orbitRadius * sin(orbitAngle);
+    if (meshArena)
+        meshArena->remove(arenaMesh);
+    if (textureArray && getTextureLayer() >= 0)
+        textureArray->releaseLayer(getTextureLayer());
+    glDeleteTextures(1, &textureID);
 }
-void Planet::draw(unsigned int shaderProgram)
+void Planet::draw(const Shader &shader)
 {
-    glUseProgram(shaderProgram);
+    static constexpr unsigned int MODEL = uniformHash("model");
+    static constexpr unsigned int PACKED_NORMAL = uniformHash("packedNormal");
+
+    glUseProgram(shader.ID);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    glm::mat4 trans = glm::mat4(1.0f);
-    trans = translate(trans, position);
-    trans = rotate(trans, angle, glm::vec3(0.0f, 1.0f, 0.0f));
-    trans = glm::scale(trans, glm::vec3(scale));
+    // packed spheres store positions in units of their radius
+    glm::mat4 trans = glm::scale(getModelMatrix(), glm::vec3(sphere.getPositionScale()));
+
+    shader.setMat4(shader.getUniform(MODEL), trans);
+    shader.setBool(shader.getUniform(PACKED_NORMAL), sphere.isPacked());
 
-    unsigned int transformLoc = glGetUniformLocation(shaderProgram, "model");
-    glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(trans));
+    if (meshArena)
+        meshArena->draw(arenaMesh);
+    else
+        sphere.draw();
+}
+bool Planet::moveMeshTo(MeshArena &arena)
+{
+    if (meshArena)
+        meshArena->remove(arenaMesh);
+    meshArena = nullptr;
 
-    sphere.draw();
+    sphere.setPacked(arena.isPacked());
+    arenaMesh = arena.add(sphere);
+    if (arenaMesh.indexCount == 0)
+        return false;
+    meshArena = &arena;
+    sphere.releaseCpuData(true);
+    return true;
+}
+void Planet::releaseMesh(bool keepPickingCopy)
+{
+    sphere.releaseCpuData(keepPickingCopy);
+}
+bool Planet::intersectRay(const glm::vec3 &origin, const glm::vec3 &dir, float &t) const
+{
+    // into object space; the transform is affine, so t is the same in both spaces
+    glm::mat4 toObject = glm::inverse(getModelMatrix());
+    glm::vec3 localOrigin = glm::vec3(toObject * glm::vec4(origin, 1.0f));
+    glm::vec3 localDir = glm::vec3(toObject * glm::vec4(dir, 0.0f));
+    return sphere.intersectRay(glm::value_ptr(localOrigin), glm::value_ptr(localDir), t);
 }
 void Planet::setPlanetPos(const glm::vec3 &pos)
 {
-    position = pos;
+    setOrbitCenter(pos);
 }
 void Planet::setRotationSpeed(float speed)
 {
-    rotationSpeed = speed;
+    bodies->setSpin(body, speed);
 }
 void Planet::setScale(float s)
 {
-    scale = s;
+    bodies->scale[body] = s;
 }
 void Planet::setOrbit(float radius, float speed, const glm::vec3 &center)
 {
-    orbitRadius = radius;
-    orbitSpeed = speed;
-    orbitCenter = center;
+    // a circle from +x towards +z, dropping the shape and tilt of an earlier ellipse; set at rest
+    // at the current mean anomaly first, so setOrbitSpeed() goes on from there
+    double now = bodies->meanAnomaly[body] + (double)bodies->orbitSpeed[body] * bodies->getTime();
+    OrbitalElements circle = {radius, 0.0f, 0.0f, 0.0f, 0.0f, (float)std::remainder(now, 2.0 * glm::pi<double>()), 0.0f};
+    bodies->setOrbit(body, circle);
+    bodies->setOrbitSpeed(body, speed);
+    setOrbitCenter(center);
+}
+bool Planet::setOrbit(const OrbitalElements &elements, const glm::vec3 &center)
+{
+    if (!bodies->setOrbit(body, elements))
+    {
+        std::cerr << "Planet: an orbit's eccentricity has to be in [0, 1)" << std::endl;
+        return false;
+    }
+    setOrbitCenter(center);
+    return true;
+}
+bool Planet::setParent(const Planet &parent)
+{
+    if (parent.bodies != bodies || !bodies->setParent(body, (int)parent.body))
+    {
+        std::cerr << "Planet: a parent has to be in the same store and must not orbit its child" << std::endl;
+        return false;
+    }
+    return true;
 }
 unsigned int Planet::loadTexture(const std::string &path)
 {
@@ -85,25 +141,31 @@ unsigned int Planet::loadTexture(const std::string &path)
 }
 void Planet::increaseRotationSpeed()
 {
-    orbitSpeed += 0.1f;
+    bodies->setOrbitSpeed(body, bodies->orbitSpeed[body] + 0.1f);
 }
 void Planet::decreaseRotationSpeed()
 {
-    orbitSpeed -= 0.01f;
+    float orbitSpeed = bodies->orbitSpeed[body] - 0.01f;
     if (orbitSpeed < 0.0f)
         orbitSpeed = 0.0f;
+    bodies->setOrbitSpeed(body, orbitSpeed);
 }
 void Planet::increaseOrbitSpeed()
 {
-    rotationSpeed += 0.01f;
+    bodies->setSpin(body, bodies->spin[body] + 0.01f);
 }
 void Planet::decreaseOrbitSpeed()
 {
-    rotationSpeed -= 0.11f;
+    float rotationSpeed = bodies->spin[body] - 0.11f;
     if (rotationSpeed < 0.0f)
         rotationSpeed = 0.0f;
+    bodies->setSpin(body, rotationSpeed);
 }
 glm::vec3 Planet::getPlanetPosi() const
 {
-    return position;
+    return bodies->getPosition(body);
+}
+glm::mat4 Planet::getModelMatrix() const
+{
+    return bodies->getModelMatrix(body);
 }
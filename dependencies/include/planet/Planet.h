@@ -4,21 +4,46 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <Sphere/Sphere.h>
+#include <shadersPrograms/shader.h>
+#include <renderer/TextureArray.h>
+#include <renderer/MeshArena.h>
+#include <planet/BodyStore.h>
 #include <string>
 
+// Handle to a body in a BodyStore, which holds its motion and is updated for
+// every body at once; the planet itself keeps the mesh and texture.
 class Planet
 {
 public:
-    Planet(float radius, int sectors, int stacks, const std::string &texturePath);
+    Planet(BodyStore &bodies, float radius, int sectors, int stacks, const std::string &texturePath);
+    // texture goes into a shared array instead of a texture of its own
+    Planet(BodyStore &bodies, float radius, int sectors, int stacks, TextureArray &textures, const std::string &texturePath);
     ~Planet();
 
-    void update(float deltaTime);
-    void draw(unsigned int shaderProgram);
+    void draw(const Shader &shader);
 
+    // moves the mesh into a shared arena (converted to its vertex format), keeping a compact
+    // copy for picking; draw() then expects the arena to be bound
+    bool moveMeshTo(MeshArena &arena);
+    // for bodies drawn elsewhere (InstancedRenderer): frees the own mesh, keeping a compact copy for picking
+    void releaseMesh(bool keepPickingCopy = true);
+    // world-space ray against the body's mesh, t along dir
+    bool intersectRay(const glm::vec3 &origin, const glm::vec3 &dir, float &t) const;
+    SphereMemory getMeshMemory() const
+    {
+        return sphere.getMemoryUsage();
+    };
+
+    // the orbit centre, see setOrbitCenter()
     void setPlanetPos(const glm::vec3 &position);
     void setRotationSpeed(float speed);
     void setScale(float scale);
+    // a circle of the radius from +x towards +z, speed in radians per second; replaces any ellipse
     void setOrbit(float radius, float speed, const glm::vec3 &center = glm::vec3(0.0f));
+    // an ellipse with its focus at center
+    bool setOrbit(const OrbitalElements &elements, const glm::vec3 &center = glm::vec3(0.0f));
+    // orbits parent from then on, whichever of the two was created first
+    bool setParent(const Planet &parent);
 
     void increaseRotationSpeed();
     void decreaseRotationSpeed();
@@ -27,31 +52,51 @@ public:
 
     float getRotationSpeed() const
     {
-        return rotationSpeed;
+        return bodies->spin[body];
     };
     float getOrbitingSpeed() const
     {
-        return orbitSpeed;
+        return bodies->orbitSpeed[body];
     };
+    // relative to the parent, or the world without one
     void setOrbitCenter(const glm::vec3 &center)
     {
-        orbitCenter = center;
+        bodies->centerX[body] = center.x;
+        bodies->centerY[body] = center.y;
+        bodies->centerZ[body] = center.z;
+        bodies->markDirty(body);
     };
     glm::vec3 getPlanetPosi() const;
+    glm::mat4 getModelMatrix() const;
+    float getRadius() const
+    {
+        return sphere.getRadius();
+    };
+    float getBoundingRadius() const
+    {
+        return bodies->getBoundingRadius(body);
+    };
+    unsigned int getTextureID() const
+    {
+        return textureID;
+    };
+    int getTextureLayer() const
+    {
+        return bodies->textureLayer[body];
+    };
+    unsigned int getBody() const
+    {
+        return body;
+    };
 
 private:
     Sphere sphere;
+    MeshArena *meshArena = nullptr;
+    MeshRange arenaMesh;
+    TextureArray *textureArray = nullptr; // shared layer, released with the planet
     unsigned int textureID;
-
-    glm::vec3 position;
-    float rotationSpeed;
-    float angle;
-    float scale;
-
-    float orbitRadius = 0.0f;
-    float orbitSpeed = 0.0f;
-    float orbitAngle = 0.0f;
-    glm::vec3 orbitCenter = glm::vec3(0.0f);
+    BodyStore *bodies;
+    unsigned int body;
 
     unsigned int loadTexture(const std::string &texPath);
 };
@@ -0,0 +1,127 @@
+#include "FrameUniforms.h"
+#include <cstddef>
+#include <cstring>
+
+namespace
+{
+    // byte range of each section inside FrameData
+    const std::size_t SECTION_OFFSET[] = {offsetof(FrameData, view), offsetof(FrameData, dirLight), offsetof(FrameData, pointLight)};
+    const std::size_t SECTION_SIZE[] = {offsetof(FrameData, dirLight), sizeof(glm::vec4) * 4, sizeof(glm::vec4) * 4};
+}
+
+FrameUniforms::FrameUniforms()
+{
+    std::memset(&data, 0, sizeof(data));
+    for (int s = 0; s < SECTION_COUNT; ++s)
+    {
+        versions[s] = 1; // every slot starts stale
+        for (int i = 0; i < RING_SIZE; ++i)
+            slotVersions[i][s] = 0;
+    }
+    for (int i = 0; i < RING_SIZE; ++i)
+        fences[i] = 0;
+
+    int alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slotStride = ((GLsizeiptr)sizeof(FrameData) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &UBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    glBufferData(GL_UNIFORM_BUFFER, slotStride * RING_SIZE, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+FrameUniforms::~FrameUniforms()
+{
+    for (int i = 0; i < RING_SIZE; ++i)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+    glDeleteBuffers(1, &UBO);
+}
+void FrameUniforms::setCamera(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &viewPos)
+{
+    unsigned char camera[offsetof(FrameData, dirLight)];
+    std::memcpy(camera + offsetof(FrameData, view), &view, sizeof(view));
+    std::memcpy(camera + offsetof(FrameData, projection), &projection, sizeof(projection));
+    glm::vec4 position(viewPos, 1.0f);
+    std::memcpy(camera + offsetof(FrameData, viewPos), &position, sizeof(position));
+    setSection(CAMERA, camera);
+}
+void FrameUniforms::setDirLight(const glm::vec3 &direction, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular)
+{
+    glm::vec4 light[4] = {glm::vec4(direction, 0.0f), glm::vec4(ambient, 0.0f), glm::vec4(diffuse, 0.0f), glm::vec4(specular, 0.0f)};
+    setSection(DIR_LIGHT, light);
+}
+void FrameUniforms::setPointLight(const glm::vec3 &position, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular)
+{
+    glm::vec4 light[4] = {glm::vec4(position, 1.0f), glm::vec4(ambient, 0.0f), glm::vec4(diffuse, 0.0f), glm::vec4(specular, 0.0f)};
+    setSection(POINT_LIGHT, light);
+}
+void FrameUniforms::setSection(Section section, const void *value)
+{
+    unsigned char *dst = (unsigned char *)&data + SECTION_OFFSET[section];
+    if (std::memcmp(dst, value, SECTION_SIZE[section]) == 0)
+        return;
+    std::memcpy(dst, value, SECTION_SIZE[section]);
+    ++versions[section];
+}
+void FrameUniforms::upload()
+{
+    uploadedBytes = 0;
+
+    // the slot in use was read by everything submitted so far
+    if (fences[slot])
+        glDeleteSync(fences[slot]);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    bool current = true;
+    for (int s = 0; s < SECTION_COUNT; ++s)
+        current = current && slotVersions[slot][s] == versions[s];
+    if (current)
+    {
+        glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, UBO, slot * slotStride, sizeof(FrameData));
+        return;
+    }
+
+    // something changed: move to the next slot and bring only its stale sections up to date
+    slot = (slot + 1) % RING_SIZE;
+    waitForSlot(slot);
+
+    std::size_t first = sizeof(FrameData), last = 0;
+    for (int s = 0; s < SECTION_COUNT; ++s)
+    {
+        if (slotVersions[slot][s] == versions[s])
+            continue;
+        if (SECTION_OFFSET[s] < first)
+            first = SECTION_OFFSET[s];
+        if (SECTION_OFFSET[s] + SECTION_SIZE[s] > last)
+            last = SECTION_OFFSET[s] + SECTION_SIZE[s];
+    }
+
+    // the mapped range is invalidated as a whole, so every section inside it is written,
+    // current ones between two stale ones included
+    glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+    unsigned char *dst = (unsigned char *)glMapBufferRange(GL_UNIFORM_BUFFER, slot * slotStride + first, last - first,
+                                                           GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (dst)
+    {
+        std::memcpy(dst, (unsigned char *)&data + first, last - first);
+        uploadedBytes = (unsigned int)(last - first);
+        for (int s = 0; s < SECTION_COUNT; ++s)
+            if (SECTION_OFFSET[s] >= first && SECTION_OFFSET[s] + SECTION_SIZE[s] <= last)
+                slotVersions[slot][s] = versions[s];
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, UBO, slot * slotStride, sizeof(FrameData));
+}
+void FrameUniforms::waitForSlot(int index)
+{
+    if (!fences[index])
+        return;
+    // the fence is RING_SIZE frames old, so this normally returns at once
+    while (glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        ;
+    glDeleteSync(fences[index]);
+    fences[index] = 0;
+}
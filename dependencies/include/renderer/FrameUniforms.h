@@ -0,0 +1,64 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// std140 mirror of the FrameData uniform block declared in the shaders
+struct FrameData
+{
+    glm::mat4 view;          // offset 0
+    glm::mat4 projection;    // 64
+    glm::vec4 viewPos;       // 128, xyz used
+    glm::vec4 dirLight[4];   // 144, direction/ambient/diffuse/specular
+    glm::vec4 pointLight[4]; // 208, position/ambient/diffuse/specular
+};
+
+// Per-frame constants shared by every program through one uniform binding point.
+// Setters only mark a section dirty when its value actually changes, and upload()
+// writes the dirty sections, and any between them, into the next slot of a
+// triple-buffered ring so the CPU never overwrites data the GPU may still be reading.
+class FrameUniforms
+{
+public:
+    static const unsigned int BINDING = 0;
+
+    FrameUniforms();
+    ~FrameUniforms();
+
+    void setCamera(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &viewPos);
+    void setDirLight(const glm::vec3 &direction, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular);
+    void setPointLight(const glm::vec3 &position, const glm::vec3 &ambient, const glm::vec3 &diffuse, const glm::vec3 &specular);
+
+    // call once per frame, after the setters and before drawing
+    void upload();
+
+    unsigned int getUploadedBytes() const
+    {
+        return uploadedBytes;
+    };
+
+private:
+    enum Section
+    {
+        CAMERA,
+        DIR_LIGHT,
+        POINT_LIGHT,
+        SECTION_COUNT
+    };
+    static const int RING_SIZE = 3;
+
+    FrameData data;
+    unsigned int versions[SECTION_COUNT];
+    unsigned int slotVersions[RING_SIZE][SECTION_COUNT]; // what each ring slot currently holds
+
+    unsigned int UBO = 0;
+    GLsizeiptr slotStride = 0;
+    int slot = 0;
+    GLsync fences[RING_SIZE];
+    unsigned int uploadedBytes = 0;
+
+    void setSection(Section section, const void *value);
+    void waitForSlot(int index);
+};
+
+#endif
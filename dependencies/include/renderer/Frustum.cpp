@@ -0,0 +1,157 @@
+#include "Frustum.h"
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// built with -Wa,-muse-unaligned-vector-move on mingw, see OrbitKernel.h
+#include <immintrin.h>
+#define FRUSTUM_HAS_AVX 1
+#endif
+
+namespace
+{
+    bool hasAVX()
+    {
+#ifdef FRUSTUM_HAS_AVX
+        static const bool supported = __builtin_cpu_supports("avx");
+        return supported;
+#else
+        return false;
+#endif
+    }
+}
+
+void BoundingSpheres::clear()
+{
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+}
+void BoundingSpheres::add(const glm::vec3 &center, float r)
+{
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(r);
+}
+
+Frustum::Frustum()
+    : vectorized(hasAVX())
+{
+}
+void Frustum::setVectorized(bool enabled)
+{
+    vectorized = enabled && hasAVX();
+}
+
+// Gribb/Hartmann: each plane is the 4th row of the matrix plus or minus one of the others
+void Frustum::extract(const glm::mat4 &m)
+{
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    planes[0] = row3 + row0; // left
+    planes[1] = row3 - row0; // right
+    planes[2] = row3 + row1; // bottom
+    planes[3] = row3 - row1; // top
+    planes[4] = row3 + row2; // near
+    planes[5] = row3 - row2; // far
+
+    // normalize so plane distances are in world units and compare against radii
+    for (int i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+bool Frustum::testSphere(const glm::vec3 &center, float radius) const
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
+std::size_t Frustum::cull(const BoundingSpheres &spheres, std::vector<unsigned int> &visible) const
+{
+    visible.resize(spheres.size());
+    if (spheres.size() == 0)
+        return 0;
+    std::size_t count = cull(spheres.x.data(), spheres.y.data(), spheres.z.data(), spheres.radius.data(), spheres.size(), visible.data());
+    visible.resize(count);
+    return count;
+}
+std::size_t Frustum::cull(const float *x, const float *y, const float *z, const float *radius, std::size_t count, unsigned int *visible) const
+{
+#ifdef FRUSTUM_HAS_AVX
+    if (vectorized)
+        return cullAVX(x, y, z, radius, count, visible);
+#endif
+    return cullScalar(x, y, z, radius, 0, count, visible);
+}
+std::size_t Frustum::cullScalar(const float *x, const float *y, const float *z, const float *radius, std::size_t first, std::size_t count, unsigned int *visible) const
+{
+    std::size_t n = 0;
+    for (std::size_t i = first; i < count; ++i)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; ++p)
+            inside = planes[p].x * x[i] + planes[p].y * y[i] + planes[p].z * z[i] + planes[p].w >= -radius[i];
+        if (inside)
+            visible[n++] = (unsigned int)i;
+    }
+    return n;
+}
+
+#ifdef FRUSTUM_HAS_AVX
+// 8 spheres per iteration: signed distance to each plane, AND the six inside
+// masks, then compact the surviving indices from the movemask bits. Multiplies
+// and adds in the scalar order and without FMA, so a sphere touching a plane
+// gets the same answer on both paths
+__attribute__((target("avx"))) std::size_t Frustum::cullAVX(const float *x, const float *y, const float *z, const float *radius, std::size_t count, unsigned int *visible) const
+{
+    __m256 pa[6], pb[6], pc[6], pd[6];
+    for (int p = 0; p < 6; ++p)
+    {
+        pa[p] = _mm256_set1_ps(planes[p].x);
+        pb[p] = _mm256_set1_ps(planes[p].y);
+        pc[p] = _mm256_set1_ps(planes[p].z);
+        pd[p] = _mm256_set1_ps(planes[p].w);
+    }
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+    std::size_t n = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 vx = _mm256_loadu_ps(x + i);
+        __m256 vy = _mm256_loadu_ps(y + i);
+        __m256 vz = _mm256_loadu_ps(z + i);
+        __m256 negR = _mm256_xor_ps(_mm256_loadu_ps(radius + i), signBit);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; ++p)
+        {
+            __m256 d = _mm256_add_ps(_mm256_mul_ps(pa[p], vx), _mm256_mul_ps(pb[p], vy));
+            d = _mm256_add_ps(_mm256_add_ps(d, _mm256_mul_ps(pc[p], vz)), pd[p]);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+        }
+
+        // every lane is written and only the inside ones advance n, which keeps the
+        // unpredictable mask out of the branches; n <= i, so the 8 writes stay within count
+        unsigned int mask = (unsigned int)_mm256_movemask_ps(inside);
+        for (unsigned int k = 0; k < 8; ++k)
+        {
+            visible[n] = (unsigned int)i + k;
+            n += (mask >> k) & 1;
+        }
+    }
+
+    return n + cullScalar(x, y, z, radius, i, count, visible + n);
+}
+#else
+std::size_t Frustum::cullAVX(const float *x, const float *y, const float *z, const float *radius, std::size_t count, unsigned int *visible) const
+{
+    return cullScalar(x, y, z, radius, 0, count, visible);
+}
+#endif
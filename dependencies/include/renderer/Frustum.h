@@ -0,0 +1,57 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstddef>
+
+// bounding spheres kept as separate contiguous arrays so they can be tested 8 at a time
+struct BoundingSpheres
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    void clear();
+    void add(const glm::vec3 &center, float r);
+    std::size_t size() const
+    {
+        return radius.size();
+    };
+};
+
+// View frustum as six normalized planes (left, right, bottom, top, near, far).
+class Frustum
+{
+public:
+    Frustum();
+
+    // planes of projection * view, pointing inwards
+    void extract(const glm::mat4 &viewProjection);
+
+    bool testSphere(const glm::vec3 &center, float radius) const;
+    const glm::vec4 *getPlanes() const
+    {
+        return planes;
+    };
+
+    // writes the indices of the spheres that intersect the frustum to visible and returns how many there are
+    std::size_t cull(const BoundingSpheres &spheres, std::vector<unsigned int> &visible) const;
+    std::size_t cull(const float *x, const float *y, const float *z, const float *radius, std::size_t count, unsigned int *visible) const;
+
+    // the AVX test 8 spheres at a time when the CPU supports it, off for the scalar reference
+    void setVectorized(bool enabled);
+    bool isVectorized() const
+    {
+        return vectorized;
+    };
+
+private:
+    glm::vec4 planes[6];
+    bool vectorized;
+
+    std::size_t cullScalar(const float *x, const float *y, const float *z, const float *radius, std::size_t first, std::size_t count, unsigned int *visible) const;
+    std::size_t cullAVX(const float *x, const float *y, const float *z, const float *radius, std::size_t count, unsigned int *visible) const;
+};
+
+#endif
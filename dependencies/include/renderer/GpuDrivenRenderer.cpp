@@ -0,0 +1,267 @@
+#include "GpuDrivenRenderer.h"
+#include <planet/Planet.h>
+#include <planet/OrbitKernel.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+
+namespace
+{
+    const int UNKNOWN_LEVEL = -2; // lastLevels entry of a body never drawn
+    const unsigned int ELEMENTS_COMMAND_SIZE = 5; // uints in a DrawElementsIndirectCommand
+    const unsigned int ARRAYS_COMMAND_SIZE = 4;   // uints in a DrawArraysIndirectCommand
+}
+
+bool GpuDrivenRenderer::isSupported()
+{
+    if (!GLAD_GL_VERSION_4_3)
+        return false;
+    // GL 4.3 allows 0 storage blocks in vertex shaders
+    int vertexBlocks = 0;
+    glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+    return vertexBlocks > 0;
+}
+
+GpuDrivenRenderer::GpuDrivenRenderer(MeshArena &arena, const Shader &cullShader, int minSectors, int maxSectors)
+    : arena(arena), lod(minSectors, maxSectors, true), cullProgram(cullShader.ID)
+{
+    if (!arena.isPacked())
+        std::cerr << "GpuDrivenRenderer: the mesh arena must use the packed vertex format" << std::endl;
+    if (lod.getLevelCount() > MAX_LEVELS)
+        std::cerr << "GpuDrivenRenderer: more than " << MAX_LEVELS << " levels" << std::endl;
+
+    // each level becomes its own mesh in the arena
+    const unsigned char *vertices = (const unsigned char *)lod.getVertexData();
+    const unsigned char *indices = (const unsigned char *)lod.getIndexData();
+    for (int l = 0; l < lod.getLevelCount(); ++l)
+    {
+        const SphereLevel &level = lod.getLevel(l);
+        levelMeshes.push_back(arena.add(vertices + (std::size_t)level.baseVertex * lod.getInterleavedStride(), level.vertexCount,
+                                        indices + (std::size_t)level.firstIndex * lod.getIndexTypeSize(), level.indexCount, lod.getIndexType()));
+    }
+
+    bodyCountUniform = cullShader.getUniform(uniformHash("bodyCount"));
+    regionSizeUniform = cullShader.getUniform(uniformHash("regionSize"));
+    frustumPlanesUniform = cullShader.getUniform(uniformHash("frustumPlanes"));
+    cameraPosUniform = cullShader.getUniform(uniformHash("cameraPos"));
+    pixelScaleUniform = cullShader.getUniform(uniformHash("pixelScale"));
+    pixelsPerEdgeUniform = cullShader.getUniform(uniformHash("pixelsPerEdge"));
+    pointRadiusUniform = cullShader.getUniform(uniformHash("pointRadius"));
+    hysteresisUniform = cullShader.getUniform(uniformHash("hysteresis"));
+    levelCountUniform = cullShader.getUniform(uniformHash("levelCount"));
+    levelSectorsUniform = cullShader.getUniform(uniformHash("levelSectors"));
+
+    glGenBuffers(1, &bodyBuffer);
+    glGenBuffers(1, &lastLevelBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &visibleBuffer);
+    commands.assign(lod.getLevelCount() * ELEMENTS_COMMAND_SIZE + ARRAYS_COMMAND_SIZE, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, commandBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, commands.size() * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    reserve(GROUP_SIZE);
+
+    // the visible index run of each level is read through baseInstance
+    vertexArray = arena.createVertexArray();
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(unsigned int), (void *)0);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glBindVertexArray(0);
+}
+GpuDrivenRenderer::~GpuDrivenRenderer()
+{
+    for (std::size_t l = 0; l < levelMeshes.size(); ++l)
+        arena.remove(levelMeshes[l]);
+    arena.deleteVertexArray(vertexArray);
+    glDeleteBuffers(1, &visibleBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &lastLevelBuffer);
+    glDeleteBuffers(1, &bodyBuffer);
+}
+unsigned int GpuDrivenRenderer::addBody(const glm::mat4 &model, int textureLayer, unsigned int flags)
+{
+    GpuBody body;
+    body.textureLayer = (float)textureLayer;
+    body.flags = flags;
+    body.padding[0] = body.padding[1] = 0.0f;
+    bodies.push_back(body);
+    setBody((unsigned int)bodies.size() - 1, model);
+    return (unsigned int)bodies.size() - 1;
+}
+unsigned int GpuDrivenRenderer::addBody(const Planet &planet, unsigned int flags)
+{
+    unsigned int body = addBody(glm::mat4(1.0f), planet.getTextureLayer(), flags);
+    setBody(body, planet);
+    return body;
+}
+void GpuDrivenRenderer::setBody(unsigned int body, const glm::mat4 &model)
+{
+    // uniform scale, so the length of any basis column is the world radius
+    bodies[body].model = model;
+    bodies[body].bounds = glm::vec4(glm::vec3(model[3]), glm::length(glm::vec3(model[0])));
+    markDirty(body);
+}
+void GpuDrivenRenderer::setBody(unsigned int body, const Planet &planet)
+{
+    // the shared mesh has unit radius, so the body radius goes into the model matrix
+    setBody(body, glm::scale(planet.getModelMatrix(), glm::vec3(planet.getRadius())));
+}
+void GpuDrivenRenderer::setBodies(const BodyStore &store)
+{
+    std::size_t count = bodies.size() < store.size() ? bodies.size() : store.size();
+    if (count == 0)
+        return;
+    OrbitKernel::writeModels(store, NULL, count, &bodies[0].model[0][0], sizeof(GpuBody));
+    for (std::size_t i = 0; i < count; ++i)
+        bodies[i].bounds = glm::vec4(store.getPosition((unsigned int)i), store.getBoundingRadius((unsigned int)i));
+    markDirty(0);
+    markDirty(count - 1);
+}
+void GpuDrivenRenderer::clear()
+{
+    bodies.clear();
+    dirtyFirst = dirtyEnd = 0;
+    // indices will be reused by other bodies, forget their levels
+    glBindBuffer(GL_COPY_WRITE_BUFFER, lastLevelBuffer);
+    glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &UNKNOWN_LEVEL);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+void GpuDrivenRenderer::setView(const glm::vec3 &position, const glm::mat4 &view, const glm::mat4 &projection, int viewportHeight)
+{
+    cameraPos = position;
+    frustum.extract(projection * view);
+    // projection[1][1] = 1 / tan(fovy / 2)
+    pixelScale = projection[1][1] * viewportHeight * 0.5f;
+}
+void GpuDrivenRenderer::markDirty(std::size_t body)
+{
+    if (dirtyFirst == dirtyEnd)
+    {
+        dirtyFirst = body;
+        dirtyEnd = body + 1;
+        return;
+    }
+    if (body < dirtyFirst)
+        dirtyFirst = body;
+    if (body + 1 > dirtyEnd)
+        dirtyEnd = body + 1;
+}
+// grows every per-body buffer to at least bodyCount, keeping the level history
+void GpuDrivenRenderer::reserve(unsigned int bodyCount)
+{
+    if (bodyCount <= capacity)
+        return;
+    unsigned int oldCapacity = capacity;
+    capacity = capacity * 2 > bodyCount ? capacity * 2 : bodyCount;
+    const int levelCount = lod.getLevelCount();
+
+    // same buffer names, so the VAO and the bindings stay valid
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bodyBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (std::size_t)capacity * sizeof(GpuBody), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, visibleBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (std::size_t)capacity * (levelCount + 1) * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+    if (!bodies.empty())
+    {
+        dirtyFirst = 0;
+        dirtyEnd = bodies.size();
+    }
+
+    unsigned int levels;
+    glGenBuffers(1, &levels);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, levels);
+    glBufferData(GL_COPY_WRITE_BUFFER, (std::size_t)capacity * sizeof(int), NULL, GL_DYNAMIC_COPY);
+    glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32I, GL_RED_INTEGER, GL_INT, &UNKNOWN_LEVEL);
+    if (oldCapacity)
+    {
+        glBindBuffer(GL_COPY_READ_BUFFER, lastLevelBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (std::size_t)oldCapacity * sizeof(int));
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &lastLevelBuffer);
+    lastLevelBuffer = levels;
+
+    // level l reads its visible indices from run l, the points from the last run
+    for (int l = 0; l < levelCount; ++l)
+    {
+        unsigned int *command = &commands[l * ELEMENTS_COMMAND_SIZE];
+        command[0] = levelMeshes[l].indexCount;
+        command[1] = 0; // instanceCount, counted by the compute shader
+        command[2] = levelMeshes[l].firstIndex;
+        command[3] = levelMeshes[l].baseVertex;
+        command[4] = l * capacity; // baseInstance
+    }
+    unsigned int *points = &commands[levelCount * ELEMENTS_COMMAND_SIZE];
+    points[0] = 1;
+    points[1] = 0;
+    points[2] = 0;
+    points[3] = levelCount * capacity;
+}
+void GpuDrivenRenderer::uploadBodies()
+{
+    reserve((unsigned int)bodies.size());
+    if (dirtyFirst == dirtyEnd)
+        return;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bodyBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, dirtyFirst * sizeof(GpuBody), (dirtyEnd - dirtyFirst) * sizeof(GpuBody), &bodies[dirtyFirst]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    dirtyFirst = dirtyEnd = 0;
+}
+void GpuDrivenRenderer::draw(unsigned int shaderProgram, unsigned int pointProgram, const TextureArray &textures)
+{
+    if (bodies.empty())
+        return;
+    uploadBodies();
+    const int levelCount = lod.getLevelCount();
+
+    // fresh commands with every instance count at 0
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(unsigned int), commands.data());
+
+    glUseProgram(cullProgram);
+    int sectors[MAX_LEVELS];
+    for (int l = 0; l < levelCount && l < MAX_LEVELS; ++l)
+        sectors[l] = lod.getLevel(l).sectorCount;
+    glUniform1ui(bodyCountUniform.location, (unsigned int)bodies.size());
+    glUniform1ui(regionSizeUniform.location, capacity);
+    glUniform4fv(frustumPlanesUniform.location, 6, glm::value_ptr(frustum.getPlanes()[0]));
+    glUniform3fv(cameraPosUniform.location, 1, glm::value_ptr(cameraPos));
+    glUniform1f(pixelScaleUniform.location, pixelScale);
+    glUniform1f(pixelsPerEdgeUniform.location, pixelsPerEdge);
+    glUniform1f(pointRadiusUniform.location, pointRadius);
+    glUniform1f(hysteresisUniform.location, hysteresis);
+    glUniform1i(levelCountUniform.location, levelCount < MAX_LEVELS ? levelCount : MAX_LEVELS);
+    glUniform1iv(levelSectorsUniform.location, levelCount < MAX_LEVELS ? levelCount : MAX_LEVELS, sectors);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, bodyBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, lastLevelBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleBuffer);
+    glDispatchCompute(((unsigned int)bodies.size() + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+    // the draws read commands, indices and bodies; the next frame rewrites the
+    // commands and reads the levels back
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // bodies stay bound at 0 for the vertex shaders
+    textures.bind(0);
+    glBindVertexArray(vertexArray);
+    glUseProgram(shaderProgram);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, arena.getIndexType(), (void *)0, levelCount, 0);
+    glUseProgram(pointProgram);
+    glDrawArraysIndirect(GL_POINTS, (void *)(std::size_t)(levelCount * ELEMENTS_COMMAND_SIZE * sizeof(unsigned int)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+void GpuDrivenRenderer::readLevelCounts(std::vector<unsigned int> &counts) const
+{
+    const int levelCount = lod.getLevelCount();
+    std::vector<unsigned int> written(commands.size());
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_COPY_READ_BUFFER, commandBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, 0, written.size() * sizeof(unsigned int), written.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    counts.resize(levelCount + 1);
+    for (int l = 0; l <= levelCount; ++l)
+        counts[l] = written[l * ELEMENTS_COMMAND_SIZE + 1];
+}
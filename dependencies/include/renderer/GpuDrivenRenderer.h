@@ -0,0 +1,115 @@
+#ifndef GPU_DRIVEN_RENDERER_H
+#define GPU_DRIVEN_RENDERER_H
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <Sphere/SphereLod.h>
+#include <renderer/MeshArena.h>
+#include <renderer/Frustum.h>
+#include <renderer/TextureArray.h>
+#include <shadersPrograms/shader.h>
+#include <vector>
+
+class Planet;
+struct BodyStore;
+
+// std430 body record shared with cullComputeShader.glsl and gpuVertexShader.glsl
+struct GpuBody
+{
+    glm::mat4 model;  // unit sphere to world, radius included
+    glm::vec4 bounds; // world centre, bounding radius
+    float textureLayer;
+    unsigned int flags; // InstanceFlags
+    float padding[2];
+};
+
+// GPU-driven counterpart of InstancedRenderer for GL 4.3 contexts.
+// Bodies live in a shader storage buffer and persist across frames; only the
+// ones changed with setBody() are uploaded again. Each draw() runs
+// cullComputeShader.glsl over all bodies, which tests them against the frustum,
+// picks a level with the same hysteresis as InstancedRenderer and appends
+// their indices to the level's run while counting instances in the indirect
+// commands. All levels then go out in one glMultiDrawElementsIndirect and the
+// sub-pixel bodies in one glDrawArraysIndirect, so the CPU work per frame does
+// not grow with the number of bodies. Programs are gpuVertexShader.glsl and
+// gpuPointVertexShader.glsl with the usual fragment shaders.
+class GpuDrivenRenderer
+{
+public:
+    static const int MAX_LEVELS = 16;         // size of levelSectors in the compute shader
+    static const unsigned int GROUP_SIZE = 64; // local_size_x of the compute shader
+
+    // GL 4.3 with storage buffers readable from vertex shaders
+    static bool isSupported();
+
+    // arena must be packed and outlive the renderer
+    GpuDrivenRenderer(MeshArena &arena, const Shader &cullShader, int minSectors = 8, int maxSectors = 256);
+    ~GpuDrivenRenderer();
+
+    // returns the body index, also its hysteresis slot
+    unsigned int addBody(const glm::mat4 &model, int textureLayer, unsigned int flags = 0);
+    unsigned int addBody(const Planet &planet, unsigned int flags = 0);
+    void setBody(unsigned int body, const glm::mat4 &model);
+    void setBody(unsigned int body, const Planet &planet);
+    // models of the first getBodyCount() bodies of the store, added in store order
+    void setBodies(const BodyStore &store);
+    void clear();
+
+    void setView(const glm::vec3 &cameraPos, const glm::mat4 &view, const glm::mat4 &projection, int viewportHeight);
+    void draw(unsigned int shaderProgram, unsigned int pointProgram, const TextureArray &textures);
+
+    // instances per level of the last draw(), the last entry is the point bucket;
+    // reads the commands back, so it waits for the GPU
+    void readLevelCounts(std::vector<unsigned int> &counts) const;
+
+    unsigned int getBodyCount() const
+    {
+        return (unsigned int)bodies.size();
+    };
+    int getLevelCount() const
+    {
+        return lod.getLevelCount();
+    };
+
+    float pixelsPerEdge = 6.0f; // same meaning as in InstancedRenderer
+    float pointRadius = 0.5f;
+    float hysteresis = 1.25f;
+
+private:
+    MeshArena &arena;
+    SphereLod lod;
+    std::vector<MeshRange> levelMeshes;
+    unsigned int vertexArray = 0; // arena VAO with the visible index as attribute 3
+
+    unsigned int cullProgram;
+    Uniform bodyCountUniform;
+    Uniform regionSizeUniform;
+    Uniform frustumPlanesUniform;
+    Uniform cameraPosUniform;
+    Uniform pixelScaleUniform;
+    Uniform pixelsPerEdgeUniform;
+    Uniform pointRadiusUniform;
+    Uniform hysteresisUniform;
+    Uniform levelCountUniform;
+    Uniform levelSectorsUniform;
+
+    unsigned int bodyBuffer = 0;      // GpuBody per body, binding 0
+    unsigned int lastLevelBuffer = 0; // int per body, binding 1
+    unsigned int commandBuffer = 0;   // binding 2 and GL_DRAW_INDIRECT_BUFFER
+    unsigned int visibleBuffer = 0;   // binding 3 and attribute 3
+    unsigned int capacity = 0;        // bodies the buffers hold, also the run length per level
+
+    std::vector<GpuBody> bodies;
+    std::size_t dirtyFirst = 0; // bodies [dirtyFirst, dirtyEnd) need uploading
+    std::size_t dirtyEnd = 0;
+    std::vector<unsigned int> commands; // counts reset to 0, uploaded before every dispatch
+
+    Frustum frustum;
+    glm::vec3 cameraPos = glm::vec3(0.0f);
+    float pixelScale = 0.0f;
+
+    void markDirty(std::size_t body);
+    void reserve(unsigned int bodyCount);
+    void uploadBodies();
+};
+
+#endif
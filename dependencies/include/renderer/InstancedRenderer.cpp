@@ -0,0 +1,253 @@
+#include "InstancedRenderer.h"
+#include <planet/Planet.h>
+#include <planet/OrbitKernel.h>
+#include <cstddef>
+#include <cfloat>
+#include <iostream>
+
+namespace
+{
+    const int UNKNOWN_LEVEL = -2; // lastLevels entry of a body never drawn
+}
+
+InstancedRenderer::InstancedRenderer(MeshArena &arena, int minSectors, int maxSectors)
+    : arena(arena), lod(minSectors, maxSectors, true)
+{
+    levelCounts.assign(lod.getLevelCount() + 1, 0);
+    if (!arena.isPacked())
+        std::cerr << "InstancedRenderer: the mesh arena must use the packed vertex format" << std::endl;
+
+    // each level becomes its own mesh in the arena
+    const unsigned char *vertices = (const unsigned char *)lod.getVertexData();
+    const unsigned char *indices = (const unsigned char *)lod.getIndexData();
+    for (int l = 0; l < lod.getLevelCount(); ++l)
+    {
+        const SphereLevel &level = lod.getLevel(l);
+        levelMeshes.push_back(arena.add(vertices + (std::size_t)level.baseVertex * lod.getInterleavedStride(), level.vertexCount,
+                                        indices + (std::size_t)level.firstIndex * lod.getIndexTypeSize(), level.indexCount, lod.getIndexType()));
+    }
+
+    // the instance attributes sit on the arena VAO next to the mesh attributes;
+    // the buffer is never empty so other arena meshes can be drawn without instancing
+    glGenBuffers(1, &instanceVBO);
+    arena.bind();
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    instanceCapacity = 64;
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+    enableInstanceAttribs();
+
+    // no mesh attributes are enabled, so nothing is fetched per vertex
+    glGenVertexArrays(1, &proceduralVAO);
+    glBindVertexArray(proceduralVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    enableInstanceAttribs();
+
+    glBindVertexArray(0);
+}
+InstancedRenderer::~InstancedRenderer()
+{
+    for (std::size_t l = 0; l < levelMeshes.size(); ++l)
+        arena.remove(levelMeshes[l]);
+    glDeleteBuffers(1, &instanceVBO);
+    glDeleteVertexArrays(1, &proceduralVAO);
+}
+void InstancedRenderer::setProceduralShader(const Shader &shader)
+{
+    proceduralProgram = shader.ID;
+    sectorCountUniform = shader.getUniform(uniformHash("sectorCount"));
+    stackCountUniform = shader.getUniform(uniformHash("stackCount"));
+}
+void InstancedRenderer::setImpostorShader(const Shader &shader)
+{
+    impostorProgram = shader.ID;
+}
+void InstancedRenderer::setMode(SphereMode newMode)
+{
+    if ((newMode == SPHERE_PROCEDURAL && proceduralProgram == 0) || (newMode == SPHERE_IMPOSTOR && impostorProgram == 0))
+        newMode = SPHERE_MESH;
+    mode = newMode;
+}
+void InstancedRenderer::setView(const glm::vec3 &position, const glm::mat4 &projection, int viewportHeight)
+{
+    cameraPos = position;
+    // projection[1][1] = 1 / tan(fovy / 2)
+    pixelScale = projection[1][1] * viewportHeight * 0.5f;
+}
+void InstancedRenderer::begin()
+{
+    instances.clear();
+    instanceLevels.clear();
+}
+void InstancedRenderer::add(const glm::mat4 &model, int textureLayer, unsigned int flags, unsigned int id)
+{
+    InstanceData instance;
+    instance.model = model;
+    instance.textureLayer = (float)textureLayer;
+    instance.flags = flags;
+    instance.padding[0] = instance.padding[1] = 0.0f;
+    instances.push_back(instance);
+    instanceLevels.push_back((unsigned char)selectLevel(model, id));
+}
+void InstancedRenderer::add(const Planet &planet, unsigned int id, unsigned int flags)
+{
+    // the shared mesh has unit radius, so the body radius goes into the model matrix
+    glm::mat4 model = glm::scale(planet.getModelMatrix(), glm::vec3(planet.getRadius()));
+    add(model, planet.getTextureLayer(), flags, id);
+}
+void InstancedRenderer::add(const BodyStore &bodies, const unsigned int *indices, std::size_t count, unsigned int flags)
+{
+    if (count == 0)
+        return;
+    std::size_t first = instances.size();
+    instances.resize(first + count);
+    OrbitKernel::writeModels(bodies, indices, count, &instances[first].model[0][0], sizeof(InstanceData));
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        unsigned int body = indices ? indices[i] : (unsigned int)i;
+        InstanceData &instance = instances[first + i];
+        instance.textureLayer = (float)bodies.textureLayer[body];
+        instance.flags = flags;
+        instance.padding[0] = instance.padding[1] = 0.0f;
+        instanceLevels.push_back((unsigned char)selectLevel(instance.model, body));
+    }
+}
+float InstancedRenderer::getScreenRadius(const Planet &planet) const
+{
+    float radius = planet.getBoundingRadius();
+    float distance = glm::length(planet.getPlanetPosi() - cameraPos);
+    return distance > radius ? radius / distance * pixelScale : FLT_MAX;
+}
+// returns a mesh level, or getLevelCount() for a point
+int InstancedRenderer::selectLevel(const glm::mat4 &model, unsigned int id)
+{
+    const int pointLevel = lod.getLevelCount();
+
+    // uniform scale, so the length of any basis column is the world radius
+    float radius = glm::length(glm::vec3(model[0]));
+    float distance = glm::length(glm::vec3(model[3]) - cameraPos);
+    if (distance <= radius)
+        return pointLevel - 1;
+    float screenRadius = radius / distance * pixelScale;
+
+    // finer level when growing, coarser only once the body is clearly smaller
+    int up = screenRadius < pointRadius ? pointLevel : lod.selectLevel(screenRadius, pixelsPerEdge);
+    float shrunk = screenRadius * hysteresis;
+    int down = shrunk < pointRadius ? pointLevel : lod.selectLevel(shrunk, pixelsPerEdge);
+    // the point bucket is the coarsest, so compare with it mapped below level 0
+    int rankUp = up == pointLevel ? -1 : up;
+    int rankDown = down == pointLevel ? -1 : down;
+
+    if (id == NO_ID)
+        return up;
+    if (id >= lastLevels.size())
+        lastLevels.resize(id + 1, UNKNOWN_LEVEL);
+
+    int last = lastLevels[id]; // -1 is the point level
+    int rank = rankUp;
+    if (last != UNKNOWN_LEVEL && rankUp <= last)
+        rank = rankDown < last ? rankDown : last; // inside the band the previous level is kept
+    lastLevels[id] = (signed char)rank;
+    return rank < 0 ? pointLevel : rank;
+}
+void InstancedRenderer::draw(unsigned int shaderProgram, unsigned int pointProgram, const TextureArray &textures)
+{
+    drawCalls = 0;
+    for (std::size_t i = 0; i < levelCounts.size(); ++i)
+        levelCounts[i] = 0;
+    if (instances.empty())
+        return;
+
+    // counting sort by level so each level is one contiguous run of instances
+    for (std::size_t i = 0; i < instanceLevels.size(); ++i)
+        ++levelCounts[instanceLevels[i]];
+    levelStarts.assign(levelCounts.size(), 0);
+    for (std::size_t l = 1; l < levelCounts.size(); ++l)
+        levelStarts[l] = levelStarts[l - 1] + levelCounts[l - 1];
+    sorted.resize(instances.size());
+    for (std::size_t i = 0; i < instances.size(); ++i)
+        sorted[levelStarts[instanceLevels[i]]++] = instances[i];
+
+    // orphan the old storage so the driver does not wait on the previous frame
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (sorted.size() > instanceCapacity)
+        instanceCapacity = sorted.size() > instanceCapacity * 2 ? sorted.size() : instanceCapacity * 2;
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(InstanceData), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sorted.size() * sizeof(InstanceData), sorted.data());
+
+    textures.bind(0);
+    bool procedural = mode == SPHERE_PROCEDURAL;
+    if (mode == SPHERE_MESH)
+        arena.bind();
+    else
+        glBindVertexArray(proceduralVAO);
+
+    std::size_t first = 0;
+    if (mode == SPHERE_IMPOSTOR)
+    {
+        // the quad does not depend on the level, so every non-point body is one run
+        first = sorted.size() - levelCounts[lod.getLevelCount()];
+        if (first)
+        {
+            glUseProgram(impostorProgram);
+            setInstanceAttribs(0);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)first);
+            ++drawCalls;
+        }
+    }
+    else
+    {
+        glUseProgram(procedural ? proceduralProgram : shaderProgram);
+        for (int l = 0; l < lod.getLevelCount(); ++l)
+        {
+            if (levelCounts[l] == 0)
+                continue;
+            const SphereLevel &level = lod.getLevel(l);
+            setInstanceAttribs(first);
+            if (procedural)
+            {
+                glUniform1i(sectorCountUniform.location, level.sectorCount);
+                glUniform1i(stackCountUniform.location, level.stackCount);
+                glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)Sphere::getProceduralVertexCount(level.sectorCount, level.stackCount), (GLsizei)levelCounts[l]);
+            }
+            else
+            {
+                arena.drawInstanced(levelMeshes[l], levelCounts[l]);
+            }
+            ++drawCalls;
+            first += levelCounts[l];
+        }
+    }
+
+    // sub-pixel bodies: one point per instance, positioned by the point shader
+    unsigned int points = levelCounts[lod.getLevelCount()];
+    if (points)
+    {
+        glUseProgram(pointProgram);
+        setInstanceAttribs(first);
+        glDrawArraysInstanced(GL_POINTS, 0, 1, (GLsizei)points);
+        ++drawCalls;
+    }
+
+    setInstanceAttribs(0);
+    glBindVertexArray(0);
+}
+void InstancedRenderer::setInstanceAttribs(std::size_t firstInstance)
+{
+    // GL 3.3 has no base instance, so a run of instances is selected by offsetting the attribute pointers
+    // expects instanceVBO bound to GL_ARRAY_BUFFER and the arena or procedural VAO bound
+    const GLsizei stride = sizeof(InstanceData);
+    std::size_t base = firstInstance * sizeof(InstanceData);
+    for (int i = 0; i < 4; ++i)
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(InstanceData, model) + i * sizeof(glm::vec4)));
+    glVertexAttribPointer(7, 1, GL_FLOAT, GL_FALSE, stride, (void *)(base + offsetof(InstanceData, textureLayer)));
+    glVertexAttribIPointer(8, 1, GL_UNSIGNED_INT, stride, (void *)(base + offsetof(InstanceData, flags)));
+}
+void InstancedRenderer::enableInstanceAttribs()
+{
+    setInstanceAttribs(0);
+    for (int i = 0; i < 6; ++i)
+    {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribDivisor(3 + i, 1);
+    }
+}
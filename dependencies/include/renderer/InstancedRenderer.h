@@ -0,0 +1,132 @@
+#ifndef INSTANCED_RENDERER_H
+#define INSTANCED_RENDERER_H
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <Sphere/SphereLod.h>
+#include <renderer/MeshArena.h>
+#include <renderer/TextureArray.h>
+#include <shadersPrograms/shader.h>
+#include <vector>
+
+class Planet;
+struct BodyStore;
+
+// shading flags stored per instance
+enum InstanceFlags
+{
+    INSTANCE_UNLIT = 1 // skip lighting, output the texture colour (emissive bodies)
+};
+
+// how the bodies that are not points are drawn
+enum SphereMode
+{
+    SPHERE_MESH,       // shared LOD meshes
+    SPHERE_PROCEDURAL, // LOD meshes rebuilt from gl_VertexID, no vertex buffers
+    SPHERE_IMPOSTOR,   // one quad per body, ray traced in the fragment shader
+    SPHERE_MODE_COUNT
+};
+
+// per-instance attributes, laid out as vertex attributes 3..8
+struct InstanceData
+{
+    glm::mat4 model;    // locations 3,4,5,6
+    float textureLayer; // location 7
+    unsigned int flags; // location 8
+    float padding[2];
+};
+
+// Draws every body through one shared chain of unit-radius sphere meshes.
+// The levels are meshes in a MeshArena, whose VAO also carries the instance
+// attributes. Bodies are collected between begin() and draw(). Each one gets a
+// level of detail from its projected screen radius, and every level is
+// submitted with a single glDrawElementsInstancedBaseVertex; bodies smaller than a pixel are
+// drawn as points. Textures come from one TextureArray. In procedural mode the
+// mesh buffers are skipped and proceduralVertexShader.glsl builds each level's
+// vertices from gl_VertexID instead; in impostor mode every body is a single
+// quad and all of them go out in one draw, whatever their level.
+class InstancedRenderer
+{
+public:
+    static const unsigned int NO_ID = 0xffffffff; // body without level history (no hysteresis)
+
+    // arena must be packed and outlive the renderer
+    InstancedRenderer(MeshArena &arena, int minSectors = 8, int maxSectors = 256);
+    ~InstancedRenderer();
+
+    // camera used for level selection, call before add()
+    void setView(const glm::vec3 &cameraPos, const glm::mat4 &projection, int viewportHeight);
+
+    void begin();
+    // id must be stable across frames for the level hysteresis to apply
+    void add(const glm::mat4 &model, int textureLayer, unsigned int flags = 0, unsigned int id = NO_ID);
+    void add(const Planet &planet, unsigned int id = NO_ID, unsigned int flags = 0);
+    // bodies indices[0..count) of the store, or the first count when indices is NULL, their
+    // index as id; models come from OrbitKernel::writeModels()
+    void add(const BodyStore &bodies, const unsigned int *indices, std::size_t count, unsigned int flags = 0);
+    void draw(unsigned int shaderProgram, unsigned int pointProgram, const TextureArray &textures);
+    // radius in pixels of the body's bounding sphere after setView(), FLT_MAX with the camera inside
+    float getScreenRadius(const Planet &planet) const;
+
+    // programs used instead of shaderProgram in the other modes
+    void setProceduralShader(const Shader &shader);
+    void setImpostorShader(const Shader &shader);
+    // falls back to SPHERE_MESH when the mode has no program
+    void setMode(SphereMode mode);
+    SphereMode getMode() const
+    {
+        return mode;
+    };
+
+    unsigned int getInstanceCount() const
+    {
+        return (unsigned int)instances.size();
+    };
+    unsigned int getDrawCallCount() const
+    {
+        return drawCalls;
+    };
+    // instances drawn at a level in the last draw(), getLevelCount() is the point bucket
+    unsigned int getLevelInstanceCount(int level) const
+    {
+        return levelCounts[level];
+    };
+    int getLevelCount() const
+    {
+        return lod.getLevelCount();
+    };
+
+    float pixelsPerEdge = 6.0f;   // target tessellation density on screen
+    float pointRadius = 0.5f;     // screen radius in pixels below which bodies become points
+    float hysteresis = 1.25f;     // a body only drops a level once it is this much smaller
+
+private:
+    MeshArena &arena;
+    SphereLod lod;
+    std::vector<MeshRange> levelMeshes;
+    unsigned int instanceVBO = 0;
+    unsigned int proceduralVAO = 0; // instance attributes only
+    std::size_t instanceCapacity = 0;
+    unsigned int drawCalls = 0;
+
+    SphereMode mode = SPHERE_MESH;
+    unsigned int proceduralProgram = 0;
+    unsigned int impostorProgram = 0;
+    Uniform sectorCountUniform;
+    Uniform stackCountUniform;
+
+    glm::vec3 cameraPos = glm::vec3(0.0f);
+    float pixelScale = 0.0f; // screen radius in pixels = world radius / distance * pixelScale
+
+    std::vector<InstanceData> instances;
+    std::vector<unsigned char> instanceLevels;
+    std::vector<signed char> lastLevels; // per id, -2 when unknown, -1 at the point level
+    std::vector<InstanceData> sorted;    // instances grouped by level
+    std::vector<unsigned int> levelCounts;
+    std::vector<unsigned int> levelStarts;
+
+    int selectLevel(const glm::mat4 &model, unsigned int id);
+    void setInstanceAttribs(std::size_t firstInstance);
+    void enableInstanceAttribs();
+};
+
+#endif
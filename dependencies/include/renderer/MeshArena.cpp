@@ -0,0 +1,239 @@
+#include "MeshArena.h"
+#include <Sphere/Sphere.h>
+#include <iostream>
+
+MeshArena::MeshArena(bool packed, unsigned int indexType, unsigned int vertexCapacity, unsigned int indexCapacity)
+    : packed(packed), stride(packed ? 16 : 32), indexType(indexType), vertexCapacity(vertexCapacity), indexCapacity(indexCapacity)
+{
+    if (this->vertexCapacity == 0)
+        this->vertexCapacity = 1;
+    if (this->indexCapacity == 0)
+        this->indexCapacity = 1;
+
+    glGenVertexArrays(1, &VAO);
+    vertexArrays.push_back(VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    // allocated through the copy target so no VAO state is touched
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (std::size_t)this->vertexCapacity * stride, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (std::size_t)this->indexCapacity * getIndexTypeSize(), NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    attachBuffers();
+}
+MeshArena::~MeshArena()
+{
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays((GLsizei)vertexArrays.size(), vertexArrays.data());
+}
+MeshRange MeshArena::add(const void *vertices, unsigned int vertexCount, const void *indices, unsigned int indexCount, unsigned int type)
+{
+    MeshRange mesh = {0, 0, 0, 0};
+    if (vertexCount == 0 || indexCount == 0)
+        return mesh;
+    if (indexType == GL_UNSIGNED_SHORT && vertexCount > 65536)
+    {
+        std::cerr << "MeshArena: " << vertexCount << " vertices do not fit 16-bit indices" << std::endl;
+        return mesh;
+    }
+
+    // the base vertex is added after the index fetch, so only the mesh's own range matters
+    const void *data = indices;
+    if (type != indexType)
+    {
+        convertedIndices.resize((std::size_t)indexCount * getIndexTypeSize());
+        if (indexType == GL_UNSIGNED_INT)
+        {
+            const unsigned short *src = (const unsigned short *)indices;
+            unsigned int *dst = (unsigned int *)convertedIndices.data();
+            for (unsigned int i = 0; i < indexCount; ++i)
+                dst[i] = src[i];
+        }
+        else
+        {
+            const unsigned int *src = (const unsigned int *)indices;
+            unsigned short *dst = (unsigned short *)convertedIndices.data();
+            for (unsigned int i = 0; i < indexCount; ++i)
+                dst[i] = (unsigned short)src[i];
+        }
+        data = convertedIndices.data();
+    }
+
+    mesh.baseVertex = allocate(freeVertices, vertexUsed, vertexCount);
+    mesh.vertexCount = vertexCount;
+    mesh.firstIndex = allocate(freeIndices, indexUsed, indexCount);
+    mesh.indexCount = indexCount;
+
+    bool grown = false;
+    if (vertexUsed > vertexCapacity)
+    {
+        unsigned int capacity = vertexCapacity * 2 > vertexUsed ? vertexCapacity * 2 : vertexUsed;
+        grow(VBO, (std::size_t)vertexCapacity * stride, (std::size_t)capacity * stride);
+        vertexCapacity = capacity;
+        grown = true;
+    }
+    if (indexUsed > indexCapacity)
+    {
+        unsigned int capacity = indexCapacity * 2 > indexUsed ? indexCapacity * 2 : indexUsed;
+        grow(EBO, (std::size_t)indexCapacity * getIndexTypeSize(), (std::size_t)capacity * getIndexTypeSize());
+        indexCapacity = capacity;
+        grown = true;
+    }
+    if (grown)
+        attachBuffers();
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (std::size_t)mesh.baseVertex * stride, (std::size_t)vertexCount * stride, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (std::size_t)mesh.firstIndex * getIndexTypeSize(), (std::size_t)indexCount * getIndexTypeSize(), data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    ++meshCount;
+    return mesh;
+}
+MeshRange MeshArena::add(const Sphere &sphere)
+{
+    MeshRange mesh = {0, 0, 0, 0};
+    if (sphere.isPacked() != packed)
+    {
+        std::cerr << "MeshArena: sphere vertex format does not match the arena" << std::endl;
+        return mesh;
+    }
+    if (!sphere.isCpuResident())
+    {
+        std::cerr << "MeshArena: sphere data was released" << std::endl;
+        return mesh;
+    }
+    return add(sphere.getVertexData(), sphere.getVertexCount(), sphere.getIndexData(), sphere.getIndexCount(), sphere.getIndexType());
+}
+void MeshArena::remove(const MeshRange &mesh)
+{
+    if (mesh.indexCount == 0)
+        return;
+    release(freeVertices, vertexUsed, mesh.baseVertex, mesh.vertexCount);
+    release(freeIndices, indexUsed, mesh.firstIndex, mesh.indexCount);
+    --meshCount;
+}
+unsigned int MeshArena::createVertexArray()
+{
+    unsigned int vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    vertexArrays.push_back(vertexArray);
+    attachBuffers(vertexArray);
+    return vertexArray;
+}
+void MeshArena::deleteVertexArray(unsigned int vertexArray)
+{
+    for (std::size_t i = 1; i < vertexArrays.size(); ++i)
+    {
+        if (vertexArrays[i] != vertexArray)
+            continue;
+        glDeleteVertexArrays(1, &vertexArray);
+        vertexArrays.erase(vertexArrays.begin() + i);
+        return;
+    }
+}
+void MeshArena::bind() const
+{
+    glBindVertexArray(VAO);
+}
+void MeshArena::draw(const MeshRange &mesh, unsigned int primitive) const
+{
+    glDrawElementsBaseVertex(primitive, (GLsizei)mesh.indexCount, indexType,
+                             (void *)((std::size_t)mesh.firstIndex * getIndexTypeSize()), (GLint)mesh.baseVertex);
+}
+void MeshArena::drawInstanced(const MeshRange &mesh, unsigned int instanceCount, unsigned int primitive) const
+{
+    glDrawElementsInstancedBaseVertex(primitive, (GLsizei)mesh.indexCount, indexType,
+                                      (void *)((std::size_t)mesh.firstIndex * getIndexTypeSize()), (GLsizei)instanceCount, (GLint)mesh.baseVertex);
+}
+// first fit from the free list, otherwise from the end; used may pass the capacity
+unsigned int MeshArena::allocate(std::vector<FreeRange> &freeList, unsigned int &used, unsigned int count)
+{
+    for (std::size_t i = 0; i < freeList.size(); ++i)
+    {
+        if (freeList[i].count < count)
+            continue;
+        unsigned int first = freeList[i].first;
+        freeList[i].first += count;
+        freeList[i].count -= count;
+        if (freeList[i].count == 0)
+            freeList.erase(freeList.begin() + i);
+        return first;
+    }
+    unsigned int first = used;
+    used += count;
+    return first;
+}
+void MeshArena::release(std::vector<FreeRange> &freeList, unsigned int &used, unsigned int first, unsigned int count)
+{
+    std::size_t i = 0;
+    while (i < freeList.size() && freeList[i].first < first)
+        ++i;
+    FreeRange range = {first, count};
+    freeList.insert(freeList.begin() + i, range);
+
+    // merge with the next and previous neighbours
+    if (i + 1 < freeList.size() && freeList[i].first + freeList[i].count == freeList[i + 1].first)
+    {
+        freeList[i].count += freeList[i + 1].count;
+        freeList.erase(freeList.begin() + i + 1);
+    }
+    if (i > 0 && freeList[i - 1].first + freeList[i - 1].count == freeList[i].first)
+    {
+        freeList[i - 1].count += freeList[i].count;
+        freeList.erase(freeList.begin() + i);
+        --i;
+    }
+    // a free range at the end just lowers the high-water mark
+    if (freeList[i].first + freeList[i].count == used)
+    {
+        used = freeList[i].first;
+        freeList.erase(freeList.begin() + i);
+    }
+}
+// new storage with the old contents copied on the GPU, the caller re-attaches it
+void MeshArena::grow(unsigned int &buffer, std::size_t usedBytes, std::size_t newBytes)
+{
+    unsigned int bigger;
+    glGenBuffers(1, &bigger);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, bigger);
+    glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    buffer = bigger;
+}
+void MeshArena::attachBuffers()
+{
+    for (std::size_t i = 0; i < vertexArrays.size(); ++i)
+        attachBuffers(vertexArrays[i]);
+}
+// points a VAO at the current buffers; other attributes set on it (instance data) are kept
+void MeshArena::attachBuffers(unsigned int vertexArray)
+{
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (packed)
+    {
+        // same layout as Sphere::upload
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (void *)0);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void *)(4 * sizeof(short)));
+        glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)(6 * sizeof(short)));
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)(3 * sizeof(float)));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void *)(6 * sizeof(float)));
+    }
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+}
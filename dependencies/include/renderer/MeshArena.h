@@ -0,0 +1,121 @@
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+#include <glad/glad.h>
+#include <cstddef>
+#include <vector>
+
+class Sphere;
+
+// a mesh inside the arena buffers, indexCount 0 when add() failed
+struct MeshRange
+{
+    unsigned int baseVertex; // added to every index of the mesh
+    unsigned int vertexCount;
+    unsigned int firstIndex; // offset into the index buffer, in indices
+    unsigned int indexCount;
+};
+
+// Sub-allocates meshes from one vertex buffer and one index buffer under a
+// single VAO. Every mesh keeps its own 0-based indices and is drawn with
+// glDrawElementsBaseVertex, so after one bind() switching meshes needs no state
+// change. The vertex format (packed 16 bytes or 32-byte V/N/T floats, see
+// Sphere) and the index type are fixed per arena. Ranges given back with
+// remove() are reused first-fit; when a buffer runs out it doubles and the old
+// contents are copied on the GPU.
+class MeshArena
+{
+public:
+    MeshArena(bool packed = true, unsigned int indexType = GL_UNSIGNED_SHORT,
+              unsigned int vertexCapacity = 65536, unsigned int indexCapacity = 262144);
+    ~MeshArena();
+
+    // indices are converted to the arena type; a 16-bit arena rejects meshes
+    // that address more than 65536 vertices
+    MeshRange add(const void *vertices, unsigned int vertexCount, const void *indices, unsigned int indexCount, unsigned int indexType);
+    // the sphere must be in the arena's vertex format
+    MeshRange add(const Sphere &sphere);
+    void remove(const MeshRange &mesh);
+
+    // further VAOs over the arena buffers, for callers that add their own
+    // instance attributes; the arena keeps their mesh attributes current
+    unsigned int createVertexArray();
+    void deleteVertexArray(unsigned int vertexArray);
+
+    // bind once, then draw any number of meshes
+    void bind() const;
+    void draw(const MeshRange &mesh, unsigned int primitive = GL_TRIANGLES) const;
+    void drawInstanced(const MeshRange &mesh, unsigned int instanceCount, unsigned int primitive = GL_TRIANGLES) const;
+
+    bool isPacked() const
+    {
+        return packed;
+    };
+    int getStride() const
+    {
+        return stride;
+    };
+    unsigned int getIndexType() const
+    {
+        return indexType;
+    };
+    unsigned int getIndexTypeSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    };
+    unsigned int getVAO() const
+    {
+        return VAO;
+    };
+    unsigned int getMeshCount() const
+    {
+        return meshCount;
+    };
+    // high-water marks and allocated sizes, in vertices and indices
+    unsigned int getVertexCount() const
+    {
+        return vertexUsed;
+    };
+    unsigned int getIndexCount() const
+    {
+        return indexUsed;
+    };
+    unsigned int getVertexCapacity() const
+    {
+        return vertexCapacity;
+    };
+    unsigned int getIndexCapacity() const
+    {
+        return indexCapacity;
+    };
+
+private:
+    struct FreeRange
+    {
+        unsigned int first;
+        unsigned int count;
+    };
+
+    bool packed;
+    int stride;
+    unsigned int indexType;
+    unsigned int VAO = 0;
+    unsigned int VBO = 0;
+    unsigned int EBO = 0;
+    unsigned int vertexCapacity;
+    unsigned int indexCapacity;
+    unsigned int vertexUsed = 0;
+    unsigned int indexUsed = 0;
+    unsigned int meshCount = 0;
+    std::vector<FreeRange> freeVertices; // sorted, never adjacent
+    std::vector<FreeRange> freeIndices;
+    std::vector<unsigned int> vertexArrays; // VAO first, then createVertexArray()
+    std::vector<unsigned char> convertedIndices;
+
+    static unsigned int allocate(std::vector<FreeRange> &freeList, unsigned int &used, unsigned int count);
+    static void release(std::vector<FreeRange> &freeList, unsigned int &used, unsigned int first, unsigned int count);
+    static void grow(unsigned int &buffer, std::size_t usedBytes, std::size_t newBytes);
+    void attachBuffers();
+    void attachBuffers(unsigned int vertexArray);
+};
+
+#endif
@@ -0,0 +1,460 @@
+#include "TextureArray.h"
+#include <iostream>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+namespace
+{
+    float packColor(int r, int g, int b)
+    {
+        return (float)(r * 65536 + g * 256 + b);
+    }
+}
+
+TextureArray::TextureArray(int width, int height, int loaderThreads, const std::string &cacheDirectory)
+    : width(width), height(height), levels(TextureLoader::getMipLevelCount(width, height)),
+      compressed(!cacheDirectory.empty() && isCompressionSupported()),
+      loader(loaderThreads, compressed ? cacheDirectory : std::string())
+{
+    for (int i = 0; i < RING_SIZE; ++i)
+        fences[i] = 0;
+    while (tailLevel < levels - 1 && (width >> tailLevel) > TAIL_WIDTH)
+        ++tailLevel;
+}
+TextureArray::~TextureArray()
+{
+    for (int i = 0; i < RING_SIZE; ++i)
+        if (fences[i])
+            glDeleteSync(fences[i]);
+    if (mapped)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &PBO);
+    glDeleteBuffers(1, &residencyUBO);
+    glDeleteTextures(1, &textureID);
+}
+int TextureArray::addLayer(const std::string &path)
+{
+    std::unordered_map<std::string, int>::const_iterator it = layers.find(path);
+    if (it != layers.end())
+    {
+        ++layerStates[it->second].references;
+        ++stats.shared;
+        return it->second;
+    }
+    if (layerCount >= MAX_LAYERS)
+    {
+        std::cerr << "Too many textures, not loading: " << path << std::endl;
+        return -1;
+    }
+
+    LayerState state;
+    state.path = path;
+    state.references = 1;
+    state.slot = -1;
+    state.residentLevel = levels;
+    state.screenRadius = FLT_MAX;
+    state.nextScreenRadius = -1.0f;
+    state.lastUsed = frame;
+    state.loading = false;
+    state.loadingFirst = false;
+    state.stale = false;
+    state.averageColor = packColor(128, 128, 128);
+    layerStates.push_back(state);
+    layers[path] = layerCount;
+
+    // decoding starts right away, a layer left without a slot still gets its average colour
+    requestFirstLoad(layerCount);
+    return layerCount++;
+}
+void TextureArray::releaseLayer(int layer)
+{
+    if (layer >= 0 && layer < layerCount && layerStates[layer].references > 0)
+        --layerStates[layer].references;
+}
+void TextureArray::build()
+{
+    GLint maxSlots = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxSlots);
+    slotCount = layerCount > 0 ? layerCount : 1;
+    if (memoryBudget > 0)
+        slotCount = (int)std::max<std::size_t>(memoryBudget / getLayerSize(), 1);
+    slotCount = std::min(slotCount, (int)maxSlots);
+
+    if (textureID)
+        glDeleteTextures(1, &textureID);
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    // left undefined, the shaders only sample levels a slot's layer has uploaded
+    int w = width, h = height;
+    for (int level = 0; level < levels; ++level)
+    {
+        if (compressed)
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, w, h, slotCount, 0,
+                                   (GLsizei)(TextureCache::getLevelSize(w, h) * slotCount), NULL);
+        else
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGB8, w, h, slotCount, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+
+    // slots go to the referenced layers in the order they were added, the rest wait for update()
+    slotLayers.assign(slotCount, -1);
+    int nextSlot = 0;
+    for (int layer = 0; layer < layerCount; ++layer)
+    {
+        LayerState &state = layerStates[layer];
+        if (state.loading && !state.loadingFirst)
+            state.stale = true;
+        state.slot = -1;
+        state.residentLevel = levels;
+        if (state.references > 0 && nextSlot < slotCount)
+        {
+            state.slot = nextSlot;
+            slotLayers[nextSlot++] = layer;
+        }
+    }
+
+    if (!PBO)
+    {
+        ringEntrySize = getLayerSize();
+        glGenBuffers(1, &PBO);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        if (GLAD_GL_VERSION_4_4)
+        {
+            // coherent, so a memcpy is all an entry needs before the upload
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, ringEntrySize * RING_SIZE, NULL, flags);
+            mapped = (unsigned char *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, ringEntrySize * RING_SIZE, flags);
+        }
+        else
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, ringEntrySize * RING_SIZE, NULL, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    if (!residencyUBO)
+    {
+        glGenBuffers(1, &residencyUBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, residencyUBO);
+        glBufferData(GL_UNIFORM_BUFFER, MAX_LAYERS * 4 * sizeof(float), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    residencyDirty = true;
+
+    // maps decoded while the other bodies were set up go in right away
+    update(layerCount);
+}
+int TextureArray::update(int maxUploads)
+{
+    if (!textureID)
+        return 0;
+    int uploaded = 0;
+    DecodedImage image;
+    while (uploaded < maxUploads && loader.poll(image))
+    {
+        receive(image);
+        ++uploaded;
+    }
+
+    for (int layer = 0; layer < layerCount; ++layer)
+    {
+        LayerState &state = layerStates[layer];
+        if (state.nextScreenRadius >= 0.0f)
+        {
+            state.screenRadius = state.nextScreenRadius;
+            state.nextScreenRadius = -1.0f;
+        }
+    }
+    assignSlots();
+    requestLoads();
+    if (residencyDirty)
+        uploadResidency();
+    ++frame;
+    return uploaded;
+}
+void TextureArray::finish()
+{
+    while (pendingLayers > 0 || detailRequests > 0)
+    {
+        if (update(layerCount) == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+void TextureArray::requestDetail(int layer, float screenRadius)
+{
+    if (layer < 0 || layer >= layerCount)
+        return;
+    LayerState &state = layerStates[layer];
+    state.lastUsed = frame;
+    if (screenRadius > state.nextScreenRadius)
+        state.nextScreenRadius = screenRadius;
+}
+void TextureArray::receive(const DecodedImage &image)
+{
+    LayerState &state = layerStates[image.id];
+    if (!image.loaded)
+        std::cerr << "Failed to load texture: " << image.path << std::endl;
+    if (state.loadingFirst)
+        --pendingLayers;
+    else
+        --detailRequests;
+    state.loading = false;
+    state.loadingFirst = false;
+
+    // the coarsest level is the 1x1 average of the map, first in a BC1 range and last in an RGB chain
+    if (image.lastLevel == levels - 1)
+    {
+        unsigned char rgb[3];
+        if (image.compressed)
+            TextureCache::getFirstTexel(image.pixels.data(), rgb);
+        else
+            std::memcpy(rgb, image.pixels.data() + image.pixels.size() - 3, 3);
+        state.averageColor = packColor(rgb[0], rgb[1], rgb[2]);
+        residencyDirty = true;
+    }
+
+    if (state.stale)
+    {
+        state.stale = false;
+        return;
+    }
+    if (state.slot < 0)
+        return;
+    upload(image, state.slot);
+    state.residentLevel = std::min(state.residentLevel, image.firstLevel);
+    residencyDirty = true;
+}
+void TextureArray::assignSlots()
+{
+    // layers used this frame and big enough on screen to need a slot, largest first
+    std::vector<int> waiting;
+    for (int layer = 0; layer < layerCount; ++layer)
+    {
+        const LayerState &state = layerStates[layer];
+        if (state.references == 0 || state.lastUsed != frame || state.screenRadius < minSlotRadius)
+            continue;
+        if (state.slot >= 0)
+            ++stats.hits;
+        else
+            waiting.push_back(layer);
+    }
+    std::sort(waiting.begin(), waiting.end(), [this](int a, int b)
+              { return layerStates[a].screenRadius > layerStates[b].screenRadius; });
+
+    for (std::size_t i = 0; i < waiting.size(); ++i)
+    {
+        int slot = findSlot();
+        if (slot < 0)
+            return;
+        int owner = slotLayers[slot];
+        if (owner >= 0)
+        {
+            LayerState &evicted = layerStates[owner];
+            if (evicted.loading && !evicted.loadingFirst)
+                evicted.stale = true;
+            evicted.slot = -1;
+            evicted.residentLevel = levels;
+            ++stats.evictions;
+        }
+        LayerState &state = layerStates[waiting[i]];
+        state.slot = slot;
+        state.residentLevel = levels;
+        slotLayers[slot] = waiting[i];
+        ++stats.misses;
+        residencyDirty = true;
+    }
+}
+int TextureArray::findSlot() const
+{
+    // a free slot, else the one whose layer is needed least: unreferenced, then not
+    // used this frame, then too small on screen, the least recently used first
+    int best = -1, bestRank = 0;
+    unsigned int bestUsed = 0;
+    for (int slot = 0; slot < slotCount; ++slot)
+    {
+        int owner = slotLayers[slot];
+        if (owner < 0)
+            return slot;
+        const LayerState &state = layerStates[owner];
+        int rank = state.references == 0 ? 0 : (state.lastUsed != frame ? 1 : (state.screenRadius < minSlotRadius ? 2 : 3));
+        if (rank == 3)
+            continue;
+        if (best < 0 || rank < bestRank || (rank == bestRank && state.lastUsed < bestUsed))
+        {
+            best = slot;
+            bestRank = rank;
+            bestUsed = state.lastUsed;
+        }
+    }
+    return best;
+}
+void TextureArray::requestFirstLoad(int layer)
+{
+    // streamed layers start with their tail, the rest of the levels follow in update()
+    LayerState &state = layerStates[layer];
+    loader.request(layer, state.path, width, height, compressed ? tailLevel : 0);
+    state.loading = true;
+    state.loadingFirst = true;
+    ++pendingLayers;
+}
+void TextureArray::requestLoads()
+{
+    // a slot handed over since the last update needs its layer's first load again
+    for (int layer = 0; layer < layerCount; ++layer)
+    {
+        const LayerState &state = layerStates[layer];
+        if (state.slot >= 0 && !state.loading && state.residentLevel >= levels)
+            requestFirstLoad(layer);
+    }
+
+    // then finer levels, one at a time, for the layers that cover the most screen first
+    while (detailRequests < MAX_DETAIL_REQUESTS)
+    {
+        int best = -1;
+        for (int layer = 0; layer < layerCount; ++layer)
+        {
+            const LayerState &state = layerStates[layer];
+            if (state.slot < 0 || state.loading || state.residentLevel >= levels || state.residentLevel <= getWantedLevel(layer))
+                continue;
+            if (best < 0 || state.screenRadius > layerStates[best].screenRadius)
+                best = layer;
+        }
+        if (best < 0)
+            return;
+        LayerState &state = layerStates[best];
+        int level = state.residentLevel - 1;
+        loader.request(best, state.path, width, height, level, level);
+        state.loading = true;
+        ++detailRequests;
+    }
+}
+int TextureArray::getWantedLevel(int layer) const
+{
+    float radius = layerStates[layer].screenRadius;
+    if (radius <= 0.0f)
+        return levels - 1;
+    // the visible half of the map spans the body's diameter on screen
+    float texelsPerPixel = width * 0.5f / (2.0f * radius);
+    int level = (int)std::floor(std::log2(texelsPerPixel));
+    return level < 0 ? 0 : (level > levels - 1 ? levels - 1 : level);
+}
+void TextureArray::uploadResidency()
+{
+    // a vec4 per layer: slot, -1 while it has nothing to show, finest level and average colour
+    std::vector<float> entries((std::size_t)layerCount * 4);
+    for (int layer = 0; layer < layerCount; ++layer)
+    {
+        const LayerState &state = layerStates[layer];
+        bool ready = state.slot >= 0 && state.residentLevel < levels;
+        entries[layer * 4 + 0] = ready ? (float)state.slot : -1.0f;
+        entries[layer * 4 + 1] = ready ? (float)state.residentLevel : 0.0f;
+        entries[layer * 4 + 2] = state.averageColor;
+        entries[layer * 4 + 3] = 0.0f;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, residencyUBO);
+    if (!entries.empty())
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, entries.size() * sizeof(float), entries.data());
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    residencyDirty = false;
+}
+void TextureArray::upload(const DecodedImage &image, int slot)
+{
+    ringEntry = (ringEntry + 1) % RING_SIZE;
+    waitForRingEntry(ringEntry);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+    std::size_t base = ringEntry * ringEntrySize;
+    if (mapped)
+    {
+        std::memcpy(mapped + base, image.pixels.data(), image.pixels.size());
+    }
+    else
+    {
+        void *dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, base, image.pixels.size(),
+                                     GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+        if (dst)
+        {
+            std::memcpy(dst, image.pixels.data(), image.pixels.size());
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+    }
+
+    // every level of the image comes from the same entry, in TextureLoader's layout
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    std::size_t offset = base;
+    for (int level = image.firstLevel; level <= image.lastLevel; ++level)
+    {
+        int w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+        if (compressed)
+        {
+            std::size_t levelOffset = TextureCache::getLevelOffset(width, height, level) - TextureCache::getLevelOffset(width, height, image.lastLevel);
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, slot, w, h, 1, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                      (GLsizei)TextureCache::getLevelSize(w, h), (void *)(base + levelOffset));
+        }
+        else
+        {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, slot, w, h, 1, GL_RGB, GL_UNSIGNED_BYTE, (void *)offset);
+            offset += (std::size_t)w * h * 3;
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    // the copy out of the entry has to finish before the entry is written again
+    fences[ringEntry] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+void TextureArray::waitForRingEntry(int index)
+{
+    if (!fences[index])
+        return;
+    // the fence is RING_SIZE uploads old, so this normally returns at once
+    while (glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED)
+        ;
+    glDeleteSync(fences[index]);
+    fences[index] = 0;
+}
+void TextureArray::bind(unsigned int unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    glBindBufferBase(GL_UNIFORM_BUFFER, RESIDENCY_BINDING, residencyUBO);
+}
+std::size_t TextureArray::getLayerSize() const
+{
+    return compressed ? TextureCache::getChainSize(width, height) : TextureLoader::getMipChainSize(width, height, 3);
+}
+std::size_t TextureArray::getMemorySize() const
+{
+    if (slotCount > 0)
+        return getLayerSize() * slotCount;
+    return getLayerSize() * (layerCount > 0 ? layerCount : 1);
+}
+bool TextureArray::isCompressionSupported()
+{
+    // S3TC never made it into core, but every desktop driver exposes it
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i)
+    {
+        const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (name && std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,202 @@
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+#include <glad/glad.h>
+#include <renderer/TextureLoader.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+// counters since the last resetStats()
+struct TextureStats
+{
+    unsigned int shared;    // addLayer() calls answered with an existing layer
+    unsigned int hits;      // layers a frame used that already had their slot
+    unsigned int misses;    // layers a frame used that had to be given a slot and loaded
+    unsigned int evictions; // slots taken from another layer for that
+};
+
+// Packs planet maps into one GL_TEXTURE_2D_ARRAY.
+// addLayer() only queues the image on a TextureLoader; the workers decode it,
+// resample it to the common size and build its mip chain. build() allocates
+// the array, and update(), once per frame, streams finished maps through a
+// ring of pixel buffers (persistently mapped on GL 4.4) with a fence per entry,
+// so bodies draw at once and sharpen as their maps arrive.
+// Shaders pick the layer per instance, so a frame needs a single texture bind.
+// Given a cache directory and EXT_texture_compression_s3tc, layers are stored as
+// BC1 from TextureCache, at an eighth of the memory the RGB8 layers take.
+// Compressed layers then stream progressively: a layer is usable as soon as
+// its small mips (TAIL_WIDTH and below) are in, and finer levels are read one at
+// a time, largest bodies on screen first, up to what each body actually shows.
+//
+// Layers are shared and counted: addLayer() hands out one layer per path and
+// releaseLayer() drops a reference. The array itself only has as many slots as
+// the memory budget pays for. A layer holds a slot while its bodies are used and
+// at least minSlotRadius pixels across; when one needs a slot and none is free,
+// the least recently used layer gives its slot up. A layer without a slot is
+// drawn in the average colour of its map, which is all a body a few pixels
+// across shows anyway. The shaders find each layer's slot, finest streamed-in
+// level and average colour in the TextureResidency uniform block, and clamp
+// their LOD to that level; a texture-wide GL_TEXTURE_BASE_LEVEL would hold
+// every layer back to the slowest one.
+class TextureArray
+{
+public:
+    static const int RING_SIZE = 3;
+    static const unsigned int RESIDENCY_BINDING = 1;
+    static const int MAX_LAYERS = 1024;       // entries of the TextureResidency block
+    static const int TAIL_WIDTH = 128;        // levels this wide and smaller load with the layer
+    static const int MAX_DETAIL_REQUESTS = 2; // finer levels being read at once
+
+    // every layer shares one format, so the cache is all or nothing
+    TextureArray(int width = 1024, int height = 512, int loaderThreads = 0, const std::string &cacheDirectory = "");
+    ~TextureArray();
+
+    // returns the layer of the image, loading each path only once; -1 past MAX_LAYERS
+    int addLayer(const std::string &path);
+    // a layer nobody references is the first to lose its slot, addLayer() revives it
+    void releaseLayer(int layer);
+    // bytes of GPU memory the slots may take, 0 for a slot per layer added so far; before build()
+    void setMemoryBudget(std::size_t bytes)
+    {
+        memoryBudget = bytes;
+    };
+    // once every layer is added; later layers compete for the same slots
+    void build();
+    // uploads up to maxUploads finished maps or levels, hands out slots and
+    // queues the next loads, returns the number of uploads; needs build()
+    int update(int maxUploads = 2);
+    // blocks until every layer with a slot is uploaded down to the level it is wanted at
+    void finish();
+    // screen radius in pixels of a body drawn with the layer this frame; the largest
+    // radius since the last update() decides whether the layer keeps a slot and how
+    // fine it streams; a layer never asked about streams fully
+    void requestDetail(int layer, float screenRadius);
+    // also binds the TextureResidency block
+    void bind(unsigned int unit = 0) const;
+    // bytes of every level of every slot, as the driver is asked to store them
+    std::size_t getMemorySize() const;
+
+    static bool isCompressionSupported();
+
+    bool isLayerReady(int layer) const
+    {
+        return layerStates[layer].slot >= 0 && layerStates[layer].residentLevel < levels;
+    };
+    // finest level in the layer's slot, getLevelCount() without one
+    int getResidentLevel(int layer) const
+    {
+        return layerStates[layer].slot >= 0 ? layerStates[layer].residentLevel : levels;
+    };
+    int getSlot(int layer) const
+    {
+        return layerStates[layer].slot;
+    };
+    int getReferenceCount(int layer) const
+    {
+        return layerStates[layer].references;
+    };
+    const TextureStats &getStats() const
+    {
+        return stats;
+    };
+    void resetStats()
+    {
+        stats = TextureStats();
+    };
+    bool isCompressed() const
+    {
+        return compressed;
+    };
+    int getPendingCount() const
+    {
+        return pendingLayers;
+    };
+    unsigned int getID() const
+    {
+        return textureID;
+    };
+    int getLayerCount() const
+    {
+        return layerCount;
+    };
+    int getSlotCount() const
+    {
+        return slotCount;
+    };
+    int getLevelCount() const
+    {
+        return levels;
+    };
+    int getWidth() const
+    {
+        return width;
+    };
+    int getHeight() const
+    {
+        return height;
+    };
+
+    float minSlotRadius = 2.0f; // screen radius in pixels below which a layer does without a slot
+
+private:
+    struct LayerState
+    {
+        std::string path;
+        int references;
+        int slot;               // -1 without one
+        int residentLevel;      // finest level in the slot, levels until its first load is in
+        float screenRadius;     // what the layer streams for
+        float nextScreenRadius; // largest since the last update(), -1 when none
+        unsigned int lastUsed;  // frame of the last requestDetail()
+        bool loading;           // a request for the layer is with the loader
+        bool loadingFirst;      // that request is the first one, which also brings the average colour
+        bool stale;             // that request is a finer level for a slot the layer has lost since
+        float averageColor;     // r * 65536 + g * 256 + b, mid grey until known
+    };
+
+    unsigned int textureID = 0;
+    int width;
+    int height;
+    int levels;
+    int layerCount = 0;
+    int slotCount = 0;
+    int pendingLayers = 0; // first loads with the loader
+    int detailRequests = 0;
+    bool compressed;
+    int tailLevel = 0; // finest level of a layer's first load when streaming
+    std::size_t memoryBudget = 0;
+    unsigned int frame = 0;
+    TextureStats stats = TextureStats();
+
+    std::unordered_map<std::string, int> layers; // path -> layer
+    std::vector<LayerState> layerStates;
+    std::vector<int> slotLayers; // layer in each slot, -1 when free
+    TextureLoader loader;
+
+    unsigned int residencyUBO = 0;
+    bool residencyDirty = false;
+
+    // upload ring, room for one layer with all its levels per entry
+    unsigned int PBO = 0;
+    std::size_t ringEntrySize = 0;
+    unsigned char *mapped = NULL; // whole ring when persistently mapped
+    int ringEntry = 0;
+    GLsync fences[RING_SIZE];
+
+    void receive(const DecodedImage &image);
+    void upload(const DecodedImage &image, int slot);
+    void waitForRingEntry(int index);
+    void assignSlots();
+    int findSlot() const;
+    void requestLoads();
+    void requestFirstLoad(int layer);
+    int getWantedLevel(int layer) const;
+    void uploadResidency();
+    std::size_t getLayerSize() const;
+};
+
+#endif
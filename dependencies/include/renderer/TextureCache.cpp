@@ -0,0 +1,537 @@
+#include "TextureCache.h"
+#include "TextureLoader.h"
+#include <MappedFile/MappedFile.h>
+#include <stb_image.h>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#if defined(WIN32) || defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTURE_CACHE_SSE2
+#endif
+
+namespace
+{
+    struct CacheHeader
+    {
+        char magic[4]; // "PTC1"
+        std::uint32_t version;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t levels;
+        std::uint32_t reserved;
+        std::uint64_t sourceHash;
+    };
+
+    struct GammaTables
+    {
+        float toLinear[256];
+        unsigned char toSrgb[4096]; // indexed by linear * 4095
+
+        GammaTables()
+        {
+            for (int i = 0; i < 256; ++i)
+            {
+                float c = i / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < 4096; ++i)
+            {
+                float l = i / 4095.0f;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                toSrgb[i] = (unsigned char)(c * 255.0f + 0.5f);
+            }
+        }
+    };
+
+    const GammaTables &getGammaTables()
+    {
+        static const GammaTables tables;
+        return tables;
+    }
+
+    unsigned short toRgb565(const float *c)
+    {
+        int r = (int)(c[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(c[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(c[2] * 31.0f / 255.0f + 0.5f);
+        r = r < 0 ? 0 : (r > 31 ? 31 : r);
+        g = g < 0 ? 0 : (g > 63 ? 63 : g);
+        b = b < 0 ? 0 : (b > 31 ? 31 : b);
+        return (unsigned short)((r << 11) | (g << 5) | b);
+    }
+
+    void fromRgb565(unsigned short c, int *rgb)
+    {
+        int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+        rgb[0] = (r << 3) | (r >> 2);
+        rgb[1] = (g << 2) | (g >> 4);
+        rgb[2] = (b << 3) | (b >> 2);
+    }
+
+    // nearest of the four palette entries per texel, returns the packed indices and the total error
+    unsigned int assignIndices(const unsigned char texels[16][3], unsigned short c0, unsigned short c1, int *error)
+    {
+        int palette[4][3];
+        fromRgb565(c0, palette[0]);
+        fromRgb565(c1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        unsigned int indices = 0;
+        int total = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 4; ++p)
+            {
+                int dr = texels[i][0] - palette[p][0];
+                int dg = texels[i][1] - palette[p][1];
+                int db = texels[i][2] - palette[p][2];
+                int e = dr * dr + dg * dg + db * db;
+                if (e < bestError)
+                {
+                    bestError = e;
+                    best = p;
+                }
+            }
+            indices |= (unsigned int)best << (2 * i);
+            total += bestError;
+        }
+        *error = total;
+        return indices;
+    }
+
+    void writeBlock(unsigned char *out, unsigned short c0, unsigned short c1, unsigned int indices)
+    {
+        out[0] = (unsigned char)(c0 & 0xFF);
+        out[1] = (unsigned char)(c0 >> 8);
+        out[2] = (unsigned char)(c1 & 0xFF);
+        out[3] = (unsigned char)(c1 >> 8);
+        out[4] = (unsigned char)(indices & 0xFF);
+        out[5] = (unsigned char)((indices >> 8) & 0xFF);
+        out[6] = (unsigned char)((indices >> 16) & 0xFF);
+        out[7] = (unsigned char)(indices >> 24);
+    }
+
+    // endpoints from the principal axis of the block's colors, then one least-squares refit
+    void encodeBlock(const unsigned char texels[16][3], unsigned char *out)
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; ++i)
+            for (int c = 0; c < 3; ++c)
+                mean[c] += texels[i][c];
+        for (int c = 0; c < 3; ++c)
+            mean[c] /= 16.0f;
+
+        float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; ++i)
+        {
+            float r = texels[i][0] - mean[0], g = texels[i][1] - mean[1], b = texels[i][2] - mean[2];
+            cov[0] += r * r;
+            cov[1] += r * g;
+            cov[2] += r * b;
+            cov[3] += g * g;
+            cov[4] += g * b;
+            cov[5] += b * b;
+        }
+
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 4; ++iteration)
+        {
+            float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+            float length = std::max(std::fabs(x), std::max(std::fabs(y), std::fabs(z)));
+            if (length < 1e-6f)
+                break;
+            axis[0] = x / length;
+            axis[1] = y / length;
+            axis[2] = z / length;
+        }
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        for (int c = 0; c < 3; ++c)
+            axis[c] /= axisLength;
+
+        float minT = 0.0f, maxT = 0.0f;
+        for (int i = 0; i < 16; ++i)
+        {
+            float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+            minT = t < minT ? t : minT;
+            maxT = t > maxT ? t : maxT;
+        }
+        float end0[3], end1[3];
+        for (int c = 0; c < 3; ++c)
+        {
+            end0[c] = mean[c] + axis[c] * maxT;
+            end1[c] = mean[c] + axis[c] * minT;
+        }
+        unsigned short c0 = toRgb565(end0);
+        unsigned short c1 = toRgb565(end1);
+        int error;
+        unsigned int indices = assignIndices(texels, c0, c1, &error);
+
+        // refit both endpoints to the colors each texel picked
+        static const float weight0[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ap[3] = {0.0f, 0.0f, 0.0f}, bp[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; ++i)
+        {
+            float a = weight0[(indices >> (2 * i)) & 3], b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int c = 0; c < 3; ++c)
+            {
+                ap[c] += a * texels[i][c];
+                bp[c] += b * texels[i][c];
+            }
+        }
+        float det = aa * bb - ab * ab;
+        if (std::fabs(det) > 1e-6f)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                end0[c] = (bb * ap[c] - ab * bp[c]) / det;
+                end1[c] = (aa * bp[c] - ab * ap[c]) / det;
+            }
+            unsigned short r0 = toRgb565(end0);
+            unsigned short r1 = toRgb565(end1);
+            int refitError;
+            unsigned int refitIndices = assignIndices(texels, r0, r1, &refitError);
+            if (refitError < error)
+            {
+                c0 = r0;
+                c1 = r1;
+                indices = refitIndices;
+            }
+        }
+
+        // four-color mode needs c0 > c1; swapping exchanges indices 0<->1 and 2<->3
+        if (c0 < c1)
+        {
+            unsigned short t = c0;
+            c0 = c1;
+            c1 = t;
+            indices ^= 0x55555555u;
+        }
+        else if (c0 == c1)
+        {
+            indices = 0;
+        }
+        writeBlock(out, c0, c1, indices);
+    }
+
+    // positioned read, so workers reading levels of the same file never share a file offset
+    bool readAt(const std::string &path, std::uint64_t offset, void *dst, std::size_t size)
+    {
+#if defined(WIN32) || defined(_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD bytesRead = 0;
+        bool ok = ReadFile(file, dst, (DWORD)size, &bytesRead, &overlapped) && bytesRead == size;
+        CloseHandle(file);
+        return ok;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        unsigned char *out = (unsigned char *)dst;
+        std::size_t done = 0;
+        while (done < size)
+        {
+            ssize_t n = pread(fd, out + done, size - done, (off_t)(offset + done));
+            if (n <= 0)
+                break;
+            done += (std::size_t)n;
+        }
+        close(fd);
+        return done == size;
+#endif
+    }
+
+    bool readHeader(const std::string &path, CacheHeader &header)
+    {
+        return readAt(path, 0, &header, sizeof(header)) && std::memcmp(header.magic, "PTC1", 4) == 0 &&
+               header.version == TextureCache::VERSION;
+    }
+
+    // 2x2 average of RGBA floats; a dimension already at 1 averages the same texel twice
+    void downsample(const float *src, int width, int height, float *dst)
+    {
+        int nextWidth = width > 1 ? width / 2 : 1;
+        int nextHeight = height > 1 ? height / 2 : 1;
+#ifdef TEXTURE_CACHE_SSE2
+        const __m128 quarter = _mm_set1_ps(0.25f);
+#endif
+        for (int y = 0; y < nextHeight; ++y)
+        {
+            const float *row0 = src + (std::size_t)(height > 1 ? 2 * y : 0) * width * 4;
+            const float *row1 = src + (std::size_t)(height > 1 ? 2 * y + 1 : 0) * width * 4;
+            float *out = dst + (std::size_t)y * nextWidth * 4;
+            for (int x = 0; x < nextWidth; ++x, out += 4)
+            {
+                int x0 = (width > 1 ? 2 * x : 0) * 4;
+                int x1 = (width > 1 ? 2 * x + 1 : 0) * 4;
+#ifdef TEXTURE_CACHE_SSE2
+                __m128 top = _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1));
+                __m128 bottom = _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1));
+                _mm_storeu_ps(out, _mm_mul_ps(_mm_add_ps(top, bottom), quarter));
+#else
+                for (int c = 0; c < 4; ++c)
+                    out[c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+#endif
+            }
+        }
+    }
+}
+
+TextureCache::TextureCache(const std::string &directory)
+    : directory(directory)
+{
+}
+std::string TextureCache::prepare(const std::string &source, int width, int height) const
+{
+    MappedFile sourceFile;
+    if (!sourceFile.open(source))
+        return std::string();
+    std::uint64_t sourceHash = hash(sourceFile.getData(), sourceFile.getSize());
+    std::string path = getPath(sourceHash, width, height);
+
+    CacheHeader header;
+    if (readHeader(path, header) && header.width == (std::uint32_t)width && header.height == (std::uint32_t)height &&
+        header.sourceHash == sourceHash)
+        return path;
+
+    std::vector<unsigned char> chain;
+    if (!bake(sourceFile.getData(), sourceFile.getSize(), width, height, chain))
+        return std::string();
+    write(path, sourceHash, width, height, chain);
+    return path;
+}
+bool TextureCache::fetch(const std::string &source, int width, int height, std::vector<unsigned char> &chain) const
+{
+    std::string path = prepare(source, width, height);
+    return !path.empty() && read(path, width, height, 0, TextureLoader::getMipLevelCount(width, height) - 1, chain);
+}
+bool TextureCache::read(const std::string &path, int width, int height, int firstLevel, int lastLevel, std::vector<unsigned char> &blocks)
+{
+    CacheHeader header;
+    if (!readHeader(path, header) || header.width != (std::uint32_t)width || header.height != (std::uint32_t)height)
+        return false;
+    blocks.resize(getRangeSize(width, height, firstLevel, lastLevel));
+    return readAt(path, sizeof(CacheHeader) + getLevelOffset(width, height, lastLevel), blocks.data(), blocks.size());
+}
+bool TextureCache::bake(const unsigned char *file, std::size_t fileSize, int width, int height, std::vector<unsigned char> &chain)
+{
+    // bottom row first, the same as TextureLoader's uncompressed images
+    stbi_set_flip_vertically_on_load_thread(1);
+    int w, h, nrChannels;
+    unsigned char *data = stbi_load_from_memory(file, (int)fileSize, &w, &h, &nrChannels, 3);
+    if (!data)
+        return false;
+    std::vector<unsigned char> rgb((std::size_t)width * height * 3);
+    if (w == width && h == height)
+        std::memcpy(rgb.data(), data, rgb.size());
+    else
+        TextureLoader::resample(data, w, h, rgb.data(), width, height);
+    stbi_image_free(data);
+
+    const int topWidth = width, topHeight = height;
+    int level = 0;
+    chain.resize(getChainSize(width, height));
+    encodeBC1(rgb.data(), width, height, chain.data() + getLevelOffset(topWidth, topHeight, level));
+
+    const GammaTables &gamma = getGammaTables();
+    std::vector<float> linear((std::size_t)width * height * 4);
+    for (std::size_t i = 0, count = (std::size_t)width * height; i < count; ++i)
+    {
+        linear[i * 4 + 0] = gamma.toLinear[rgb[i * 3 + 0]];
+        linear[i * 4 + 1] = gamma.toLinear[rgb[i * 3 + 1]];
+        linear[i * 4 + 2] = gamma.toLinear[rgb[i * 3 + 2]];
+        linear[i * 4 + 3] = 0.0f;
+    }
+
+    std::vector<float> next;
+    while (width > 1 || height > 1)
+    {
+        int nextWidth = width > 1 ? width / 2 : 1;
+        int nextHeight = height > 1 ? height / 2 : 1;
+        next.resize((std::size_t)nextWidth * nextHeight * 4);
+        downsample(linear.data(), width, height, next.data());
+
+        for (std::size_t i = 0, count = (std::size_t)nextWidth * nextHeight; i < count; ++i)
+            for (int c = 0; c < 3; ++c)
+            {
+                float l = next[i * 4 + c];
+                int index = (int)(l * 4095.0f + 0.5f);
+                rgb[i * 3 + c] = gamma.toSrgb[index < 0 ? 0 : (index > 4095 ? 4095 : index)];
+            }
+        encodeBC1(rgb.data(), nextWidth, nextHeight, chain.data() + getLevelOffset(topWidth, topHeight, ++level));
+
+        linear.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return true;
+}
+std::size_t TextureCache::getLevelSize(int width, int height)
+{
+    std::size_t blocksX = (std::size_t)(width + 3) / 4;
+    std::size_t blocksY = (std::size_t)(height + 3) / 4;
+    return blocksX * blocksY * 8;
+}
+std::size_t TextureCache::getChainSize(int width, int height)
+{
+    std::size_t size = 0;
+    for (;;)
+    {
+        size += getLevelSize(width, height);
+        if (width == 1 && height == 1)
+            return size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+std::size_t TextureCache::getLevelOffset(int width, int height, int level)
+{
+    // everything coarser than level comes before it
+    std::size_t offset = 0;
+    for (int l = 0; width > 1 || height > 1; ++l)
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        if (l >= level)
+            offset += getLevelSize(width, height);
+    }
+    return offset;
+}
+std::size_t TextureCache::getRangeSize(int width, int height, int firstLevel, int lastLevel)
+{
+    // coarsest first, so the range runs from lastLevel to the end of firstLevel
+    std::size_t end = getLevelOffset(width, height, firstLevel) +
+                      getLevelSize(std::max(width >> firstLevel, 1), std::max(height >> firstLevel, 1));
+    return end - getLevelOffset(width, height, lastLevel);
+}
+void TextureCache::encodeBC1(const unsigned char *rgb, int width, int height, unsigned char *blocks)
+{
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    unsigned char texels[16][3];
+    for (int by = 0; by < blocksY; ++by)
+        for (int bx = 0; bx < blocksX; ++bx)
+        {
+            // blocks hanging over a small level repeat its last row and column
+            for (int j = 0; j < 4; ++j)
+            {
+                int y = by * 4 + j < height ? by * 4 + j : height - 1;
+                for (int i = 0; i < 4; ++i)
+                {
+                    int x = bx * 4 + i < width ? bx * 4 + i : width - 1;
+                    const unsigned char *p = rgb + ((std::size_t)y * width + x) * 3;
+                    texels[j * 4 + i][0] = p[0];
+                    texels[j * 4 + i][1] = p[1];
+                    texels[j * 4 + i][2] = p[2];
+                }
+            }
+            encodeBlock(texels, blocks + ((std::size_t)by * blocksX + bx) * 8);
+        }
+}
+void TextureCache::getFirstTexel(const unsigned char *block, unsigned char *rgb)
+{
+    unsigned short c0 = (unsigned short)(block[0] | block[1] << 8);
+    unsigned short c1 = (unsigned short)(block[2] | block[3] << 8);
+    int palette[2][3];
+    fromRgb565(c0, palette[0]);
+    fromRgb565(c1, palette[1]);
+    int index = block[4] & 3;
+    for (int c = 0; c < 3; ++c)
+    {
+        int value = palette[0][c];
+        if (index == 1)
+            value = palette[1][c];
+        else if (index == 2)
+            value = c0 > c1 ? (2 * palette[0][c] + palette[1][c]) / 3 : (palette[0][c] + palette[1][c]) / 2;
+        else if (index == 3)
+            value = c0 > c1 ? (palette[0][c] + 2 * palette[1][c]) / 3 : 0;
+        rgb[c] = (unsigned char)value;
+    }
+}
+void TextureCache::fillBC1(unsigned char *chain, std::size_t size, unsigned char r, unsigned char g, unsigned char b)
+{
+    float color[3] = {(float)r, (float)g, (float)b};
+    unsigned short c = toRgb565(color);
+    for (std::size_t offset = 0; offset + 8 <= size; offset += 8)
+        writeBlock(chain + offset, c, c, 0);
+}
+std::uint64_t TextureCache::hash(const unsigned char *data, std::size_t size)
+{
+    // FNV-1a
+    std::uint64_t h = 14695981039346656037ull;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        h ^= data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+std::string TextureCache::getPath(std::uint64_t sourceHash, int width, int height) const
+{
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx_%dx%d.bc1", (unsigned long long)sourceHash, width, height);
+    return directory + "/" + name;
+}
+void TextureCache::write(const std::string &path, std::uint64_t sourceHash, int width, int height, const std::vector<unsigned char> &chain) const
+{
+#if defined(WIN32) || defined(_WIN32)
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+
+    CacheHeader header;
+    std::memcpy(header.magic, "PTC1", 4);
+    header.version = VERSION;
+    header.width = (std::uint32_t)width;
+    header.height = (std::uint32_t)height;
+    header.levels = (std::uint32_t)TextureLoader::getMipLevelCount(width, height);
+    header.reserved = 0;
+    header.sourceHash = sourceHash;
+
+    // written aside and renamed, so a reader never maps a half-written file
+    std::string temporary = path + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    bool written = file != NULL &&
+                   std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   std::fwrite(chain.data(), 1, chain.size(), file) == chain.size();
+    if (file)
+        written = std::fclose(file) == 0 && written;
+    std::remove(path.c_str());
+    if (!written || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        std::cerr << "Failed to write texture cache: " << path << std::endl;
+    }
+}
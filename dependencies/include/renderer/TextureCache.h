@@ -0,0 +1,62 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// Baked BC1 (DXT1) mip chains of source images, one file per source and size.
+// A file is named after a hash of the source bytes, so an edited image gets a
+// new entry instead of a stale one. It holds a small header and then the
+// blocks, coarsest level first, ready for glCompressedTexSubImage3D: the small
+// mips are one short read at the front and every finer level is a single
+// contiguous range after them, so levels can be read on their own by offset.
+// Mips are averaged in linear light, and every level is encoded on the CPU.
+class TextureCache
+{
+public:
+    static const std::uint32_t VERSION = 2;
+
+    // empty directory disables the cache
+    TextureCache(const std::string &directory = "");
+
+    // path of the cache file of source at width x height, baked and written on a
+    // miss; empty when the source cannot be read
+    std::string prepare(const std::string &source, int width, int height) const;
+    // prepare() and a read of the whole chain
+    bool fetch(const std::string &source, int width, int height, std::vector<unsigned char> &chain) const;
+    // reads levels firstLevel (finest) to lastLevel (coarsest) of a prepared file, coarsest first
+    static bool read(const std::string &path, int width, int height, int firstLevel, int lastLevel, std::vector<unsigned char> &blocks);
+
+    bool isEnabled() const
+    {
+        return !directory.empty();
+    };
+    const std::string &getDirectory() const
+    {
+        return directory;
+    };
+
+    // decodes an image file held in memory and encodes its mip chain, false when it is not an image
+    static bool bake(const unsigned char *file, std::size_t fileSize, int width, int height, std::vector<unsigned char> &chain);
+    static std::size_t getLevelSize(int width, int height);
+    static std::size_t getChainSize(int width, int height);
+    // offset of a level in a chain stored coarsest first
+    static std::size_t getLevelOffset(int width, int height, int level);
+    static std::size_t getRangeSize(int width, int height, int firstLevel, int lastLevel);
+    // sRGB RGB texels, bottom row first, to 8-byte BC1 blocks in row order
+    static void encodeBC1(const unsigned char *rgb, int width, int height, unsigned char *blocks);
+    // colour of the top-left texel of a BC1 block
+    static void getFirstTexel(const unsigned char *block, unsigned char *rgb);
+    // every block of a chain set to one color
+    static void fillBC1(unsigned char *chain, std::size_t size, unsigned char r, unsigned char g, unsigned char b);
+    static std::uint64_t hash(const unsigned char *data, std::size_t size);
+
+private:
+    std::string directory;
+
+    std::string getPath(std::uint64_t sourceHash, int width, int height) const;
+    void write(const std::string &path, std::uint64_t sourceHash, int width, int height, const std::vector<unsigned char> &chain) const;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include "TextureLoader.h"
+#include <stb_image.h>
+#include <cstring>
+#include <utility>
+
+TextureLoader::TextureLoader(int threadCount, const std::string &cacheDirectory)
+    : cache(cacheDirectory)
+{
+    if (threadCount <= 0)
+        threadCount = (int)std::thread::hardware_concurrency();
+    if (threadCount <= 0)
+        threadCount = 1;
+    for (int i = 0; i < threadCount; ++i)
+        workers.push_back(std::thread(&TextureLoader::work, this));
+}
+TextureLoader::~TextureLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
+void TextureLoader::request(int id, const std::string &path, int width, int height, int firstLevel, int lastLevel)
+{
+    Job job;
+    job.id = id;
+    job.path = path;
+    job.width = width;
+    job.height = height;
+    job.firstLevel = firstLevel;
+    job.lastLevel = lastLevel < 0 ? getMipLevelCount(width, height) - 1 : lastLevel;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+        ++pending;
+    }
+    jobReady.notify_one();
+}
+bool TextureLoader::poll(DecodedImage &image)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (results.empty())
+        return false;
+    image = std::move(results.front());
+    results.pop_front();
+    --pending;
+    return true;
+}
+int TextureLoader::getPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending;
+}
+void TextureLoader::work()
+{
+    // per-thread flag, the global one belongs to whoever else uses stb_image
+    stbi_set_flip_vertically_on_load_thread(1);
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!stopping && jobs.empty())
+                jobReady.wait(lock);
+            if (stopping)
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        DecodedImage image;
+        decode(job, image);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(image));
+    }
+}
+void TextureLoader::decode(const Job &job, DecodedImage &image)
+{
+    image.id = job.id;
+    image.path = job.path;
+    image.width = job.width;
+    image.height = job.height;
+    image.compressed = cache.isEnabled();
+    if (image.compressed)
+    {
+        image.firstLevel = job.firstLevel;
+        image.lastLevel = job.lastLevel;
+
+        // the source is hashed, and baked if needed, once; later levels only read the cache file
+        std::string cachePath;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unordered_map<std::string, std::string>::const_iterator it = cachePaths.find(job.path);
+            if (it != cachePaths.end())
+                cachePath = it->second;
+        }
+        if (cachePath.empty())
+        {
+            cachePath = cache.prepare(job.path, job.width, job.height);
+            std::lock_guard<std::mutex> lock(mutex);
+            cachePaths[job.path] = cachePath;
+        }
+
+        image.loaded = !cachePath.empty() &&
+                       TextureCache::read(cachePath, job.width, job.height, job.firstLevel, job.lastLevel, image.pixels);
+        if (!image.loaded)
+        {
+            image.pixels.resize(TextureCache::getRangeSize(job.width, job.height, job.firstLevel, job.lastLevel));
+            TextureCache::fillBC1(image.pixels.data(), image.pixels.size(), 255, 255, 255);
+        }
+        return;
+    }
+
+    // without a cache the whole chain comes at once
+    image.firstLevel = 0;
+    image.lastLevel = getMipLevelCount(job.width, job.height) - 1;
+    image.pixels.resize(getMipChainSize(job.width, job.height, 3));
+    unsigned char *dst = image.pixels.data();
+    std::size_t levelSize = (std::size_t)job.width * job.height * 3;
+
+    int w, h, nrChannels;
+    unsigned char *data = stbi_load(job.path.c_str(), &w, &h, &nrChannels, 3);
+    image.loaded = data != NULL;
+    if (data)
+    {
+        if (w == job.width && h == job.height)
+            std::memcpy(dst, data, levelSize);
+        else
+            resample(data, w, h, dst, job.width, job.height);
+        stbi_image_free(data);
+    }
+    else
+    {
+        std::memset(dst, 255, levelSize);
+    }
+    buildMipChain(dst, job.width, job.height, 3);
+}
+int TextureLoader::getMipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        ++levels;
+    }
+    return levels;
+}
+std::size_t TextureLoader::getMipChainSize(int width, int height, int channels)
+{
+    std::size_t size = 0;
+    for (;;)
+    {
+        size += (std::size_t)width * height * channels;
+        if (width == 1 && height == 1)
+            return size;
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+}
+void TextureLoader::buildMipChain(unsigned char *pixels, int width, int height, int channels)
+{
+    unsigned char *src = pixels;
+    while (width > 1 || height > 1)
+    {
+        int nextWidth = width > 1 ? width / 2 : 1;
+        int nextHeight = height > 1 ? height / 2 : 1;
+        unsigned char *dst = src + (std::size_t)width * height * channels;
+
+        // 2x2 average; a dimension already at 1 averages the same texel twice
+        for (int y = 0; y < nextHeight; ++y)
+        {
+            const unsigned char *row0 = src + (std::size_t)(height > 1 ? 2 * y : 0) * width * channels;
+            const unsigned char *row1 = src + (std::size_t)(height > 1 ? 2 * y + 1 : 0) * width * channels;
+            for (int x = 0; x < nextWidth; ++x)
+            {
+                int x0 = (width > 1 ? 2 * x : 0) * channels;
+                int x1 = (width > 1 ? 2 * x + 1 : 0) * channels;
+                unsigned char *out = dst + ((std::size_t)y * nextWidth + x) * channels;
+                for (int c = 0; c < channels; ++c)
+                    out[c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+        src = dst;
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+void TextureLoader::resample(const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst, int dstWidth, int dstHeight)
+{
+    float scaleX = (float)srcWidth / dstWidth;
+    float scaleY = (float)srcHeight / dstHeight;
+    for (int y = 0; y < dstHeight; ++y)
+    {
+        float sy = (y + 0.5f) * scaleY - 0.5f;
+        if (sy < 0.0f)
+            sy = 0.0f;
+        int y0 = (int)sy;
+        int y1 = y0 + 1 < srcHeight ? y0 + 1 : srcHeight - 1;
+        float fy = sy - y0;
+
+        for (int x = 0; x < dstWidth; ++x)
+        {
+            float sx = (x + 0.5f) * scaleX - 0.5f;
+            if (sx < 0.0f)
+                sx += srcWidth;
+            int x0 = (int)sx;
+            int x1 = (x0 + 1) % srcWidth;
+            float fx = sx - x0;
+
+            const unsigned char *p00 = src + ((std::size_t)y0 * srcWidth + x0) * 3;
+            const unsigned char *p10 = src + ((std::size_t)y0 * srcWidth + x1) * 3;
+            const unsigned char *p01 = src + ((std::size_t)y1 * srcWidth + x0) * 3;
+            const unsigned char *p11 = src + ((std::size_t)y1 * srcWidth + x1) * 3;
+            unsigned char *out = dst + ((std::size_t)y * dstWidth + x) * 3;
+            for (int c = 0; c < 3; ++c)
+            {
+                float top = p00[c] + (p10[c] - p00[c]) * fx;
+                float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+                out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+}
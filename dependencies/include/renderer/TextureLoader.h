@@ -0,0 +1,82 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <renderer/TextureCache.h>
+
+// an image decoded off the GL thread: RGB, resampled to the requested size,
+// bottom row first, with its whole mip chain packed level after level;
+// when compressed, the BC1 blocks of levels firstLevel to lastLevel, coarsest first
+struct DecodedImage
+{
+    int id;
+    std::string path;
+    int width;
+    int height;
+    bool loaded; // false when the file could not be read, pixels are then white
+    bool compressed;
+    int firstLevel;
+    int lastLevel;
+    std::vector<unsigned char> pixels;
+};
+
+// Pool of worker threads decoding image files with stb_image.
+// request() returns at once and poll() hands the finished images back to the
+// calling thread, so every GL call stays on the thread that owns the context.
+// Decodes run side by side, so a batch takes about as long as its slowest image.
+class TextureLoader
+{
+public:
+    // 0 starts one worker per hardware thread; with a cache directory every
+    // image comes back as a BC1 chain, baked on the first request
+    TextureLoader(int threadCount = 0, const std::string &cacheDirectory = "");
+    // queued requests that have not started are dropped
+    ~TextureLoader();
+
+    // a level range is only honoured with a cache, -1 is the coarsest level
+    void request(int id, const std::string &path, int width, int height, int firstLevel = 0, int lastLevel = -1);
+    // false when no image is finished yet
+    bool poll(DecodedImage &image);
+    // requested and not yet returned by poll()
+    int getPendingCount() const;
+
+    // mip chain layout shared with the uploaders, halving down to 1x1
+    static int getMipLevelCount(int width, int height);
+    static std::size_t getMipChainSize(int width, int height, int channels);
+    // level 0 must be filled, every following level is box filtered from the one before
+    static void buildMipChain(unsigned char *pixels, int width, int height, int channels);
+    // bilinear resample of an RGB image, wrapping horizontally like the sphere seam
+    static void resample(const unsigned char *src, int srcWidth, int srcHeight, unsigned char *dst, int dstWidth, int dstHeight);
+
+private:
+    struct Job
+    {
+        int id;
+        std::string path;
+        int width;
+        int height;
+        int firstLevel;
+        int lastLevel;
+    };
+
+    TextureCache cache;
+    std::vector<std::thread> workers;
+    mutable std::mutex mutex;
+    std::condition_variable jobReady;
+    std::deque<Job> jobs;
+    std::deque<DecodedImage> results;
+    std::unordered_map<std::string, std::string> cachePaths; // source -> prepared cache file
+    int pending = 0;
+    bool stopping = false;
+
+    void work();
+    void decode(const Job &job, DecodedImage &image);
+};
+
+#endif
@@ -0,0 +1,104 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// one thread per body: frustum test, level of detail with hysteresis, then the
+// body index is appended to its level's run and that level's instance count
+// is bumped. See GpuDrivenRenderer.
+
+// same layout as GpuBody in GpuDrivenRenderer.h
+struct Body
+{
+    mat4 model;   // unit sphere to world
+    vec4 bounds;  // world centre, radius
+    float textureLayer;
+    uint flags;
+    vec2 padding;
+};
+
+layout (std430, binding = 0) readonly buffer Bodies
+{
+    Body bodies[];
+};
+
+// rank of the last level per body: -2 unknown, -1 point
+layout (std430, binding = 1) buffer LastLevels
+{
+    int lastLevels[];
+};
+
+// levelCount DrawElementsIndirectCommands of 5 uints, then one
+// DrawArraysIndirectCommand for the points; instanceCount is the second uint
+layout (std430, binding = 2) buffer Commands
+{
+    uint commands[];
+};
+
+// visible body indices, level l fills [l * regionSize, (l + 1) * regionSize)
+layout (std430, binding = 3) writeonly buffer Visible
+{
+    uint visible[];
+};
+
+const int MAX_LEVELS = 16;
+
+uniform uint bodyCount;
+uniform uint regionSize;
+uniform vec4 frustumPlanes[6]; // pointing inwards
+uniform vec3 cameraPos;
+uniform float pixelScale;      // screen radius in pixels = world radius / distance * pixelScale
+uniform float pixelsPerEdge;
+uniform float pointRadius;
+uniform float hysteresis;
+uniform int levelCount;
+uniform int levelSectors[MAX_LEVELS];
+
+// same rule as SphereLod::selectLevel
+int selectLevel(float screenRadius)
+{
+    float sectorsNeeded = 6.2831853 * screenRadius / pixelsPerEdge;
+    for (int i = 0; i < levelCount; ++i)
+    {
+        if (float(levelSectors[i]) >= sectorsNeeded)
+            return i;
+    }
+    return levelCount - 1;
+}
+
+void main()
+{
+    uint body = gl_GlobalInvocationID.x;
+    if (body >= bodyCount)
+        return;
+
+    vec4 bounds = bodies[body].bounds;
+    for (int p = 0; p < 6; ++p)
+    {
+        if (dot(frustumPlanes[p].xyz, bounds.xyz) + frustumPlanes[p].w < -bounds.w)
+            return;
+    }
+
+    // as InstancedRenderer::selectLevel, rank -1 is the point bucket
+    int rank;
+    float distance = length(bounds.xyz - cameraPos);
+    if (distance <= bounds.w)
+    {
+        rank = levelCount - 1;
+    }
+    else
+    {
+        float screenRadius = bounds.w / distance * pixelScale;
+        int rankUp = screenRadius < pointRadius ? -1 : selectLevel(screenRadius);
+        float shrunk = screenRadius * hysteresis;
+        int rankDown = shrunk < pointRadius ? -1 : selectLevel(shrunk);
+
+        int last = lastLevels[body];
+        rank = rankUp;
+        if (last != -2 && rankUp <= last)
+            rank = min(rankDown, last); // inside the band the previous level is kept
+        lastLevels[body] = rank;
+    }
+
+    uint slot = rank < 0 ? uint(levelCount) : uint(rank);
+    uint n = atomicAdd(commands[slot * 5u + 1u], 1u);
+    visible[slot * regionSize + n] = body;
+}
@@ -6,8 +6,6 @@ in vec2 TexCoord;
 
 out vec4 FragColor;
 
-uniform vec3 viewPos;
-
 // Material
 uniform sampler2D ourTexture;
 
@@ -19,7 +17,6 @@ struct DirLight {
     vec3 diffuse;
     vec3 specular;
 };
-uniform DirLight dirLight;
 
 // Point light
 struct PointLight {
@@ -29,7 +26,16 @@ struct PointLight {
     vec3 diffuse;
     vec3 specular;
 };
-uniform PointLight pointLight;
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLight;
+};
 
 void main()
 {
@@ -0,0 +1,33 @@
+#version 430 core
+// per instance, same body buffer as gpuVertexShader.glsl
+layout (location = 3) in uint aBody;
+
+struct Body
+{
+    mat4 model;
+    vec4 bounds;
+    float textureLayer;
+    uint flags;
+    vec2 padding;
+};
+
+layout (std430, binding = 0) readonly buffer Bodies
+{
+    Body bodies[];
+};
+
+flat out float TextureLayer;
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+};
+
+void main()
+{
+    // sub-pixel body: one point at its centre
+    TextureLayer = bodies[aBody].textureLayer;
+    gl_Position = projection * view * vec4(bodies[aBody].bounds.xyz, 1.0);
+}
@@ -0,0 +1,141 @@
+#version 330 core
+
+in vec3 FragPos;
+flat in vec3 Center;
+flat in float Radius;
+flat in mat3 WorldToObject;
+flat in float TextureLayer;
+flat in uint Flags;
+
+out vec4 FragColor;
+
+// Material, one array layer per body
+uniform sampler2DArray ourTextures;
+
+// Directional light
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Point light
+struct PointLight {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLight;
+};
+
+// per layer: array slot (-1 without one), finest streamed-in mip, packed average colour, see TextureArray
+layout (std140) uniform TextureResidency
+{
+    vec4 textureSlots[1024];
+};
+
+// matches InstanceFlags in InstancedRenderer.h
+const uint INSTANCE_UNLIT = 1u;
+
+vec4 layerInfo(int layer)
+{
+    return layer >= 0 && layer < 1024 ? textureSlots[layer] : vec4(-1.0, 0.0, 16777215.0, 0.0);
+}
+
+vec3 unpackColor(float rgb)
+{
+    float rg = floor(rgb / 256.0);
+    return vec3(floor(rg / 256.0), mod(rg, 256.0), mod(rgb, 256.0)) / 255.0;
+}
+
+const float PI = 3.14159265358979;
+
+void main()
+{
+    // analytic ray-sphere intersection, |o + t*dir - c| = r
+    vec3 rayDir = normalize(FragPos - viewPos);
+    vec3 oc = viewPos - Center;
+    float b = dot(oc, rayDir);
+    float disc = b * b - (dot(oc, oc) - Radius * Radius);
+    float root = sqrt(max(disc, 0.0));
+    float t = -b - root;
+    if (t < 0.0)
+        t = -b + root; // inside the sphere, the far side is visible
+    vec3 hit = viewPos + rayDir * t;
+    vec3 norm = (hit - Center) / Radius;
+
+    // same parametrization as the Sphere mesh (z up): s = sector / 2pi, t = (pi/2 - stack) / pi
+    vec3 local = WorldToObject * (hit - Center);
+    float u = fract(atan(local.y, local.x) / (2.0 * PI));
+    vec2 uv = vec2(u, acos(clamp(local.z, -1.0, 1.0)) / PI);
+
+    // u jumps from 1 to 0 at the seam, take the gradient of the copy that is continuous there
+    float seamU = fract(u + 0.5);
+    vec2 dx = dFdx(uv);
+    vec2 dy = dFdy(uv);
+    float seamDx = dFdx(seamU);
+    float seamDy = dFdy(seamU);
+    if (abs(seamDx) < abs(dx.x))
+        dx.x = seamDx;
+    if (abs(seamDy) < abs(dy.x))
+        dy.x = seamDy;
+
+    // derivatives are taken above while every fragment of the quad is still running
+    if (disc < 0.0 || t < 0.0)
+        discard;
+
+    vec4 clip = projection * view * vec4(hit, 1.0);
+    gl_FragDepth = (gl_DepthRange.diff * clip.z / clip.w + gl_DepthRange.near + gl_DepthRange.far) * 0.5;
+
+    // gradients widened up to the finest level the layer has streamed in,
+    // a layer without a slot shows its average colour
+    vec4 info = layerInfo(int(TextureLayer));
+    vec2 size = vec2(textureSize(ourTextures, 0).xy);
+    float lod = 0.5 * log2(max(max(dot(dx * size, dx * size), dot(dy * size, dy * size)), 1e-8));
+    float scale = exp2(max(info.y - lod, 0.0));
+    vec3 albedo = vec3(textureGrad(ourTextures, vec3(uv, max(info.x, 0.0)), dx * scale, dy * scale));
+    if (info.x < 0.0)
+        albedo = unpackColor(info.z);
+    if ((Flags & INSTANCE_UNLIT) != 0u)
+    {
+        FragColor = vec4(albedo, 1.0);
+        return;
+    }
+    // Normalized vectors, the sphere normal is already unit length
+    vec3 viewDir = normalize(viewPos - hit);
+
+    // Directional Light 
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+
+    vec3 ambient = dirLight.ambient * albedo;
+    vec3 diffuse = dirLight.diffuse * diff * albedo;
+    vec3 specular = dirLight.specular * spec;
+
+    // Point Light
+    vec3 pointLightDir = normalize(pointLight.position - hit);
+    float pointDiff = max(dot(norm, pointLightDir), 0.0);
+    vec3 pointReflect = reflect(-pointLightDir, norm);
+    float pointSpec = pow(max(dot(viewDir, pointReflect), 0.0), 32.0);
+
+    vec3 pointAmbient = pointLight.ambient * albedo;
+    vec3 pointDiffuse = pointLight.diffuse * pointDiff * albedo;
+    vec3 pointSpecular = pointLight.specular * pointSpec;
+
+    vec3 result = ambient + diffuse + specular + pointAmbient + pointDiffuse + pointSpecular;
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,84 @@
+#version 330 core
+// Ray-traced sphere impostor: each body is one camera-facing quad, built from
+// gl_VertexID as a 4 vertex triangle strip. impostorFragmentShader.glsl
+// intersects the view ray with the sphere.
+
+// per instance, same layout as instancedVertexShader.glsl
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in float aTextureLayer;
+layout (location = 8) in uint aFlags;
+
+out vec3 FragPos; // point on the quad, only its direction from the eye is used
+flat out vec3 Center;
+flat out float Radius;
+flat out mat3 WorldToObject; // world offset from the centre to the unit mesh frame
+flat out float TextureLayer;
+flat out uint Flags;
+
+// Directional light
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Point light
+struct PointLight {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLight;
+};
+
+const vec2 CORNERS[4] = vec2[4](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0), vec2(1.0, 1.0));
+
+void main()
+{
+    vec2 corner = CORNERS[gl_VertexID];
+    Center = aModel[3].xyz;
+    Radius = length(aModel[0].xyz); // uniform scale
+    WorldToObject = transpose(mat3(aModel)) / (Radius * Radius);
+    TextureLayer = aTextureLayer;
+    Flags = aFlags;
+
+    // the silhouette is the circle where the view cone touches the sphere, it lies
+    // in the plane r^2/d in front of the centre and has radius r*sqrt(1 - r^2/d^2)
+    vec3 toCenter = Center - viewPos;
+    float d = length(toCenter);
+    vec3 axis = toCenter / d;
+    float ratio = min(Radius / d, 1.0);
+    vec3 circleCenter = Center - axis * (Radius * ratio);
+    float extent = Radius * sqrt(1.0 - ratio * ratio);
+
+    // the quad must stay in front of the near plane, otherwise it is clipped away
+    float near = projection[3][2] / (projection[2][2] - 1.0);
+    float depth = -(view * vec4(circleCenter, 1.0)).z;
+    if (d > Radius && depth - extent * 1.415 > near)
+    {
+        vec3 up = abs(axis.y) < 0.99 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+        vec3 right = normalize(cross(axis, up));
+        up = cross(right, axis);
+        FragPos = circleCenter + (right * corner.x + up * corner.y) * extent;
+        gl_Position = projection * view * vec4(FragPos, 1.0);
+    }
+    else
+    {
+        // camera inside or right next to the body: cover the whole screen
+        vec4 world = inverse(projection * view) * vec4(corner, 0.0, 1.0);
+        FragPos = world.xyz / world.w;
+        gl_Position = vec4(corner, 0.0, 1.0);
+    }
+}
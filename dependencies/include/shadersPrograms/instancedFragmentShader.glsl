@@ -0,0 +1,107 @@
+#version 330 core
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoord;
+flat in float TextureLayer;
+flat in uint Flags;
+
+out vec4 FragColor;
+
+// Material, one array layer per body
+uniform sampler2DArray ourTextures;
+
+// Directional light
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Point light
+struct PointLight {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLight;
+};
+
+// per layer: array slot (-1 without one), finest streamed-in mip, packed average colour, see TextureArray
+layout (std140) uniform TextureResidency
+{
+    vec4 textureSlots[1024];
+};
+
+// matches InstanceFlags in InstancedRenderer.h
+const uint INSTANCE_UNLIT = 1u;
+
+vec4 layerInfo(int layer)
+{
+    return layer >= 0 && layer < 1024 ? textureSlots[layer] : vec4(-1.0, 0.0, 16777215.0, 0.0);
+}
+
+vec3 unpackColor(float rgb)
+{
+    float rg = floor(rgb / 256.0);
+    return vec3(floor(rg / 256.0), mod(rg, 256.0), mod(rgb, 256.0)) / 255.0;
+}
+
+void main()
+{
+    // biased up to the finest level the layer has streamed in, otherwise the usual level;
+    // a layer without a slot shows its average colour
+    vec4 info = layerInfo(int(TextureLayer));
+    vec2 texel = TexCoord * vec2(textureSize(ourTextures, 0).xy);
+    vec2 texelDx = dFdx(texel);
+    vec2 texelDy = dFdy(texel);
+    float lod = 0.5 * log2(max(max(dot(texelDx, texelDx), dot(texelDy, texelDy)), 1e-8));
+    float bias = max(info.y - lod, 0.0);
+    vec3 albedo = vec3(texture(ourTextures, vec3(TexCoord, max(info.x, 0.0)), bias));
+    if (info.x < 0.0)
+        albedo = unpackColor(info.z);
+    if ((Flags & INSTANCE_UNLIT) != 0u)
+    {
+        FragColor = vec4(albedo, 1.0);
+        return;
+    }
+
+    // Normalized vectors
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    // Directional Light 
+    vec3 lightDir = normalize(-dirLight.direction);
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32.0);
+
+    vec3 ambient = dirLight.ambient * albedo;
+    vec3 diffuse = dirLight.diffuse * diff * albedo;
+    vec3 specular = dirLight.specular * spec;
+
+    // Point Light
+    vec3 pointLightDir = normalize(pointLight.position - FragPos);
+    float pointDiff = max(dot(norm, pointLightDir), 0.0);
+    vec3 pointReflect = reflect(-pointLightDir, norm);
+    float pointSpec = pow(max(dot(viewDir, pointReflect), 0.0), 32.0);
+
+    vec3 pointAmbient = pointLight.ambient * albedo;
+    vec3 pointDiffuse = pointLight.diffuse * pointDiff * albedo;
+    vec3 pointSpecular = pointLight.specular * pointSpec;
+
+    vec3 result = ambient + diffuse + specular + pointAmbient + pointDiffuse + pointSpecular;
+    FragColor = vec4(result, 1.0);
+}
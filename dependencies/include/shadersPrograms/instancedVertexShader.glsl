@@ -0,0 +1,65 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aNormal; // octahedral, see Sphere::buildPackedVertices
+layout (location = 2) in vec2 aTexCoord;
+
+// per instance
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in float aTextureLayer;
+layout (location = 8) in uint aFlags;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out float TextureLayer;
+flat out uint Flags;
+
+// Directional light
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Point light
+struct PointLight {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLight;
+};
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    // unfold the lower hemisphere
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    FragPos = vec3(aModel * vec4(aPos, 1.0));
+    // bodies are only translated, rotated and uniformly scaled, so the
+    // model matrix itself transforms normals (they are normalized later)
+    Normal = mat3(aModel) * octDecode(aNormal);
+    TexCoord = aTexCoord;
+    TextureLayer = aTextureLayer;
+    Flags = aFlags;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+
+flat in float TextureLayer;
+
+out vec4 FragColor;
+
+// see instancedFragmentShader.glsl
+layout (std140) uniform TextureResidency
+{
+    vec4 textureSlots[1024];
+};
+
+vec3 unpackColor(float rgb)
+{
+    float rg = floor(rgb / 256.0);
+    return vec3(floor(rg / 256.0), mod(rg, 256.0), mod(rgb, 256.0)) / 255.0;
+}
+
+void main()
+{
+    // the average colour of the whole map, known whether or not the layer has a slot
+    int layer = int(TextureLayer);
+    vec3 color = layer >= 0 && layer < 1024 ? unpackColor(textureSlots[layer].z) : vec3(1.0);
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,20 @@
+#version 330 core
+// per instance, same layout as instancedVertexShader.glsl
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in float aTextureLayer;
+
+flat out float TextureLayer;
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+};
+
+void main()
+{
+    // sub-pixel body: one point at its centre
+    TextureLayer = aTextureLayer;
+    gl_Position = projection * view * vec4(aModel[3].xyz, 1.0);
+}
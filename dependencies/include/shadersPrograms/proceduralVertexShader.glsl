@@ -0,0 +1,92 @@
+#version 330 core
+// Attribute-less unit sphere: every vertex is rebuilt from gl_VertexID, no
+// vertex buffer is bound. Vertices follow the triangle order of
+// Sphere::buildVerticesSmooth (see Sphere::getProceduralVertexCount):
+//   top cap:  sectorCount triangles (k1+1, k2, k2+1) of stack 0
+//   body:     6 vertices per quad of stacks 1 .. stackCount-2
+//   bottom:   sectorCount triangles (k1, k2, k1+1) of the last stack
+
+// per instance, same layout as instancedVertexShader.glsl
+layout (location = 3) in mat4 aModel;
+layout (location = 7) in float aTextureLayer;
+layout (location = 8) in uint aFlags;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+flat out float TextureLayer;
+flat out uint Flags;
+
+// Directional light
+struct DirLight {
+    vec3 direction;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// Point light
+struct PointLight {
+    vec3 position;
+
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+// per-frame constants, see FrameData in FrameUniforms.h
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPos;
+    DirLight dirLight;
+    PointLight pointLight;
+};
+
+uniform int sectorCount;
+uniform int stackCount;
+
+const float PI = 3.14159265358979;
+
+// (stack, sector) offsets of the triangle corners
+const ivec2 TOP_CAP[3] = ivec2[3](ivec2(0, 1), ivec2(1, 0), ivec2(1, 1));
+const ivec2 QUAD[6] = ivec2[6](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1), ivec2(0, 1), ivec2(1, 0), ivec2(1, 1));
+const ivec2 BOTTOM_CAP[3] = ivec2[3](ivec2(0, 0), ivec2(1, 0), ivec2(0, 1));
+
+void main()
+{
+    int id = gl_VertexID;
+    int capVertices = 3 * sectorCount;
+    int bodyVertices = 6 * sectorCount * (stackCount - 2);
+
+    ivec2 cell;
+    if (id < capVertices)
+    {
+        cell = ivec2(0, id / 3) + TOP_CAP[id % 3];
+    }
+    else if (id < capVertices + bodyVertices)
+    {
+        int quad = (id - capVertices) / 6;
+        cell = ivec2(1 + quad / sectorCount, quad % sectorCount) + QUAD[(id - capVertices) % 6];
+    }
+    else
+    {
+        int tri = (id - capVertices - bodyVertices) / 3;
+        cell = ivec2(stackCount - 1, tri) + BOTTOM_CAP[(id - capVertices - bodyVertices) % 3];
+    }
+
+    // same parametrization as the mesh, the seam column reuses sector 0 so the surface stays closed
+    float stackAngle = PI / 2.0 - float(cell.x) * PI / float(stackCount);
+    float sectorAngle = float(cell.y % sectorCount) * 2.0 * PI / float(sectorCount);
+    vec3 direction = vec3(cos(stackAngle) * cos(sectorAngle), cos(stackAngle) * sin(sectorAngle), sin(stackAngle));
+
+    // unit sphere: the direction is both position and normal
+    FragPos = vec3(aModel * vec4(direction, 1.0));
+    Normal = mat3(aModel) * direction;
+    TexCoord = vec2(float(cell.y) / float(sectorCount), float(cell.x) / float(stackCount));
+    TextureLayer = aTextureLayer;
+    Flags = aFlags;
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
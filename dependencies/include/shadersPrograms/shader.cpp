@@ -3,100 +3,161 @@
 #include <sstream>
 #include <iostream>
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath)
+namespace
 {
-    std::string vertexCode;
-    std::string fragmentCode;
-    std::ifstream vShaderFile;
-    std::ifstream fShaderFile;
-
-    vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try
-    {
-        vShaderFile.open(vertexPath);
-        fShaderFile.open(fragmentPath);
-        std::stringstream vShaderStream, fShaderStream;
-        vShaderStream << vShaderFile.rdbuf();
-        fShaderStream << fShaderFile.rdbuf();
-        vShaderFile.close();
-        fShaderFile.close();
-        vertexCode = vShaderStream.str();
-        fragmentCode = fShaderStream.str();
-    }
-    catch (std::ifstream::failure e)
+    // whole file as a string, empty after reporting that it could not be read
+    std::string readShaderFile(const char *path)
     {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        std::ifstream file;
+        file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        try
+        {
+            file.open(path);
+            std::stringstream stream;
+            stream << file.rdbuf();
+            file.close();
+            return stream.str();
+        }
+        catch (const std::ifstream::failure &e)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        }
+        return std::string();
     }
-    const char *vShaderCode = vertexCode.c_str();
-    const char *fShaderCode = fragmentCode.c_str();
-
-    // compiling shaders
-    unsigned int vertex, fragment;
-    int success;
-    char infoLog[512];
 
-    vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vShaderCode, NULL);
-    glCompileShader(vertex);
-
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success)
+    // stageName goes into the error message, e.g. VERTEX
+    unsigned int compileShader(GLenum type, const std::string &code, const char *stageName)
     {
-        glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
-    };
+        const char *source = code.c_str();
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
 
-    fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fShaderCode, NULL);
-    glCompileShader(fragment);
+        int success;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n"
+                      << infoLog << std::endl;
+        }
+        return shader;
+    }
 
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success)
+    void linkProgram(unsigned int program)
     {
-        glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n"
-                  << infoLog << std::endl;
-    };
+        int success;
+        char infoLog[512];
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
+                      << infoLog << std::endl;
+        }
+    }
+}
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath)
+{
+    // compiling shaders
+    unsigned int vertex = compileShader(GL_VERTEX_SHADER, readShaderFile(vertexPath), "VERTEX");
+    unsigned int fragment = compileShader(GL_FRAGMENT_SHADER, readShaderFile(fragmentPath), "FRAGMENT");
 
     // shader program
     ID = glCreateProgram();
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
-    glLinkProgram(ID);
-    glGetProgramiv(ID, GL_LINK_STATUS, &success);
-    if (!success)
-    {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n"
-                  << infoLog << std::endl;
-    }
+    linkProgram(ID);
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+
+    reflectUniforms();
+}
+
+Shader::Shader(const char *computePath)
+{
+    unsigned int compute = compileShader(GL_COMPUTE_SHADER, readShaderFile(computePath), "COMPUTE");
+
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    linkProgram(ID);
+    glDeleteShader(compute);
+
+    reflectUniforms();
+}
+
+// query every active uniform once so per-frame setters need no glGetUniformLocation
+void Shader::reflectUniforms()
+{
+    uniformLocations.clear();
+
+    int count = 0, maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+
+    for (int i = 0; i < count; ++i)
+    {
+        int length = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName = name.substr(0, length);
+
+        // uniforms inside blocks have no location
+        int location = glGetUniformLocation(ID, uniformName.c_str());
+        if (location < 0)
+            continue;
+
+        // arrays are reported as "name[0]", also make them reachable as "name"
+        std::string::size_type bracket = uniformName.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+            uniformLocations[uniformHash(uniformName.substr(0, bracket).c_str())] = location;
+
+        unsigned int hash = uniformHash(uniformName.c_str());
+        if (uniformLocations.count(hash) && uniformLocations[hash] != location)
+            std::cout << "ERROR::SHADER::UNIFORM_HASH_COLLISION " << uniformName << std::endl;
+        uniformLocations[hash] = location;
+    }
 }
 
 void Shader::use()
 {
     glUseProgram(ID);
 }
-void Shader::setBool(const std::string &name, bool value) const
+Uniform Shader::getUniform(unsigned int nameHash) const
+{
+    Uniform uniform;
+    std::unordered_map<unsigned int, int>::const_iterator it = uniformLocations.find(nameHash);
+    if (it != uniformLocations.end())
+        uniform.location = it->second;
+    return uniform;
+}
+void Shader::setUniformBlockBinding(const char *blockName, unsigned int binding) const
+{
+    unsigned int index = glGetUniformBlockIndex(ID, blockName);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(ID, index, binding);
+}
+void Shader::setBool(Uniform uniform, bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(uniform.location, (int)value);
 }
-void Shader::setInt(const std::string &name, int value) const
+void Shader::setInt(Uniform uniform, int value) const
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(uniform.location, value);
 }
-void Shader::setFloat(const std::string &name, float value) const
+void Shader::setFloat(Uniform uniform, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(uniform.location, value);
 }
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const
+void Shader::setMat4(Uniform uniform, const glm::mat4 &mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(mat));
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(mat));
 }
-void Shader::setVec3(const std::string &name, const glm::vec3 &vec) const
+void Shader::setVec3(Uniform uniform, const glm::vec3 &vec) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(vec));
+    glUniform3fv(uniform.location, 1, glm::value_ptr(vec));
 }
\ No newline at end of file
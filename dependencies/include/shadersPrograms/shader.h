@@ -6,22 +6,56 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <glm/gtc/type_ptr.hpp>
 
+// FNV-1a hash of a uniform name, usable at compile time:
+//   constexpr unsigned int VIEW = uniformHash("view");
+constexpr unsigned int uniformHash(const char *name, unsigned int hash = 2166136261u)
+{
+    return *name ? uniformHash(name + 1, (hash ^ (unsigned char)*name) * 16777619u) : hash;
+}
+
+// pre-resolved uniform location, -1 if the program has no such active uniform
+struct Uniform
+{
+    int location = -1;
+};
+
 class Shader
 {
     public: 
          unsigned int ID;
 
          Shader(const char* vertexPath, const char* fragmentPath);
+         // compute-only program, needs a GL 4.3 context
+         explicit Shader(const char* computePath);
          void use();
 
-         void setBool(const std::string &name,bool value) const;
-         void setInt( const std::string &name,int value ) const;
-         void setFloat (const std::string &name, float value) const;
-         void setMat4(const std::string &name, const glm::mat4 &mat) const;
-         void setVec3(const std::string &name, const glm::vec3 &vec) const;
+         // lookups go to the table built once after linking, never to the driver
+         Uniform getUniform(unsigned int nameHash) const;
+         Uniform getUniform(const char *name) const { return getUniform(uniformHash(name)); }
+
+         // attach a uniform block of this program to a buffer binding point
+         void setUniformBlockBinding(const char *blockName, unsigned int binding) const;
+
+         void setBool(Uniform uniform, bool value) const;
+         void setInt(Uniform uniform, int value) const;
+         void setFloat(Uniform uniform, float value) const;
+         void setMat4(Uniform uniform, const glm::mat4 &mat) const;
+         void setVec3(Uniform uniform, const glm::vec3 &vec) const;
+
+         void setBool(const char *name, bool value) const { setBool(getUniform(name), value); }
+         void setInt(const char *name, int value) const { setInt(getUniform(name), value); }
+         void setFloat(const char *name, float value) const { setFloat(getUniform(name), value); }
+         void setMat4(const char *name, const glm::mat4 &mat) const { setMat4(getUniform(name), mat); }
+         void setVec3(const char *name, const glm::vec3 &vec) const { setVec3(getUniform(name), vec); }
+
+    private:
+         std::unordered_map<unsigned int, int> uniformLocations; // name hash -> location
+
+         void reflectUniforms();
 };
 
 
-#endif
\ No newline at end of file
+#endif
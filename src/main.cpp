@@ -1,10 +1,19 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <vector>
+#include <cmath>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "planet/Planet.h"
+#include "planet/Ephemeris.h"
+#include "renderer/InstancedRenderer.h"
+#include "renderer/FrameUniforms.h"
+#include "renderer/TextureArray.h"
+#include "renderer/MeshArena.h"
+#include "renderer/GpuDrivenRenderer.h"
+#include "renderer/Frustum.h"
 #include "Timer/Timer.h"
 #include <camera/camera.h>
 #include <shadersPrograms/shader.h>
@@ -17,6 +26,20 @@ bool firstMouse = true;
 
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
+// sky time runs a day per second of scene time, from J2000
+const double SKY_SECONDS_PER_SECOND = 86400.0;
+// an astronomical unit is Earth's orbit radius in the scene
+const double KM_PER_UNIT = 149597870.7 / 0.9;
+
+// J2000 equatorial km to the scene: onto the ecliptic, with its north as y
+glm::vec3 equatorialToScene(const double *p)
+{
+    const double obliquity = 0.40909280422232897; // 84381.448 arcseconds
+    double y = std::cos(obliquity) * p[1] + std::sin(obliquity) * p[2];
+    double z = -std::sin(obliquity) * p[1] + std::cos(obliquity) * p[2];
+    return glm::vec3((float)(p[0] / KM_PER_UNIT), (float)(z / KM_PER_UNIT), (float)(y / KM_PER_UNIT));
+}
+
 void mouse_callback(GLFWwindow *window, double xpos, double ypos)
 {
     if (firstMouse)
@@ -47,7 +70,7 @@ void mouse_callback(GLFWwindow *window, double xpos, double ypos)
     camera.ProcessMouseMovement(xoffset, yoffset);
 }
 
-void processInput(GLFWwindow *window, Camera &camera, float deltaTime, Planet &sun, Planet &moon)
+void processInput(GLFWwindow *window, Camera &camera, float deltaTime, Planet &sun, Planet &moon, InstancedRenderer &renderer, bool &gpuDriven, float &timeScale)
 { // camera keys control
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.ProcessKeyboard(FORWARD, deltaTime);
@@ -69,6 +92,34 @@ void processInput(GLFWwindow *window, Camera &camera, float deltaTime, Planet &s
         moon.increaseRotationSpeed();
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
         moon.decreaseRotationSpeed();
+    // cycle between sphere meshes, attribute-less procedural spheres and ray-traced impostors
+    static bool modeKeyDown = false;
+    bool modeKey = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (modeKey && !modeKeyDown)
+        renderer.setMode((SphereMode)((renderer.getMode() + 1) % SPHERE_MODE_COUNT));
+    modeKeyDown = modeKey;
+    // switch between CPU culling and GPU culling with indirect draws
+    static bool gpuKeyDown = false;
+    bool gpuKey = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (gpuKey && !gpuKeyDown)
+        gpuDriven = !gpuDriven;
+    gpuKeyDown = gpuKey;
+    // time warp: [ and ] halve and double the rate, R plays backwards; orbits are
+    // evaluated at the time, so any rate costs the same
+    static bool slowerKeyDown = false, fasterKeyDown = false, reverseKeyDown = false;
+    bool slowerKey = glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS;
+    bool fasterKey = glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS;
+    bool reverseKey = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (slowerKey && !slowerKeyDown && std::fabs(timeScale) > 1.0f / 64.0f)
+        timeScale *= 0.5f;
+    if (fasterKey && !fasterKeyDown && std::fabs(timeScale) < 4096.0f)
+        timeScale *= 2.0f;
+    if (reverseKey && !reverseKeyDown)
+        timeScale = -timeScale;
+    slowerKeyDown = slowerKey;
+    fasterKeyDown = fasterKey;
+    reverseKeyDown = reverseKey;
+
     //closing window
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -105,49 +156,128 @@ int main()
     }
     glEnable(GL_DEPTH_TEST);
 
-    Shader ourShader("dependencies/include/shadersPrograms/vertexShader.glsl", "dependencies/include/shadersPrograms/fragmentShader.glsl");
+    Shader ourShader("dependencies/include/shadersPrograms/instancedVertexShader.glsl", "dependencies/include/shadersPrograms/instancedFragmentShader.glsl");
+    Shader pointShader("dependencies/include/shadersPrograms/pointVertexShader.glsl", "dependencies/include/shadersPrograms/pointFragmentShader.glsl");
+    Shader proceduralShader("dependencies/include/shadersPrograms/proceduralVertexShader.glsl", "dependencies/include/shadersPrograms/instancedFragmentShader.glsl");
+    Shader impostorShader("dependencies/include/shadersPrograms/impostorVertexShader.glsl", "dependencies/include/shadersPrograms/impostorFragmentShader.glsl");
+
+    // camera and lights live in one uniform buffer shared by every program
+    FrameUniforms frameUniforms;
+    ourShader.setUniformBlockBinding("FrameData", FrameUniforms::BINDING);
+    pointShader.setUniformBlockBinding("FrameData", FrameUniforms::BINDING);
+    proceduralShader.setUniformBlockBinding("FrameData", FrameUniforms::BINDING);
+    impostorShader.setUniformBlockBinding("FrameData", FrameUniforms::BINDING);
+    ourShader.setUniformBlockBinding("TextureResidency", TextureArray::RESIDENCY_BINDING);
+    proceduralShader.setUniformBlockBinding("TextureResidency", TextureArray::RESIDENCY_BINDING);
+    impostorShader.setUniformBlockBinding("TextureResidency", TextureArray::RESIDENCY_BINDING);
+    pointShader.setUniformBlockBinding("TextureResidency", TextureArray::RESIDENCY_BINDING);
+
+    // every mesh lives in one vertex/index buffer pair under a single VAO
+    MeshArena meshArena;
+    // every body is drawn through this renderer's shared sphere LOD chain, 8x4 up to 256x128
+    InstancedRenderer renderer(meshArena, 8, 256);
+    renderer.setProceduralShader(proceduralShader); // modes cycled with P
+    renderer.setImpostorShader(impostorShader);
+    // maps are baked to BC1 on the first run and read back from the cache after that,
+    // small mips first, finer ones as the bodies grow on screen
+    TextureArray planetTextures(1024, 512, 0, "PlanetTextureMaps/cache");
+    // bodies sharing a map share its layer; past the budget, layers of bodies out of
+    // sight or a few pixels across give their slot up and draw in their average colour
+    planetTextures.setMemoryBudget(32 * 1024 * 1024);
+
+    // motion of every body, updated in one pass; the planets are handles into it
+    BodyStore bodyStore;
 
     // creating sun
-    Planet sun(0.2f, 72, 36, "PlanetTextureMaps/sunmap.jpg");
+    Planet sun(bodyStore, 0.2f, 72, 36, planetTextures, "PlanetTextureMaps/sunmap.jpg");
     sun.setPlanetPos(glm::vec3(0.0f, 0.0f, 0.0f));
     sun.setRotationSpeed(0.1f);
     sun.setScale(1.0f);
 
     // creating venus
-    Planet venus(0.08f, 72, 36, "PlanetTextureMaps/venusmap.jpg");
+    Planet venus(bodyStore, 0.08f, 72, 36, planetTextures, "PlanetTextureMaps/venusmap.jpg");
     venus.setPlanetPos(glm::vec3(1.0f, 0.0f, 0.0f));
     venus.setRotationSpeed(2.0f);
     venus.setScale(1.03f);
     venus.setOrbit(0.5f, 0.4f);
 
     // creating earth
-    Planet earth(0.09f, 72, 36, "PlanetTextureMaps/earthmap1k.jpg");
+    Planet earth(bodyStore, 0.09f, 72, 36, planetTextures, "PlanetTextureMaps/earthmap1k.jpg");
     earth.setPlanetPos(glm::vec3(1.5f, 0.0f, 0.0f));
     earth.setRotationSpeed(2.0f);
     earth.setScale(1.01f);
     earth.setOrbit(0.9f, 0.5f);
 
     // creating moon
-    Planet moon(0.03f, 72, 36, "PlanetTextureMaps/moonmap1k.jpg");
+    Planet moon(bodyStore, 0.03f, 72, 36, planetTextures, "PlanetTextureMaps/moonmap1k.jpg");
     moon.setPlanetPos(glm::vec3(1.5f, 0.0f, 0.0f));
     moon.setRotationSpeed(2.3f);
     moon.setScale(1.01f);
     moon.setOrbit(0.14f, 4.85f);
+    moon.setParent(earth);
 
     // creating mars
-    Planet mars(0.07f, 72, 36, "PlanetTextureMaps/marsmap1k.jpg");
+    Planet mars(bodyStore, 0.07f, 72, 36, planetTextures, "PlanetTextureMaps/marsmap1k.jpg");
     mars.setPlanetPos(glm::vec3(2.0f, 0.0f, 0.0f));
     mars.setRotationSpeed(2.0f);
     mars.setScale(1.02f);
     mars.setOrbit(1.3f, 0.45f);
 
     // creating neptune
-    Planet neptune(0.1f, 72, 36, "PlanetTextureMaps/neptunemap.jpg");
+    Planet neptune(bodyStore, 0.1f, 72, 36, planetTextures, "PlanetTextureMaps/neptunemap.jpg");
     neptune.setPlanetPos(glm::vec3(2.5f, 0.0f, 0.0f));
     neptune.setRotationSpeed(2.0f);
     neptune.setScale(1.04f);
     neptune.setOrbit(1.8f, 0.4f);
 
+    // with a JPL kernel in place the planets take their real positions around the Sun
+    // instead of the orbits above; the Moon keeps its own, the body sizes are not to scale
+    Ephemeris ephemeris;
+    Planet *skyPlanets[] = {&venus, &earth, &mars, &neptune};
+    const int skyTargets[] = {EPHEMERIS_VENUS_BARYCENTER, EPHEMERIS_EARTH, EPHEMERIS_MARS_BARYCENTER, EPHEMERIS_NEPTUNE_BARYCENTER};
+    const int skyCenters[] = {EPHEMERIS_SUN, EPHEMERIS_SUN, EPHEMERIS_SUN, EPHEMERIS_SUN};
+    const unsigned int skyCount = sizeof(skyPlanets) / sizeof(skyPlanets[0]);
+    double skyPositions[3 * skyCount];
+    bool realSky = ephemeris.open("Ephemerides/de440s.bsp");
+    if (realSky)
+        for (unsigned int i = 0; i < skyCount; ++i)
+            skyPlanets[i]->setOrbit(0.0f, 0.0f);
+
+    // all maps are queued, allocate the array; layers stay grey until update() streams them in
+    planetTextures.build();
+
+    // in store order, so an index here is also the body's index in bodyStore and the GPU renderer
+    Planet *bodies[] = {&sun, &venus, &earth, &moon, &mars, &neptune};
+    const unsigned int bodyCount = sizeof(bodies) / sizeof(bodies[0]);
+    // the renderer draws its own LOD meshes, the bodies only keep a copy for picking
+    for (unsigned int i = 0; i < bodyCount; ++i)
+        bodies[i]->releaseMesh();
+
+    // GL 4.3 path: culling and level selection in a compute shader, one indirect multi-draw
+    bool gpuDriven = GpuDrivenRenderer::isSupported();
+    float timeScale = 1.0f;
+    Shader *cullShader = NULL;
+    Shader *gpuShader = NULL;
+    Shader *gpuPointShader = NULL;
+    GpuDrivenRenderer *gpuRenderer = NULL;
+    if (gpuDriven)
+    {
+        cullShader = new Shader("dependencies/include/shadersPrograms/cullComputeShader.glsl");
+        gpuShader = new Shader("dependencies/include/shadersPrograms/gpuVertexShader.glsl", "dependencies/include/shadersPrograms/instancedFragmentShader.glsl");
+        gpuPointShader = new Shader("dependencies/include/shadersPrograms/gpuPointVertexShader.glsl", "dependencies/include/shadersPrograms/pointFragmentShader.glsl");
+        gpuShader->setUniformBlockBinding("FrameData", FrameUniforms::BINDING);
+        gpuPointShader->setUniformBlockBinding("FrameData", FrameUniforms::BINDING);
+        gpuShader->setUniformBlockBinding("TextureResidency", TextureArray::RESIDENCY_BINDING);
+        gpuPointShader->setUniformBlockBinding("TextureResidency", TextureArray::RESIDENCY_BINDING);
+        gpuRenderer = new GpuDrivenRenderer(meshArena, *cullShader, 8, 256);
+        for (unsigned int i = 0; i < bodyCount; ++i)
+            gpuRenderer->addBody(*bodies[i]);
+    }
+
+    Frustum frustum;
+    BoundingSpheres bounds;
+    std::vector<unsigned int> visible;
+
     Timer timer;
     float deltaTime = 0.0f;
     glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), 800.0f / 600.0f, 0.1f, 100.0f);
@@ -158,54 +288,62 @@ int main()
     while (!glfwWindowShouldClose(window))
     {
         timer.start();
-        processInput(window, camera, deltaTime, sun, moon);
+        processInput(window, camera, deltaTime, sun, moon, renderer, gpuDriven, timeScale);
 
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        ourShader.use();
-
+        // unchanged values are skipped by FrameUniforms' dirty tracking
         glm::mat4 view = camera.GetViewMatrix();
-        ourShader.setMat4("view", view);
-        ourShader.setMat4("projection", projection);
-        ourShader.setVec3("viewPos", camera.Position);
+        frameUniforms.setCamera(view, projection, camera.Position);
 
         // directionalLighting
-        ourShader.setVec3("dirLight.direction", glm::vec3(-0.2f, -1.0f, -0.3f));
-        ourShader.setVec3("dirLight.ambient", glm::vec3(0.3f, 0.3f, 0.3f));
-        ourShader.setVec3("dirLight.diffuse", glm::vec3(1.1f, 1.1f, 0.4f));
-        ourShader.setVec3("dirLight.specular", glm::vec3(1.0f, 1.0f, 0.5f));
+        frameUniforms.setDirLight(glm::vec3(-0.2f, -1.0f, -0.3f), glm::vec3(0.3f, 0.3f, 0.3f),
+                                  glm::vec3(1.1f, 1.1f, 0.4f), glm::vec3(1.0f, 1.0f, 0.5f));
 
         // pointLighting
         glm::vec3 pointLightPos = sun.getPlanetPosi();
-        ourShader.setVec3("pointLight.position", pointLightPos + glm::vec3(1.0f, 1.0f, 1.0f));
-        ourShader.setVec3("pointLight.ambient", glm::vec3(0.0f, 0.0f, 0.1f));
-        ourShader.setVec3("pointLight.diffuse", glm::vec3(0.2f, 0.2f, 0.2f));
-        ourShader.setVec3("pointLight.specular", glm::vec3(0.5f, 0.5f, 0.5f));
-        ourShader.setFloat("pointLight.constant", 1.0f);
-        ourShader.setFloat("pointLight.linear", 0.1f);
-        ourShader.setFloat("pointLight.quadratic", 0.032f);
-
-        sun.update(deltaTime);
-        // std::cout << deltaTime << std::endl;
-        glm::vec3 earthPos = earth.getPlanetPosi();
-        sun.draw(ourShader.ID);
-
-        earth.update(deltaTime);
-        earth.draw(ourShader.ID);
-        moon.setOrbitCenter(earth.getPlanetPosi());
-
-        moon.update(deltaTime);
-        moon.draw(ourShader.ID);
-
-        mars.update(deltaTime);
-        mars.draw(ourShader.ID);
-
-        venus.update(deltaTime);
-        venus.draw(ourShader.ID);
-
-        neptune.update(deltaTime);
-        neptune.draw(ourShader.ID);
+        frameUniforms.setPointLight(pointLightPos + glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.1f),
+                                    glm::vec3(0.2f, 0.2f, 0.2f), glm::vec3(0.5f, 0.5f, 0.5f));
+        frameUniforms.upload();
+
+        double time = bodyStore.getTime() + deltaTime * timeScale;
+        if (realSky && ephemeris.getPositions(skyTargets, skyCenters, skyCount, time * SKY_SECONDS_PER_SECOND, skyPositions))
+            for (unsigned int i = 0; i < skyCount; ++i)
+                skyPlanets[i]->setOrbitCenter(equatorialToScene(skyPositions + 3 * i));
+        bodyStore.setTime(time);
+
+        // screen sizes are in pixels of the framebuffer, which follows the window
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+        // only bodies whose bounding sphere touches the frustum are drawn or keep their
+        // textures in use; the GPU path culls again on its own, this is for the textures
+        frustum.extract(projection * view);
+        bounds.clear();
+        for (unsigned int i = 0; i < bodyCount; ++i)
+            bounds.add(bodyStore.getPosition(i), bodyStore.getBoundingRadius(i));
+        frustum.cull(bounds, visible);
+
+        // finer mips stream in for the bodies that cover the most screen first; layers
+        // of bodies out of sight go unrequested and are the first to give up their slot
+        renderer.setView(camera.Position, projection, framebufferHeight);
+        for (std::size_t i = 0; i < visible.size(); ++i)
+            planetTextures.requestDetail(bodies[visible[i]]->getTextureLayer(), renderer.getScreenRadius(*bodies[visible[i]]));
+        planetTextures.update();
+
+        if (gpuDriven && gpuRenderer)
+        {
+            gpuRenderer->setBodies(bodyStore);
+            gpuRenderer->setView(camera.Position, view, projection, framebufferHeight);
+            gpuRenderer->draw(gpuShader->ID, gpuPointShader->ID, planetTextures);
+        }
+        else
+        {
+            renderer.begin();
+            renderer.add(bodyStore, visible.data(), visible.size());
+            renderer.draw(ourShader.ID, pointShader.ID, planetTextures);
+        }
 
         glfwSwapBuffers(window);
         glfwPollEvents();
@@ -214,6 +352,10 @@ int main()
         // std::cout << deltaTime << std::endl;
     }
 
+    delete gpuRenderer;
+    delete gpuPointShader;
+    delete gpuShader;
+    delete cullShader;
     glfwTerminate();
     return 0;
 }